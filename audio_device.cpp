@@ -0,0 +1,364 @@
+#include "audio_device.h"
+#include "wav_file.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+std::unique_ptr<AudioDevice> createAudioDevice(const std::string& spec)
+{
+    std::string kind = spec.substr(0, spec.find(':'));
+    std::string arg = kind.size() < spec.size() ? spec.substr(kind.size() + 1) : "";
+
+    bool realtime = true;
+    const std::string fast = "+fast";
+    if (kind.size() > fast.size() && kind.compare(kind.size() - fast.size(), fast.size(), fast) == 0) {
+        kind.resize(kind.size() - fast.size());
+        realtime = false;
+    }
+
+    if (kind == "portaudio" && realtime)
+        return std::make_unique<PortAudioDevice>();
+    if (kind == "null")
+        return std::make_unique<NullDevice>(realtime);
+    if (kind == "file" && !arg.empty())
+        return std::make_unique<FileDevice>(arg, realtime);
+    if (kind == "gen") {
+        SignalParams params;
+        std::string error;
+        if (parseSignalSpec(arg.empty() ? "sine" : arg, params, error))
+            return std::make_unique<GeneratorDevice>(params, arg.empty() ? "sine" : arg, realtime);
+        std::cerr << error << "\n";
+        return nullptr;
+    }
+
+    std::cerr << "Unknown audio device \"" << spec << "\" (expected portaudio, null[+fast], file[+fast]:<path> or gen[+fast]:<signal>)\n";
+    return nullptr;
+}
+
+std::string defaultDeviceSpec(AudioDevice::Direction direction)
+{
+    const char* env = std::getenv(direction == AudioDevice::Capture ? "SC_CAPTURE_DEVICE" : "SC_PLAYBACK_DEVICE");
+    return (env && *env) ? env : "portaudio";
+}
+
+// ------------------------------------------------------------
+// PortAudioDevice
+// ------------------------------------------------------------
+
+PortAudioDevice::~PortAudioDevice()
+{
+    close();
+}
+
+PaDeviceIndex PortAudioDevice::findLoopbackDevice()
+{
+    PaDeviceIndex loopbackDevice_idx = paNoDevice;
+
+    int n_devices = Pa_GetDeviceCount();
+    PaDeviceIndex idx_output_device = Pa_GetDefaultOutputDevice();
+    if (idx_output_device == paNoDevice) return paNoDevice;
+    std::string output_device_name = Pa_GetDeviceInfo(idx_output_device)->name;
+
+    for (int i = 0; i < n_devices; ++i)
+    {
+        std::string current_device_name = Pa_GetDeviceInfo(i)->name;
+        if (current_device_name.find(output_device_name) != std::string::npos) {
+            if (current_device_name.find("[Loopback]") != std::string::npos) {
+                loopbackDevice_idx = i;
+                break;
+            }
+        }
+    }
+
+#ifndef _WIN32
+    // "[Loopback]" devices are a WASAPI thing. On Linux the monitor source is
+    // picked in the sound server (e.g. pavucontrol) for the default input.
+    if (loopbackDevice_idx == paNoDevice)
+        loopbackDevice_idx = Pa_GetDefaultInputDevice();
+#endif
+
+    return loopbackDevice_idx;
+}
+
+PaError PortAudioDevice::open(Direction direction, double sampleRate, unsigned long framesPerBuffer,
+    PaStreamCallback* callback, void* userData)
+{
+    PaError err = Pa_Initialize();
+    if (err != paNoError) return err;
+
+    dir = direction;
+
+    PaStreamParameters params = {};
+    params.device = direction == Capture ? findLoopbackDevice() : Pa_GetDefaultOutputDevice();
+    if (params.device == paNoDevice) {
+        Pa_Terminate();
+        return paDeviceUnavailable;
+    }
+
+    const PaDeviceInfo* info = Pa_GetDeviceInfo(params.device);
+    params.channelCount = NUM_CHANNELS;
+    params.sampleFormat = PA_SAMPLE_TYPE;
+    params.suggestedLatency = direction == Capture ? info->defaultLowInputLatency : info->defaultLowOutputLatency;
+    params.hostApiSpecificStreamInfo = NULL;
+
+    rate = sampleRate > 0 ? sampleRate : info->defaultSampleRate;
+
+    err = Pa_OpenStream(
+        &stream,
+        direction == Capture ? &params : NULL,
+        direction == Playback ? &params : NULL,
+        rate,
+        framesPerBuffer,
+        paClipOff,
+        callback,
+        userData
+    );
+    if (err != paNoError) {
+        stream = nullptr;
+        Pa_Terminate();
+    }
+    return err;
+}
+
+PaError PortAudioDevice::start()
+{
+    return stream ? Pa_StartStream(stream) : paBadStreamPtr;
+}
+
+PaError PortAudioDevice::stop()
+{
+    return stream ? Pa_StopStream(stream) : paBadStreamPtr;
+}
+
+PaError PortAudioDevice::close()
+{
+    if (!stream) return paNoError;
+
+    PaError err = Pa_CloseStream(stream);
+    stream = nullptr;
+
+    PaError termErr = Pa_Terminate();
+    return err != paNoError ? err : termErr;
+}
+
+int PortAudioDevice::isActive() const
+{
+    return stream ? Pa_IsStreamActive(stream) : 0;
+}
+
+double PortAudioDevice::latency() const
+{
+    const PaStreamInfo* info = stream ? Pa_GetStreamInfo(stream) : nullptr;
+    if (!info) return 0.0;
+    return dir == Capture ? info->inputLatency : info->outputLatency;
+}
+
+double PortAudioDevice::cpuLoad() const
+{
+    return stream ? Pa_GetStreamCpuLoad(stream) : 0.0;
+}
+
+// ------------------------------------------------------------
+// ClockedDevice
+// ------------------------------------------------------------
+
+ClockedDevice::~ClockedDevice()
+{
+    // Subclasses must close() in their own destructor to get onClose();
+    // here we only make sure the worker is gone.
+    stop();
+}
+
+PaError ClockedDevice::open(Direction direction, double sampleRate, unsigned long frames,
+    PaStreamCallback* cb, void* ud)
+{
+    dir = direction;
+    requestedRate = sampleRate;
+    rate = sampleRate > 0 ? sampleRate : SAMPLE_RATE;
+    framesPerBuffer = frames > 0 ? frames : FRAMES_PER_BUFFER;
+    callback = cb;
+    userData = ud;
+    return onOpen();
+}
+
+PaError ClockedDevice::start()
+{
+    if (!callback) return paBadStreamPtr;
+    if (worker.joinable()) return paStreamIsNotStopped;
+
+    stopRequested = false;
+    active = true;
+    worker = std::thread(&ClockedDevice::run, this);
+    return paNoError;
+}
+
+PaError ClockedDevice::stop()
+{
+    stopRequested = true;
+    if (worker.joinable()) worker.join();
+    active = false;
+    return paNoError;
+}
+
+PaError ClockedDevice::close()
+{
+    stop();
+    PaError err = callback ? onClose() : paNoError;
+    callback = nullptr;
+    return err;
+}
+
+bool ClockedDevice::readInput(SAMPLE* buffer, unsigned long frames)
+{
+    std::fill(buffer, buffer + frames * channels, SAMPLE_SILENCE);
+    return true;
+}
+
+void ClockedDevice::writeOutput(const SAMPLE*, unsigned long)
+{
+}
+
+void ClockedDevice::run()
+{
+    typedef std::chrono::steady_clock Clock;
+    const double bufferSecs = framesPerBuffer / rate;
+    const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(bufferSecs));
+
+    std::vector<SAMPLE> buffer(framesPerBuffer * channels);
+    const Clock::time_point t0 = Clock::now();
+    Clock::time_point next = t0;
+    unsigned long long framePos = 0;
+    double smoothedLoad = 0.0;
+
+    while (!stopRequested)
+    {
+        bool more = true;
+        if (dir == Capture)
+            more = readInput(buffer.data(), framesPerBuffer);
+
+        // Stream time follows the wall clock in real time, the frame count otherwise
+        PaStreamCallbackTimeInfo timeInfo;
+        timeInfo.currentTime = realtime
+            ? std::chrono::duration<double>(Clock::now() - t0).count()
+            : framePos / rate;
+        timeInfo.inputBufferAdcTime = timeInfo.currentTime - bufferSecs;
+        timeInfo.outputBufferDacTime = timeInfo.currentTime + bufferSecs;
+
+        Clock::time_point cbStart = Clock::now();
+        int result = callback(
+            dir == Capture ? buffer.data() : NULL,
+            dir == Playback ? buffer.data() : NULL,
+            framesPerBuffer, &timeInfo, 0, userData);
+        double cbSecs = std::chrono::duration<double>(Clock::now() - cbStart).count();
+
+        smoothedLoad = 0.9 * smoothedLoad + 0.1 * (cbSecs / bufferSecs);
+        load = smoothedLoad;
+
+        if (dir == Playback && result != paAbort)
+            writeOutput(buffer.data(), framesPerBuffer);
+
+        framePos += framesPerBuffer;
+        if (result != paContinue || !more)
+            break;
+
+        if (realtime) {
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    active = false;
+}
+
+// ------------------------------------------------------------
+// FileDevice
+// ------------------------------------------------------------
+
+PaError FileDevice::onOpen()
+{
+    samples.clear();
+    readFrame = 0;
+
+    if (dir == Playback)
+        return paNoError;
+
+    WavData wav;
+    std::string error;
+    if (!readWav(path, wav, error)) {
+        std::cerr << error << std::endl;
+        return paDeviceUnavailable;
+    }
+    if (requestedRate > 0 && wav.sampleRate != (int)requestedRate) {
+        std::cerr << path << " is " << wav.sampleRate << " Hz, stream wants " << requestedRate << " Hz" << std::endl;
+        return paInvalidSampleRate;
+    }
+    rate = wav.sampleRate;
+
+    // Map the file's channels onto NUM_CHANNELS: duplicate mono, drop extras
+    size_t frames = wav.frames();
+    samples.resize(frames * channels);
+    for (size_t f = 0; f < frames; f++) {
+        for (int c = 0; c < channels; c++) {
+            samples[f * channels + c] = wav.samples[f * wav.channels + std::min(c, wav.channels - 1)];
+        }
+    }
+    return paNoError;
+}
+
+PaError FileDevice::onClose()
+{
+    if (dir != Playback)
+        return paNoError;
+
+    WavData wav;
+    wav.sampleRate = (int)rate;
+    wav.channels = channels;
+    wav.samples = std::move(samples);
+
+    std::string error;
+    if (!writeWav(path, wav, WavSampleFormat::Float32, error)) {
+        std::cerr << error << std::endl;
+        return paInternalError;
+    }
+    return paNoError;
+}
+
+bool FileDevice::readInput(SAMPLE* buffer, unsigned long frames)
+{
+    size_t total = samples.size() / channels;
+    size_t n = std::min<size_t>(frames, total - readFrame);
+
+    std::memcpy(buffer, samples.data() + readFrame * channels, n * channels * sizeof(SAMPLE));
+    std::fill(buffer + n * channels, buffer + frames * channels, SAMPLE_SILENCE);
+    readFrame += n;
+
+    return readFrame < total;
+}
+
+void FileDevice::writeOutput(const SAMPLE* buffer, unsigned long frames)
+{
+    size_t n = std::min<size_t>(frames, maxFrames - std::min(maxFrames, samples.size() / channels));
+    samples.insert(samples.end(), buffer, buffer + n * channels);
+}
+
+// ------------------------------------------------------------
+// GeneratorDevice
+// ------------------------------------------------------------
+
+PaError GeneratorDevice::onOpen()
+{
+    if (dir != Capture) {
+        std::cerr << "gen: is a capture-only device" << std::endl;
+        return paInvalidDevice;
+    }
+    generator = std::make_unique<SignalGenerator>(params, rate, channels);
+    return paNoError;
+}
+
+bool GeneratorDevice::readInput(SAMPLE* buffer, unsigned long frames)
+{
+    generator->generate(buffer, frames);
+    return true;
+}
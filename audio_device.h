@@ -0,0 +1,181 @@
+#pragma once
+#include "portaudio.h"
+#include "signal_generator.h"
+#include "utils.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Where a stream's audio comes from or goes to. The callbacks
+ * (recordCallback, playCallback) are plain PaStreamCallbacks and do not
+ * know which device drives them.
+ *
+ * Device specs, as accepted by createAudioDevice():
+ *   "portaudio"          sound card: WASAPI loopback for capture, default output for playback
+ *   "null"               silence in / discard out, clocked by a high-resolution timer
+ *   "file:<path.wav>"    read capture from / write playback to a WAV file
+ *   "gen:<signal>"       capture a synthetic test signal, see parseSignalSpec()
+ * "null", "file" and "gen" take a "+fast" suffix ("null+fast",
+ * "gen+fast:sweep") to run as fast as the callbacks allow instead of in
+ * real time.
+ */
+class AudioDevice {
+public:
+    enum Direction { Capture, Playback };
+
+    virtual ~AudioDevice() = default;
+
+    // sampleRate <= 0 means "the device's own rate"
+    virtual PaError open(Direction direction, double sampleRate, unsigned long framesPerBuffer,
+        PaStreamCallback* callback, void* userData) = 0;
+    virtual PaError start() = 0;
+    virtual PaError stop() = 0;
+    virtual PaError close() = 0;
+
+    // Same contract as Pa_IsStreamActive: 1 running, 0 finished, < 0 error
+    virtual int isActive() const = 0;
+
+    virtual double sampleRate() const = 0;
+    virtual double latency() const = 0;   // reported input or output latency, seconds
+    virtual double cpuLoad() const = 0;   // 0..1, not callable from the callback
+    virtual std::string name() const = 0;
+};
+
+// Returns nullptr (and prints why) for an unknown or malformed spec
+std::unique_ptr<AudioDevice> createAudioDevice(const std::string& spec);
+
+// Spec from SC_CAPTURE_DEVICE / SC_PLAYBACK_DEVICE, "portaudio" when unset
+std::string defaultDeviceSpec(AudioDevice::Direction direction);
+
+/**
+ * PortAudio stream on a real sound card.
+ */
+class PortAudioDevice : public AudioDevice {
+public:
+    ~PortAudioDevice() override;
+
+    PaError open(Direction direction, double sampleRate, unsigned long framesPerBuffer,
+        PaStreamCallback* callback, void* userData) override;
+    PaError start() override;
+    PaError stop() override;
+    PaError close() override;
+    int isActive() const override;
+    double sampleRate() const override { return rate; }
+    double latency() const override;
+    double cpuLoad() const override;
+    std::string name() const override { return "portaudio"; }
+
+private:
+    static PaDeviceIndex findLoopbackDevice();
+
+    PaStream* stream = nullptr;
+    Direction dir = Capture;
+    double rate = 0.0;
+};
+
+/**
+ * Device without hardware: a worker thread calls the callback once per
+ * buffer, paced by steady_clock (or back to back in fast mode). Subclasses
+ * supply the input and take the output.
+ */
+class ClockedDevice : public AudioDevice {
+public:
+    explicit ClockedDevice(bool realtime) : realtime(realtime) {}
+    ~ClockedDevice() override;
+
+    PaError open(Direction direction, double sampleRate, unsigned long framesPerBuffer,
+        PaStreamCallback* callback, void* userData) override;
+    PaError start() override;
+    PaError stop() override;
+    PaError close() override;
+    int isActive() const override { return active.load() ? 1 : 0; }
+    double sampleRate() const override { return rate; }
+    double latency() const override { return framesPerBuffer / rate; }
+    double cpuLoad() const override { return load.load(); }
+
+protected:
+    // Fill one interleaved input buffer; return false after the last one
+    virtual bool readInput(SAMPLE* buffer, unsigned long frames);
+    virtual void writeOutput(const SAMPLE* buffer, unsigned long frames);
+    virtual PaError onOpen() { return paNoError; }
+    virtual PaError onClose() { return paNoError; }
+
+    Direction dir = Capture;
+    double requestedRate = 0.0;  // as passed to open(), <= 0 for "own rate"
+    double rate = SAMPLE_RATE;
+    int channels = NUM_CHANNELS;
+
+private:
+    void run();
+
+    bool realtime;
+    unsigned long framesPerBuffer = FRAMES_PER_BUFFER;
+    PaStreamCallback* callback = nullptr;
+    void* userData = nullptr;
+    std::thread worker;
+    std::atomic<bool> active{ false };
+    std::atomic<bool> stopRequested{ false };
+    std::atomic<double> load{ 0.0 };
+};
+
+class NullDevice : public ClockedDevice {
+public:
+    explicit NullDevice(bool realtime) : ClockedDevice(realtime) {}
+    std::string name() const override { return "null"; }
+};
+
+/**
+ * Capture reads a WAV file (at the requested rate; channels are mapped to
+ * NUM_CHANNELS) and finishes at its end. Playback collects everything, up
+ * to an optional limit, and writes it as a float WAV on close().
+ */
+class FileDevice : public ClockedDevice {
+public:
+    FileDevice(const std::string& path, bool realtime) : ClockedDevice(realtime), path(path) {}
+    ~FileDevice() override { close(); }
+    std::string name() const override { return "file:" + path; }
+
+    // Capture, once open: frames in the file. The last block read is padded
+    // with silence past them.
+    size_t sourceFrames() const { return dir == Capture ? samples.size() / channels : 0; }
+
+    // Playback: keep only the first `frames` frames of the output
+    void setMaxFrames(size_t frames) { maxFrames = frames; }
+
+protected:
+    bool readInput(SAMPLE* buffer, unsigned long frames) override;
+    void writeOutput(const SAMPLE* buffer, unsigned long frames) override;
+    PaError onOpen() override;
+    PaError onClose() override;
+
+private:
+    std::string path;
+    std::vector<SAMPLE> samples;  // interleaved, NUM_CHANNELS
+    size_t readFrame = 0;
+    size_t maxFrames = SIZE_MAX;
+};
+
+/**
+ * Capture-only stand-in for the loopback device: a SignalGenerator at the
+ * requested rate (SAMPLE_RATE for "own rate"). Runs until the callback
+ * completes or the device is stopped.
+ */
+class GeneratorDevice : public ClockedDevice {
+public:
+    GeneratorDevice(const SignalParams& params, const std::string& spec, bool realtime)
+        : ClockedDevice(realtime), params(params), spec(spec) {}
+    std::string name() const override { return "gen:" + spec; }
+
+protected:
+    bool readInput(SAMPLE* buffer, unsigned long frames) override;
+    PaError onOpen() override;
+
+private:
+    SignalParams params;
+    std::string spec;
+    std::unique_ptr<SignalGenerator> generator;
+};
@@ -1,7 +1,63 @@
 #include "audio_recorder.h"
+#include "level_meter.h"
 #include "portaudio.h"
+#include "render_cache.h"
+#include "sample_kernels.h"
+#include "take_render.h"
+#include "take_store.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 
+TriggerSettings defaultTriggerSettings()
+{
+    TriggerSettings settings;
+    if (const char* db = std::getenv("SC_TRIGGER_DB"))
+        settings.thresholdDb = std::strtof(db, nullptr);
+    if (const char* tail = std::getenv("SC_TRIGGER_TAIL"))
+        settings.tailSeconds = std::strtod(tail, nullptr);
+    return settings;
+}
+
+/* Armed: remember the newest frames of the block in the pre-roll ring */
+static void keepPreRoll(CaptureTrigger& trigger, const SAMPLE* in, unsigned long frames)
+{
+    long size = (long)trigger.preRoll.size() / NUM_CHANNELS;
+    if (size == 0) return;
+
+    if ((long)frames > size) {
+        if (in) in += (frames - size) * NUM_CHANNELS;
+        frames = size;
+    }
+    for (unsigned long done = 0; done < frames; )
+    {
+        long n = std::min<long>(frames - done, size - trigger.preRollPos);
+        SAMPLE* dst = trigger.preRoll.data() + trigger.preRollPos * NUM_CHANNELS;
+        if (in)
+            std::memcpy(dst, in + done * NUM_CHANNELS, n * NUM_CHANNELS * sizeof(SAMPLE));
+        else
+            std::fill_n(dst, n * NUM_CHANNELS, SAMPLE_SILENCE);
+        trigger.preRollPos = (trigger.preRollPos + n) % size;
+        done += n;
+    }
+    trigger.preRollFill = std::min(size, trigger.preRollFill + (long)frames);
+}
+
+/* Triggered: the ring, oldest frame first, becomes the start of the take */
+static void commitPreRoll(AudioData* data)
+{
+    CaptureTrigger& trigger = data->trigger;
+    long size = (long)trigger.preRoll.size() / NUM_CHANNELS;
+    long oldest = trigger.preRollFill < size ? 0 : trigger.preRollPos;
+    long first = std::min(trigger.preRollFill, size - oldest);
+
+    data->storeFrames(trigger.preRoll.data() + oldest * NUM_CHANNELS, data->currentSampleIndex, first);
+    data->storeFrames(trigger.preRoll.data(), data->currentSampleIndex + first, trigger.preRollFill - first);
+    data->currentSampleIndex += trigger.preRollFill;
+}
+
 /* This routine will be called by the PortAudio engine when audio is needed.
 ** It may be called at interrupt level on some machines so don't do anything
 ** that could mess up the system like calling malloc() or free().
@@ -14,19 +70,48 @@ int recordCallback(
     PaStreamCallbackFlags statusFlags,
     void* userData)
 {
+    StreamStats::Clock::time_point callbackStart = StreamStats::Clock::now();
     AudioData* data = (AudioData*)userData;
     const SAMPLE* rptr = (const SAMPLE*)inputBuffer;
-    SAMPLE* wptr = &data->recorded[data->currentSampleIndex * NUM_CHANNELS];
+    CaptureTrigger& trigger = data->trigger;
     long framesToCalc;
-    long i;
     int finished;
-    unsigned long framesLeft = data->maxSamplesBuffer - data->currentSampleIndex;
 
     (void)outputBuffer; /* Prevent unused variable warnings. */
-    (void)timeInfo;
-    (void)statusFlags;
     (void)userData;
 
+    /* Meter the input, armed or not, so levels can be set before a take */
+    data->recordLevels->process(rptr, framesPerBuffer);
+
+    /* Armed recording: nothing goes into the take until a block is loud
+    ** enough; then the pre-roll goes in first. Afterwards, count the quiet
+    ** frames towards the tail that ends the take.
+    */
+    CapturePhase phase = trigger.phase.load(std::memory_order_relaxed);
+    if (phase != CapturePhase::Direct)
+    {
+        float level = rptr ? sumOfSquares(rptr, framesPerBuffer * NUM_CHANNELS) / (framesPerBuffer * NUM_CHANNELS) : 0.0f;
+
+        if (phase == CapturePhase::Armed)
+        {
+            if (level < trigger.openLevel) {
+                keepPreRoll(trigger, rptr, framesPerBuffer);
+                data->recordClock.publish(data->currentSampleIndex, data->captureSampleRate, timeInfo, false);
+                data->recordStats.record(statusFlags, framesPerBuffer, StreamStats::Clock::now() - callbackStart);
+                return paContinue;
+            }
+            commitPreRoll(data);
+            trigger.quietFrames = 0;
+            phase = CapturePhase::Triggered;
+            trigger.phase.store(phase);
+        }
+        else
+            trigger.quietFrames = level < trigger.quietLevel ? trigger.quietFrames + (long)framesPerBuffer : 0;
+    }
+
+    unsigned long framesLeft = data->maxSamplesBuffer - data->currentSampleIndex;
+    long blockStart = data->currentSampleIndex;
+
     if (framesLeft < framesPerBuffer)
     {
         framesToCalc = framesLeft;
@@ -38,83 +123,51 @@ int recordCallback(
         finished = paContinue;
     }
 
-    if (inputBuffer == NULL)
-    {
-        for (i = 0; i < framesToCalc; i++)
-        {
-            *wptr++ = SAMPLE_SILENCE;  /* left */
-            if (NUM_CHANNELS == 2) *wptr++ = SAMPLE_SILENCE;  /* right */
-        }
-    }
-    else
-    {
-        for (i = 0; i < framesToCalc; i++)
-        {
-            *wptr++ = *rptr++;  /* left */
-            if (NUM_CHANNELS == 2) *wptr++ = *rptr++;  /* right */
-        }
-    }
+    /* Split the interleaved input into the channel arrays (silence if none) */
+    data->storeFrames(rptr, data->currentSampleIndex, framesToCalc);
     data->currentSampleIndex += framesToCalc;
-    return finished;
-}
-
-PaDeviceIndex AudioRecorder::findLoopbackDevice()
-{
-    PaDeviceIndex loopbackDevice_idx = paNoDevice;
-
-    int n_devices = Pa_GetDeviceCount();
-    PaDeviceIndex idx_output_device = Pa_GetDefaultOutputDevice();
-    std::string output_device_name = Pa_GetDeviceInfo(idx_output_device)->name;
 
-    for (int i = 0; i < n_devices; ++i)
-    {
-        std::string current_device_name = Pa_GetDeviceInfo(i)->name;
-        if (current_device_name.find(output_device_name) != std::string::npos) {
-            if (current_device_name.find("[Loopback]") != std::string::npos) {
-                loopbackDevice_idx = i;
-                break;
-            }
-        }
-    }
+    if (phase == CapturePhase::Triggered && trigger.tailFrames > 0 && trigger.quietFrames >= trigger.tailFrames)
+        finished = paComplete;
 
-    return loopbackDevice_idx;
+    data->recordClock.publish(blockStart, data->captureSampleRate, timeInfo, false);
+    data->recordStats.record(statusFlags, framesPerBuffer, StreamStats::Clock::now() - callbackStart);
+    return finished;
 }
 
 PaError AudioRecorder::start() {
     PaError err = paNoError;
 
-    err = Pa_Initialize();
-    if (err != paNoError) return err;
+    device = createAudioDevice(deviceSpec.empty() ? defaultDeviceSpec(AudioDevice::Capture) : deviceSpec);
+    if (!device) return paInvalidDevice;
 
-    PaStreamParameters inputParameters = {};
-    inputParameters.device = findLoopbackDevice();
-    if (inputParameters.device == paNoDevice) {
-        return paDeviceUnavailable;
+    // Reset buffer index before the first callback can run
+    audioData->currentSampleIndex = 0;
+    audioData->takeStart = 0;
+    audioData->silentGaps.clear();
+    audioData->render.reset();
+    audioData->renderCache->clear();  // also gets its worker out of the take
+    audioData->take->beginTake();
+
+    err = device->open(AudioDevice::Capture, 0.0, FRAMES_PER_BUFFER, recordCallback, audioData);
+    if (err != paNoError) {
+        device.reset();
+        return err;
     }
 
-    inputParameters.channelCount = NUM_CHANNELS;
-    inputParameters.sampleFormat = PA_SAMPLE_TYPE;
-    inputParameters.suggestedLatency =
-        Pa_GetDeviceInfo(inputParameters.device)->defaultLowInputLatency;
-    inputParameters.hostApiSpecificStreamInfo = NULL;
-
-    err = Pa_OpenStream(
-        &audioData->stream,
-        &inputParameters,
-        NULL,
-        Pa_GetDeviceInfo(inputParameters.device)->defaultSampleRate,
-        FRAMES_PER_BUFFER,
-        paClipOff,
-        recordCallback,
-        audioData
-    );
-    if (err != paNoError) return err;
-
-    err = Pa_StartStream(audioData->stream);
-    if (err != paNoError) return err;
-
-    // Reset buffer index
-    audioData->currentSampleIndex = 0;
+    audioData->recordStats.reset(device->sampleRate());
+    audioData->recordLevels->reset(device->sampleRate());
+    audioData->captureSampleRate = device->sampleRate();
+    audioData->recordClock.reset(device->latency());
+    monitor.start(device->sampleRate(), silenceSettings);
+    setupTrigger(device->sampleRate());
+
+    err = device->start();
+    if (err != paNoError) {
+        monitor.finish(0);
+        device.reset();
+        return err;
+    }
 
     return paNoError;
 }
@@ -123,21 +176,77 @@ PaError AudioRecorder::stop()
 {
     PaError err = paNoError;
 
-    if (audioData->stream) {
-        err = Pa_CloseStream(audioData->stream);
+    if (device) {
+        err = device->close();
 
         if (err == paNoError) {
             // Only trust currentSampleIndex if the stream closed cleanly
             audioData->totalSamplesRecorded = audioData->currentSampleIndex;
+            monitor.finish(audioData->totalSamplesRecorded);
+            applySilence();
+            audioData->render = monitor.takeRender();
+            if (audioData->render && !audioData->render->ready())
+                audioData->render.reset();
         }
+        else
+            monitor.finish(0);
 
-        audioData->stream = nullptr;
+        device.reset();
     }
 
-    PaError termErr = Pa_Terminate();
-    if (err == paNoError && termErr != paNoError) {
-        err = termErr;
+    return err;
+}
+
+void AudioRecorder::setTrigger(const TriggerSettings& settings, bool enabled)
+{
+    triggerSettings = settings;
+    armed = enabled;
+}
+
+bool AudioRecorder::waitingForTrigger() const
+{
+    return device && audioData->trigger.phase.load() == CapturePhase::Armed;
+}
+
+// Before the stream starts: the callback owns the trigger from then on
+void AudioRecorder::setupTrigger(double sampleRate)
+{
+    CaptureTrigger& trigger = audioData->trigger;
+    trigger.quietFrames = 0;
+    trigger.preRollPos = 0;
+    trigger.preRollFill = 0;
+
+    if (!armed) {
+        trigger.tailFrames = 0;
+        trigger.phase.store(CapturePhase::Direct);
+        return;
     }
 
-    return err;
+    trigger.openLevel = std::pow(10.0f, triggerSettings.thresholdDb / 10.0f);
+    trigger.quietLevel = std::pow(10.0f, (triggerSettings.thresholdDb - triggerSettings.hysteresisDb) / 10.0f);
+    trigger.tailFrames = (long)(triggerSettings.tailSeconds * sampleRate);
+    trigger.preRoll.assign((size_t)(triggerSettings.preRollSeconds * sampleRate) * NUM_CHANNELS, SAMPLE_SILENCE);
+    trigger.phase.store(CapturePhase::Armed);
+}
+
+void AudioRecorder::setSilenceSettings(const SilenceSettings& settings)
+{
+    silenceSettings = settings;
+    audioData->skipSilentGaps = settings.skipGaps;
+}
+
+// Cut the silence the monitor found. Only the bounds move; the frames stay
+// where they are in the take, so positions and the waveform do not shift.
+void AudioRecorder::applySilence()
+{
+    const SilenceDetector& silence = monitor.silence();
+
+    if (silenceSettings.trim && silence.soundFound()) {
+        SilentRegion keep = silence.soundBounds();
+        audioData->takeStart = keep.start;
+        audioData->totalSamplesRecorded = (int)keep.end;
+        audioData->take->trim(keep.start, keep.end);
+    }
+    audioData->silentGaps = silence.gaps();
+    audioData->skipSilentGaps = silenceSettings.skipGaps;
 }
@@ -1,16 +1,88 @@
 #pragma once
 
 #include "portaudio.h"
+#include "audio_device.h"
+#include "capture_monitor.h"
 #include "utils.h"
+#include <memory>
+#include <string>
 
+/* PortAudio callback that appends the input to AudioData::recorded at
+** currentSampleIndex and completes when the buffer is full. When armed
+** (AudioData::trigger) it waits for the trigger level first, and also
+** completes after the tail of quiet.
+*/
+int recordCallback(const void* inputBuffer, void* outputBuffer,
+    unsigned long framesPerBuffer,
+    const PaStreamCallbackTimeInfo* timeInfo,
+    PaStreamCallbackFlags statusFlags,
+    void* userData);
+
+/* Armed recording: the level that starts a take, how much comes before it,
+** and how long the input must stay quiet to end it. */
+struct TriggerSettings {
+    float thresholdDb = -40.0f;    // block RMS that starts the take, dBFS
+    float hysteresisDb = 6.0f;     // quiet means this far below the threshold
+    double preRollSeconds = 0.5;   // kept from before the trigger
+    double tailSeconds = 2.0;      // quiet this long stops the take; 0 = never
+};
+
+// From SC_TRIGGER_DB (threshold) and SC_TRIGGER_TAIL (seconds)
+TriggerSettings defaultTriggerSettings();
+
+/* Runs a take: the capture device writes into AudioData from
+** recordCallback while a CaptureMonitor looks for silence. When the take
+** stops, leading and trailing silence is trimmed off (AudioData::takeStart
+** and totalSamplesRecorded) and the long silent gaps are handed to
+** playback, as the SilenceSettings say.
+**
+** Armed (setTrigger), start() opens the stream right away and keeps it
+** open while waiting, but the take only begins when the input reaches the
+** trigger level, within one buffer of it. The stream then completes by
+** itself after the tail of quiet.
+*/
 class AudioRecorder {
 public:
-    explicit AudioRecorder(AudioData* data) : audioData(data) {}
+    explicit AudioRecorder(AudioData* data)
+        : audioData(data), silenceSettings(defaultSilenceSettings()),
+        triggerSettings(defaultTriggerSettings()), monitor(data) {}
+
+    // Device spec as understood by createAudioDevice(). Empty (default)
+    // means SC_CAPTURE_DEVICE, or the sound card's loopback device.
+    void setDeviceSpec(const std::string& spec) { deviceSpec = spec; }
+
+    // Used from the next start(); skipGaps also applies to the current take
+    void setSilenceSettings(const SilenceSettings& settings);
+    const SilenceSettings& getSilenceSettings() const { return silenceSettings; }
+
+    // Used from the next start()
+    void setTrigger(const TriggerSettings& settings, bool enabled);
+    const TriggerSettings& getTriggerSettings() const { return triggerSettings; }
+    bool isArmed() const { return armed; }
+
+    // Stretch the take at this ratio while recording (the speed slider);
+    // takes effect right away, 1.0 stretches nothing
+    void setRenderRatio(double ratio) { monitor.setRenderRatio(ratio); }
+
+    // Started armed and nothing has reached the trigger level yet
+    bool waitingForTrigger() const;
 
     PaError start();
     PaError stop();
 
+    // 1 while capturing, 0 once the callback finished (buffer full / end of file)
+    int isActive() const { return device ? device->isActive() : 0; }
+    AudioDevice* getDevice() const { return device.get(); }
+
 private:
+    void applySilence();
+    void setupTrigger(double sampleRate);
+
     AudioData* audioData;  // not owning
-    PaDeviceIndex findLoopbackDevice();
-};
\ No newline at end of file
+    std::string deviceSpec;
+    SilenceSettings silenceSettings;
+    TriggerSettings triggerSettings;
+    bool armed = false;
+    CaptureMonitor monitor;
+    std::unique_ptr<AudioDevice> device;
+};
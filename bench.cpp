@@ -0,0 +1,868 @@
+// Micro-benchmarks for the audio path and waveform summary. Prints one JSON
+// document on stdout and progress on stderr:
+//
+//   soundcard_bench [--quick] [--filter NAME] [--repeats N] > results.json
+//
+// Callbacks are called directly, without a device, so the numbers are the
+// cost of the code alone.
+#include "audio_recorder.h"
+#include "fft.h"
+#include "bench.h"
+#include "level_meter.h"
+#include "playback.h"
+#include "sample_kernels.h"
+#include "signal_generator.h"
+#include "spectrogram.h"
+#include "silence_detector.h"
+#include "stretch.h"
+#include "take_render.h"
+#include "take_store.h"
+#include "thread_pool.h"
+#include "waveform_raster.h"
+#include "waveform_summary.h"
+#include "waveform_tiles.h"
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+const double STRETCH_RATIOS[] = { 0.5, 0.8, 1.25, 2.0 };
+const StretchPreset STRETCH_PRESETS[] = {
+    StretchPreset::Default, StretchPreset::Percussive, StretchPreset::Smooth, StretchPreset::Finer
+};
+
+// A few detuned partials plus a little noise: enough transients and
+// harmonics that the stretcher cannot take shortcuts.
+void fillTestSignal(SAMPLE* out, long frames)
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+    const double twoPi = 6.283185307179586;
+    for (long f = 0; f < frames; f++) {
+        double t = (double)f / SAMPLE_RATE;
+        double env = 0.5 + 0.5 * std::sin(twoPi * 2.0 * t);
+        for (int c = 0; c < NUM_CHANNELS; c++) {
+            double s = 0.3 * std::sin(twoPi * (220.0 + c) * t)
+                + 0.2 * std::sin(twoPi * 330.5 * t)
+                + 0.1 * std::sin(twoPi * 1245.0 * t);
+            out[f * NUM_CHANNELS + c] = (SAMPLE)(env * s) + noise(rng);
+        }
+    }
+}
+
+// Fill the whole planar take the way recordCallback would
+void fillTake(AudioData& data)
+{
+    std::vector<SAMPLE> all(data.maxSamplesBuffer * NUM_CHANNELS);
+    fillTestSignal(all.data(), data.maxSamplesBuffer);
+    data.storeFrames(all.data(), 0, data.maxSamplesBuffer);
+}
+
+// A group runs if the filter names it, part of it, or one of its results
+bool selected(const BenchOptions& options, const std::string& group)
+{
+    return options.filter.empty() || group.find(options.filter) != std::string::npos
+        || options.filter.find(group) != std::string::npos;
+}
+
+std::string formatRatio(double r)
+{
+    std::ostringstream ss;
+    ss << r;
+    return ss.str();
+}
+
+void benchRecordCallback(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    AudioData data;
+    std::vector<SAMPLE> input(FRAMES_PER_BUFFER * NUM_CHANNELS);
+    fillTestSignal(input.data(), FRAMES_PER_BUFFER);
+    PaStreamCallbackTimeInfo timeInfo = {};
+
+    const long blocks = options.quick ? 2000 : 20000;
+    double secs = benchMedianSeconds(options.repeats, [&]() {
+        for (long b = 0; b < blocks; b++) {
+            if (recordCallback(input.data(), nullptr, FRAMES_PER_BUFFER, &timeInfo, 0, &data) != paContinue)
+                data.currentSampleIndex = 0;
+        }
+    });
+
+    double frames = (double)blocks * FRAMES_PER_BUFFER;
+    results.push_back({ "record_callback", {},
+        { { "frames_per_us", frames / (secs * 1e6) }, { "ns_per_block", secs * 1e9 / blocks } } });
+
+    // Armed and waiting: level check plus the pre-roll ring, trigger out of reach
+    data.trigger.openLevel = 2.0f;
+    data.trigger.preRoll.assign(SAMPLE_RATE / 2 * NUM_CHANNELS, SAMPLE_SILENCE);
+    data.trigger.phase.store(CapturePhase::Armed);
+    secs = benchMedianSeconds(options.repeats, [&]() {
+        for (long b = 0; b < blocks; b++)
+            recordCallback(input.data(), nullptr, FRAMES_PER_BUFFER, &timeInfo, 0, &data);
+    });
+    results.push_back({ "record_callback_armed", {},
+        { { "frames_per_us", frames / (secs * 1e6) }, { "ns_per_block", secs * 1e9 / blocks } } });
+}
+
+// ratio 1 is the plain copy path; other ratios go through the streaming stretcher
+void benchPlayCallback(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    AudioData data;
+    fillTake(data);
+    data.totalSamplesRecorded = data.maxSamplesBuffer;
+
+    std::vector<SAMPLE> output(FRAMES_PER_BUFFER * NUM_CHANNELS);
+    PaStreamCallbackTimeInfo timeInfo = {};
+
+    std::vector<double> ratios = { 1.0 };
+    ratios.insert(ratios.end(), std::begin(STRETCH_RATIOS), std::end(STRETCH_RATIOS));
+
+    for (double ratio : ratios)
+    {
+        const long blocks = ratio == 1.0 ? (options.quick ? 2000 : 20000) : (options.quick ? 100 : 1000);
+        data.stretcher.reset();
+        if (ratio != 1.0)
+            data.stretcher = std::make_unique<StreamingStretcher>(NUM_CHANNELS, FRAMES_PER_BUFFER, ratio);
+        data.currentSampleIndex = 0;
+        data.playSourcePos = 0.0;
+
+        std::cerr << "play_callback ratio " << ratio << "\n";
+        double secs = benchMedianSeconds(options.repeats, [&]() {
+            for (long b = 0; b < blocks; b++) {
+                if (playCallback(nullptr, output.data(), FRAMES_PER_BUFFER, &timeInfo, 0, &data) != paContinue) {
+                    data.currentSampleIndex = 0;
+                    data.playSourcePos = 0.0;
+                }
+            }
+        });
+
+        double frames = (double)blocks * FRAMES_PER_BUFFER;
+        double budget = (double)FRAMES_PER_BUFFER / SAMPLE_RATE;
+        results.push_back({ "play_callback", { { "ratio", formatRatio(ratio) } },
+            { { "frames_per_us", frames / (secs * 1e6) },
+              { "ns_per_block", secs * 1e9 / blocks },
+              { "budget_fraction", secs / blocks / budget } } });
+    }
+}
+
+void benchStreamingStretch(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    const long frames = (long)((options.quick ? 1 : 5) * SAMPLE_RATE);
+    std::vector<SAMPLE> input(frames * NUM_CHANNELS);
+    fillTestSignal(input.data(), frames);
+    std::vector<SAMPLE> planar[NUM_CHANNELS];
+    SAMPLE* planarPtrs[NUM_CHANNELS];
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+        planar[c].resize(frames);
+        planarPtrs[c] = planar[c].data();
+    }
+    deinterleave(input.data(), planarPtrs, 0, frames, NUM_CHANNELS);
+    std::vector<SAMPLE> output(FRAMES_PER_BUFFER * NUM_CHANNELS);
+
+    struct Source { SAMPLE* const* data; long frames; long pos; } src = { planarPtrs, frames, 0 };
+    SourcePullFn pull = [](void* ctx, SAMPLE* const* out, unsigned long n) -> unsigned long {
+        Source* s = (Source*)ctx;
+        unsigned long k = std::min<unsigned long>(n, s->frames - s->pos);
+        for (int c = 0; c < NUM_CHANNELS; c++)
+            std::memcpy(out[c], s->data[c] + s->pos, k * sizeof(SAMPLE));
+        s->pos += k;
+        return k;
+    };
+
+    for (double ratio : STRETCH_RATIOS)
+    {
+        std::cerr << "stream_stretch ratio " << ratio << "\n";
+        StreamingStretcher stretcher(NUM_CHANNELS, FRAMES_PER_BUFFER, ratio);
+        long outFrames = 0;
+        double secs = benchMedianSeconds(options.repeats, [&]() {
+            stretcher.reset(ratio);
+            src.pos = 0;
+            outFrames = 0;
+            while (src.pos < src.frames)
+                outFrames += stretcher.render(output.data(), FRAMES_PER_BUFFER, pull, &src);
+        });
+
+        double audioSecs = (double)outFrames / SAMPLE_RATE;
+        results.push_back({ "stream_stretch", { { "ratio", formatRatio(ratio) } },
+            { { "x_realtime", audioSecs / secs }, { "frames_per_us", outFrames / (secs * 1e6) } } });
+    }
+}
+
+// Rendering while recording: what the capture monitor spends per second of
+// take, and what is left to do when the take stops (ready_ms), against
+// stretching the whole take only then (from_scratch_ms)
+void benchTakeRender(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    const long frames = (long)((options.quick ? 2 : 10) * SAMPLE_RATE);
+    std::vector<SAMPLE> input(frames * NUM_CHANNELS);
+    fillTestSignal(input.data(), frames);
+    std::vector<SAMPLE> channels[NUM_CHANNELS];
+    SAMPLE* planar[NUM_CHANNELS];
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+        channels[c].resize(frames);
+        planar[c] = channels[c].data();
+    }
+    deinterleave(input.data(), planar, 0, frames, NUM_CHANNELS);
+
+    for (double ratio : STRETCH_RATIOS)
+    {
+        double scratchSecs = benchMedianSeconds(options.repeats, [&]() {
+            TakeRender render(ratio);
+            render.append(planar, frames);
+            render.finish();
+        });
+
+        // As the monitor does it: one read at a time, then the flush at stop
+        TakeRender render(ratio);
+        const long BLOCK = CaptureMonitor::READ_FRAMES;
+        double appendSecs = benchMedianSeconds(1, [&]() {
+            for (long f = 0; f < frames; f += BLOCK) {
+                const SAMPLE* block[NUM_CHANNELS];
+                for (int c = 0; c < NUM_CHANNELS; c++) block[c] = planar[c] + f;
+                render.append(block, std::min(BLOCK, frames - f));
+            }
+        });
+        double readySecs = benchMedianSeconds(1, [&]() { render.finish(); });
+
+        results.push_back({ "take_render", { { "ratio", formatRatio(ratio) } },
+            { { "x_realtime", (double)frames / SAMPLE_RATE / appendSecs },
+              { "ready_ms", readySecs * 1e3 },
+              { "from_scratch_ms", scratchSecs * 1e3 } } });
+    }
+}
+
+void benchOfflineStretch(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    const long frames = (long)((options.quick ? 1 : 5) * SAMPLE_RATE);
+    std::vector<SAMPLE> input(frames * NUM_CHANNELS);
+    fillTestSignal(input.data(), frames);
+    std::vector<float> output;
+    ScratchArena scratch;
+
+    // Offline renders are long enough that one run is a stable number.
+    // A second render of the same case checks that nothing large is
+    // allocated once scratch and output have grown to fit.
+    for (StretchPreset preset : STRETCH_PRESETS)
+    {
+        for (double ratio : STRETCH_RATIOS)
+        {
+            std::cerr << "offline_stretch " << stretchPresetName(preset) << " ratio " << ratio << "\n";
+            StretchParams params;
+            params.ratio = ratio;
+            params.preset = preset;
+
+            double secs = benchMedianSeconds(1, [&]() {
+                renderStretched(input.data(), frames, NUM_CHANNELS, SAMPLE_RATE, params, output, &scratch);
+            });
+
+            size_t allocsBefore = scratch.systemAllocations();
+            const float* outputBefore = output.data();
+            renderStretched(input.data(), frames, NUM_CHANNELS, SAMPLE_RATE, params, output, &scratch);
+            bool reallocated = scratch.systemAllocations() != allocsBefore || output.data() != outputBefore;
+
+            double inputSecs = (double)frames / SAMPLE_RATE;
+            results.push_back({ "offline_stretch",
+                { { "preset", stretchPresetName(preset) }, { "ratio", formatRatio(ratio) } },
+                { { "x_realtime", inputSecs / secs },
+                  { "scratch_kb", scratch.capacity() / 1024.0 },
+                  { "repeat_allocs", reallocated ? 1.0 : 0.0 } } });
+        }
+    }
+}
+
+// All STRETCH_RATIOS of one source: one after another, as independent
+// parallel jobs that each read the interleaved input (the CLI before
+// StretchBatch), and as one StretchBatch feeding each block to all of them
+void benchStretchBatch(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    const long frames = (long)((options.quick ? 1 : 5) * SAMPLE_RATE);
+    std::vector<SAMPLE> input(frames * NUM_CHANNELS);
+    fillTestSignal(input.data(), frames);
+    const std::vector<double> ratios(std::begin(STRETCH_RATIOS), std::end(STRETCH_RATIOS));
+    ThreadPool pool;
+
+    std::cerr << "stretch_batch\n";
+    std::vector<std::vector<float>> outs(ratios.size());
+    double sequential = benchMedianSeconds(1, [&]() {
+        for (size_t i = 0; i < ratios.size(); i++) {
+            StretchParams params;
+            params.ratio = ratios[i];
+            renderStretched(input.data(), frames, NUM_CHANNELS, SAMPLE_RATE, params, outs[i]);
+        }
+    });
+
+    double independent = benchMedianSeconds(1, [&]() {
+        std::vector<std::future<size_t>> jobs;
+        for (size_t i = 0; i < ratios.size(); i++) {
+            jobs.push_back(pool.submit([&, i]() {
+                StretchParams params;
+                params.ratio = ratios[i];
+                return renderStretched(input.data(), frames, NUM_CHANNELS, SAMPLE_RATE, params, outs[i]);
+            }));
+        }
+        for (auto& j : jobs) j.get();
+    });
+
+    double batched = benchMedianSeconds(1, [&]() {
+        StretchBatch batch(input.data(), frames, NUM_CHANNELS, SAMPLE_RATE);
+        batch.renderAll(pool, StretchParams(), ratios, outs);
+    });
+
+    // Output of all ratios per second of wall time, in seconds of input
+    double inputSecs = (double)frames / SAMPLE_RATE * ratios.size();
+    results.push_back({ "stretch_batch", { { "ratios", std::to_string(ratios.size()) } },
+        { { "sequential_x_realtime", inputSecs / sequential },
+          { "independent_x_realtime", inputSecs / independent },
+          { "batch_x_realtime", inputSecs / batched },
+          { "threads", (double)pool.size() } } });
+}
+
+// Full build as after a resize, and the per-block update done while recording
+void benchWaveformSummary(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    AudioData data;
+    fillTake(data);
+    WaveformSummary summary;
+
+    for (int columns : { 1920, 3840 })
+    {
+        double secs = benchMedianSeconds(options.repeats, [&]() {
+            summary.build(data, 0, data.maxSamplesBuffer, data.maxSamplesBuffer, columns);
+        });
+        results.push_back({ "summary_build", { { "columns", std::to_string(columns) },
+            { "frames", std::to_string(data.maxSamplesBuffer) } },
+            { { "ms", secs * 1e3 }, { "frames_per_us", data.maxSamplesBuffer / (secs * 1e6) } } });
+    }
+
+    const long blocks = data.maxSamplesBuffer / FRAMES_PER_BUFFER;
+    double secs = benchMedianSeconds(options.repeats, [&]() {
+        summary.reset(data.maxSamplesBuffer, 1920);
+        for (long b = 0; b < blocks; b++)
+            summary.update(data, 0, b * FRAMES_PER_BUFFER, (b + 1) * FRAMES_PER_BUFFER);
+    });
+    results.push_back({ "summary_update", { { "columns", "1920" } },
+        { { "ns_per_block", secs * 1e9 / blocks } } });
+}
+
+// Full redraw of the waveform raster (resize, new take), the same sizes as
+// paint_full draws through a DC, and one marker move
+void benchWaveformRaster(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    AudioData data;
+    fillTake(data);
+    WaveformSummary summary;
+    WaveformRaster raster;
+
+    const int sizes[][2] = { { 1920, 300 }, { 3840, 600 } };
+    for (const auto& size : sizes)
+    {
+        summary.build(data, 0, data.maxSamplesBuffer, data.maxSamplesBuffer, size[0]);
+        raster.resize(size[0], size[1]);
+
+        double fullSecs = benchMedianSeconds(options.repeats, [&]() {
+            raster.drawColumns(summary, 0, size[0] - 1);
+        });
+
+        const int moves = 1000;
+        double markerSecs = benchMedianSeconds(options.repeats, [&]() {
+            for (int m = 0; m < moves; m++) {
+                int x = m % size[0];
+                raster.drawColumns(summary, x, x);
+                raster.drawMarker(x + 1);
+            }
+        });
+
+        std::string dims = std::to_string(size[0]) + "x" + std::to_string(size[1]);
+        results.push_back({ "raster", { { "size", dims } },
+            { { "full_ms", fullSecs * 1e3 }, { "marker_us", markerSecs * 1e6 / moves } } });
+    }
+}
+
+// Spectrogram analysis as the capture monitor runs it (planar blocks of
+// READ_FRAMES), as a share of real time, plus one transform on its own and
+// a full redraw of the spectrogram view from the stored spectra
+void benchSpectrogram(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    AudioData data;
+    fillTake(data);
+
+    const long seconds = options.quick ? 10 : 60;
+    const long frames = std::min<long>(seconds * SAMPLE_RATE, data.maxSamplesBuffer);
+    const long block = CaptureMonitor::READ_FRAMES;
+    std::vector<SAMPLE> planar(block * NUM_CHANNELS);
+    SAMPLE* channels[NUM_CHANNELS];
+    for (int c = 0; c < NUM_CHANNELS; c++)
+        channels[c] = planar.data() + c * block;
+
+    Spectrogram spectrogram(frames);
+    double secs = benchMedianSeconds(options.repeats, [&]() {
+        spectrogram.reset();
+        for (long f = 0; f < frames; f += block) {
+            long n = std::min(block, frames - f);
+            for (int c = 0; c < NUM_CHANNELS; c++)
+                data.loadFrames(c, f, n, channels[c]);
+            spectrogram.process(channels, NUM_CHANNELS, n);
+        }
+    });
+    const double audioSecs = (double)frames / SAMPLE_RATE;
+    results.push_back({ "spectrogram", { { "fft_size", std::to_string(Spectrogram::FFT_SIZE) },
+        { "hop", std::to_string(Spectrogram::HOP) }, { "channels", std::to_string(NUM_CHANNELS) } },
+        { { "us_per_audio_second", secs * 1e6 / audioSecs }, { "realtime_percent", secs * 100.0 / audioSecs } } });
+
+    auto plan = FftPlan::forSize(Spectrogram::FFT_SIZE);
+    std::vector<float> in(Spectrogram::FFT_SIZE), re(Spectrogram::FFT_SIZE / 2), im(Spectrogram::FFT_SIZE / 2);
+    data.loadFrames(0, 0, Spectrogram::FFT_SIZE, in.data());
+    const int transforms = 10000;
+    secs = benchMedianSeconds(options.repeats, [&]() {
+        for (int i = 0; i < transforms; i++)
+            plan->forward(in.data(), nullptr, re.data(), im.data());
+    });
+    results.push_back({ "spectrogram_fft", { { "size", std::to_string(Spectrogram::FFT_SIZE) } },
+        { { "ns_per_transform", secs * 1e9 / transforms } } });
+
+    WaveformRaster raster;
+    raster.resize(1920, 300);
+    secs = benchMedianSeconds(options.repeats, [&]() {
+        raster.drawSpectrum(spectrogram, 0, frames, 1920, 0, 1919);
+    });
+    results.push_back({ "spectrogram_raster", { { "size", "1920x300" }, { "seconds", std::to_string(seconds) } },
+        { { "full_ms", secs * 1e3 } } });
+}
+
+// Tiled zoomed-in view: a screen of tiles rendered from scratch on the
+// pool, then a scroll by one tile, which should render only the new one
+void benchWaveformTiles(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    AudioData data;
+    fillTake(data);
+    data.totalSamplesRecorded = data.maxSamplesBuffer;
+
+    const int width = 3840, height = 600, level = 6;
+    const long visible = width / WaveformTiles::TILE_COLUMNS;
+    WaveformTiles tiles(&data);
+    tiles.setHeight(height);
+
+    // Ask for the screen the way WavePanel paints it, until all of it is there
+    auto show = [&](long first) {
+        for (;;) {
+            bool all = true;
+            for (long i = first; i < first + visible; i++)
+                all = tiles.get(level, i) != nullptr && all;
+            if (all) return;
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    };
+
+    double coldSecs = benchMedianSeconds(options.repeats, [&]() {
+        tiles.invalidate();
+        show(0);
+    });
+
+    long first = 0;
+    unsigned rendered = 0;
+    show(first);
+    double scrollSecs = benchMedianSeconds(options.repeats, [&]() {
+        unsigned before = tiles.generation();
+        show(++first);
+        rendered += tiles.generation() - before;
+    });
+
+    results.push_back({ "tiles", { { "size", std::to_string(width) + "x" + std::to_string(height) },
+        { "level", std::to_string(level) } },
+        { { "cold_ms", coldSecs * 1e3 }, { "scroll_ms", scrollSecs * 1e3 },
+          { "tiles_per_scroll", (double)rendered / options.repeats } } });
+}
+
+// Interleave conversions at callback block size, as done by the callbacks
+void benchSampleKernels(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    const long blocks = (long)NUM_SECONDS * SAMPLE_RATE / FRAMES_PER_BUFFER;
+    std::vector<SAMPLE> channels[NUM_CHANNELS];
+    SAMPLE* planar[NUM_CHANNELS];
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+        channels[c].resize(blocks * FRAMES_PER_BUFFER);
+        planar[c] = channels[c].data();
+    }
+    std::vector<SAMPLE> block(FRAMES_PER_BUFFER * NUM_CHANNELS);
+    fillTestSignal(block.data(), FRAMES_PER_BUFFER);
+
+    double secs = benchMedianSeconds(options.repeats, [&]() {
+        for (long b = 0; b < blocks; b++)
+            deinterleave(block.data(), planar, b * FRAMES_PER_BUFFER, FRAMES_PER_BUFFER, NUM_CHANNELS);
+    });
+    results.push_back({ "deinterleave", {},
+        { { "frames_per_us", (double)blocks * FRAMES_PER_BUFFER / (secs * 1e6) } } });
+
+    secs = benchMedianSeconds(options.repeats, [&]() {
+        for (long b = 0; b < blocks; b++)
+            interleave(planar, b * FRAMES_PER_BUFFER, block.data(), FRAMES_PER_BUFFER, NUM_CHANNELS);
+    });
+    results.push_back({ "interleave", {},
+        { { "frames_per_us", (double)blocks * FRAMES_PER_BUFFER / (secs * 1e6) } } });
+}
+
+// Level meter as the callbacks run it, on one block of a take at a time:
+// the test signal (half a second, so its swells rise and fall), a steady
+// sine, where no block can leave out the inter-sample peaks, and silence.
+// The sine sets the budget: its one pass is 16 float ops on every 4 frames,
+// 2 cycles a frame on cores with two SSE float ports, so about 500 ns a
+// block at 2 GHz. The budget leaves twice that for noisy CI machines, still
+// under a ten-thousandth of the block period. Any input over it fails the
+// run.
+void benchLevelMeter(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    const double BUDGET_NS = 1000.0;
+    const long blocks = options.quick ? 2000 : 20000;
+    const long takeBlocks = SAMPLE_RATE / 2 / FRAMES_PER_BUFFER;
+    std::vector<SAMPLE> signal(takeBlocks * FRAMES_PER_BUFFER * NUM_CHANNELS);
+    fillTestSignal(signal.data(), takeBlocks * FRAMES_PER_BUFFER);
+    std::vector<SAMPLE> steady(signal.size());
+    for (size_t i = 0; i < steady.size(); i++)
+        steady[i] = (SAMPLE)(0.5 * std::sin(6.283185307179586 * 997.0 * (i / NUM_CHANNELS) / SAMPLE_RATE));
+
+    const std::pair<const char*, const std::vector<SAMPLE>*> inputs[] = {
+        { "signal", &signal }, { "steady", &steady }, { "silence", nullptr }
+    };
+    LevelMeter meter;
+    for (const auto& input : inputs)
+    {
+        meter.reset(SAMPLE_RATE);
+        double secs = benchMedianSeconds(options.repeats, [&]() {
+            for (long b = 0; b < blocks; b++)
+                meter.process(input.second ? input.second->data() + (b % takeBlocks) * FRAMES_PER_BUFFER * NUM_CHANNELS : nullptr,
+                    FRAMES_PER_BUFFER);
+        });
+        const double ns = secs * 1e9 / blocks;
+        const bool within = ns <= BUDGET_NS;
+        if (!within)
+            std::cerr << "level_meter: " << input.first << " " << ns << " ns per block, over the " << BUDGET_NS << " ns budget\n";
+        results.push_back({ "level_meter", { { "input", input.first } },
+            { { "ns_per_block", ns }, { "budget_ns", BUDGET_NS },
+              { "within_budget", within ? 1.0 : 0.0 },
+              { "frames_per_us", (double)blocks * FRAMES_PER_BUFFER / (secs * 1e6) },
+              { "budget_fraction", ns * 1e-9 * SAMPLE_RATE / FRAMES_PER_BUFFER } },
+            !within });
+    }
+
+    LevelMeter::Snapshot snap;
+    const long reads = 1000000;
+    double secs = benchMedianSeconds(options.repeats, [&]() {
+        for (long i = 0; i < reads; i++)
+            snap = meter.snapshot();
+    });
+    results.push_back({ "level_meter_snapshot", {}, { { "ns_per_snapshot", secs * 1e9 / reads } } });
+}
+
+// Silence detector on a take laid out as 3 s silence, 5 s sound, 4 s gap,
+// 5 s sound, 3 s silence: speed, and how much of the take trimming and gap
+// skipping leave to be stretched.
+void benchSilenceDetector(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    const long second = SAMPLE_RATE, frames = 20 * second;
+    std::vector<SAMPLE> sound(5 * second * NUM_CHANNELS);
+    fillTestSignal(sound.data(), 5 * second);
+
+    std::vector<SAMPLE> channels[NUM_CHANNELS];
+    SAMPLE* planar[NUM_CHANNELS];
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+        channels[c].assign(frames, SAMPLE_SILENCE);
+        planar[c] = channels[c].data();
+    }
+    deinterleave(sound.data(), planar, 3 * second, 5 * second, NUM_CHANNELS);
+    deinterleave(sound.data(), planar, 12 * second, 5 * second, NUM_CHANNELS);
+
+    SilenceDetector detector(SAMPLE_RATE);
+    double secs = benchMedianSeconds(options.repeats, [&]() {
+        detector.reset();
+        for (long f = 0; f < frames; f += FRAMES_PER_BUFFER) {
+            const SAMPLE* block[NUM_CHANNELS];
+            for (int c = 0; c < NUM_CHANNELS; c++) block[c] = planar[c] + f;
+            detector.process(block, NUM_CHANNELS, std::min<long>(FRAMES_PER_BUFFER, frames - f));
+        }
+    });
+
+    SilentRegion keep = detector.soundBounds();
+    long skipped = 0;
+    for (const SilentRegion& gap : detector.gaps())
+        skipped += gap.end - gap.start;
+
+    results.push_back({ "silence", {},
+        { { "x_realtime", (double)frames / SAMPLE_RATE / secs },
+          { "kept_fraction", (double)(keep.end - keep.start) / frames },
+          { "played_fraction", (double)(keep.end - keep.start - skipped) / frames } } });
+}
+
+// Signal-to-error ratio of a store / load round trip, in dB
+double roundTripSnr(AudioData& data, const std::vector<SAMPLE>& input, long frames, double& maxError)
+{
+    data.storeFrames(input.data(), 0, frames);
+    std::vector<SAMPLE> back(frames);
+    double signal = 0.0, error = 0.0;
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+        data.loadFrames(c, 0, frames, back.data());
+        for (long f = 0; f < frames; f++) {
+            double s = input[f * NUM_CHANNELS + c], e = back[f] - s;
+            signal += s * s;
+            error += e * e;
+            maxError = std::max(maxError, std::fabs(e));
+        }
+    }
+    return error > 0.0 ? 10.0 * std::log10(signal / error) : INFINITY;
+}
+
+// Per SampleStorage: take length, cost of the conversions in the record /
+// playback paths and for the waveform summary, and what the round trip loses
+// on the test signal at its own level and 40 dB down.
+void benchSampleStorage(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    const long frames = (long)(options.quick ? 2 : 10) * SAMPLE_RATE;
+    std::vector<SAMPLE> input(frames * NUM_CHANNELS);
+    fillTestSignal(input.data(), frames);
+    std::vector<SAMPLE> quiet(input);
+    for (SAMPLE& s : quiet) s *= 0.01f;
+    std::vector<SAMPLE> out(FRAMES_PER_BUFFER);
+
+    for (SampleStorage storage : { SampleStorage::Float32, SampleStorage::Int16, SampleStorage::Float16 })
+    {
+        AudioData data(storage, false);
+        double maxError = 0.0, quietMaxError = 0.0;
+        double snr = roundTripSnr(data, input, frames, maxError);
+        double quietSnr = roundTripSnr(data, quiet, frames, quietMaxError);
+
+        const long blocks = frames / FRAMES_PER_BUFFER;
+        double storeSecs = benchMedianSeconds(options.repeats, [&]() {
+            for (long b = 0; b < blocks; b++)
+                data.storeFrames(input.data() + b * FRAMES_PER_BUFFER * NUM_CHANNELS, b * FRAMES_PER_BUFFER,
+                    FRAMES_PER_BUFFER);
+        });
+        double loadSecs = benchMedianSeconds(options.repeats, [&]() {
+            for (long b = 0; b < blocks; b++)
+                for (int c = 0; c < NUM_CHANNELS; c++)
+                    data.loadFrames(c, b * FRAMES_PER_BUFFER, FRAMES_PER_BUFFER, out.data());
+        });
+
+        fillTake(data);
+        WaveformSummary summary;
+        double summarySecs = benchMedianSeconds(options.repeats, [&]() {
+            summary.build(data, 0, data.maxSamplesBuffer, data.maxSamplesBuffer, 1920);
+        });
+
+        BenchResult result = { "storage", { { "format", sampleStorageName(storage) } },
+            { { "capacity_s", (double)data.maxSamplesBuffer / SAMPLE_RATE },
+              { "store_ns_per_block", storeSecs * 1e9 / blocks },
+              { "load_frames_per_us", (double)blocks * FRAMES_PER_BUFFER / (loadSecs * 1e6) },
+              { "summary_frames_per_us", data.maxSamplesBuffer / (summarySecs * 1e6) },
+              { "max_error", maxError },
+              { "max_error_minus40", quietMaxError } } };
+        // lossless formats have no finite SNR, and JSON has no infinity
+        if (std::isfinite(snr)) result.metrics.push_back({ "snr_db", snr });
+        if (std::isfinite(quietSnr)) result.metrics.push_back({ "snr_db_minus40", quietSnr });
+        results.push_back(result);
+    }
+}
+
+// Packing of a compressed take: how small each kind of content gets, and
+// how much faster than real time the worker packs and unpacks it. The take
+// is stored a chunk at a time, with the worker's work done in between.
+// What a take in `storage` gives back for `in`: narrowed as storeFrames()
+// narrows it, then widened again
+void storedAs(SampleStorage storage, const SAMPLE* in, SAMPLE* out, size_t n)
+{
+    std::vector<int16_t> int16(storage == SampleStorage::Int16 ? n : 0);
+    std::vector<uint16_t> half(storage == SampleStorage::Float16 ? n : 0);
+    switch (storage) {
+    case SampleStorage::Int16:
+        floatToInt16(in, int16.data(), n);
+        int16ToFloat(int16.data(), out, n);
+        break;
+    case SampleStorage::Float16:
+        floatToHalf(in, half.data(), n);
+        halfToFloat(half.data(), out, n);
+        break;
+    case SampleStorage::Float32:
+    default:
+        std::copy(in, in + n, out);
+        break;
+    }
+}
+
+void benchTakePacking(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    const long chunk = TakeStore::CHUNK_FRAMES;
+    const long chunks = options.quick ? 8 : 40;
+    const long frames = chunks * chunk;
+    std::vector<SAMPLE> tone(frames * NUM_CHANNELS);
+    fillTestSignal(tone.data(), frames);
+
+    // 16-bit PCM played at unity gain arrives as exact multiples of 2^-15
+    std::vector<SAMPLE> pcm(tone);
+    for (SAMPLE& s : pcm) s = std::lrint(s * 32767.0f) / 32768.0f;
+    std::vector<SAMPLE> silence(frames * NUM_CHANNELS, SAMPLE_SILENCE);
+
+    const std::pair<const char*, const std::vector<SAMPLE>*> signals[] = {
+        { "silence", &silence }, { "pcm16", &pcm }, { "float", &tone }
+    };
+
+    for (SampleStorage storage : { SampleStorage::Float32, SampleStorage::Int16, SampleStorage::Float16 })
+    {
+        for (const auto& signal : signals)
+        {
+            AudioData data(storage, true);
+            TakeStore& take = *data.take;
+            take.beginTake();
+
+            auto t0 = std::chrono::steady_clock::now();
+            for (long at = 0; at < frames; at += chunk) {
+                data.storeFrames(signal.second->data() + at * NUM_CHANNELS, at, chunk);
+                take.settle();
+            }
+            take.hint(frames);  // move the read window off the take
+            take.settle();
+            double packSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            TakeStore::Usage usage = take.usage();
+
+            // Reading a channel back unpacks every packed chunk once
+            std::vector<SAMPLE> out(frames);
+            t0 = std::chrono::steady_clock::now();
+            take.read(0, 0, frames, out.data());
+            double unpackSecs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+            // Packed, evicted and unpacked, every channel must still hold
+            // the bits storeFrames() wrote
+            long mismatched = 0;
+            std::vector<SAMPLE> sent(frames), expected(frames);
+            for (int c = 0; c < NUM_CHANNELS; c++) {
+                for (long f = 0; f < frames; f++)
+                    sent[f] = (*signal.second)[f * NUM_CHANNELS + c];
+                storedAs(storage, sent.data(), expected.data(), frames);
+                take.read(c, 0, frames, out.data());
+                for (long f = 0; f < frames; f++)
+                    mismatched += std::memcmp(&out[f], &expected[f], sizeof(SAMPLE)) != 0;
+            }
+
+            double rawBytes = (double)usage.packedChunks * chunk * NUM_CHANNELS * sampleStorageBytes(storage);
+            double audioSecs = (double)frames / SAMPLE_RATE;
+            results.push_back({ "take_pack", { { "format", sampleStorageName(storage) }, { "signal", signal.first } },
+                { { "packed_chunks", (double)usage.packedChunks },
+                  { "packed_fraction", rawBytes > 0 ? usage.packedBytes / rawBytes : 1.0 },
+                  { "pack_x_realtime", audioSecs / packSecs },
+                  { "unpack_x_realtime", audioSecs / unpackSecs },
+                  { "misses", (double)usage.misses },
+                  { "bit_exact", mismatched == 0 ? 1.0 : 0.0 },
+                  { "mismatched_samples", (double)mismatched } },
+                mismatched != 0 });
+        }
+    }
+}
+
+// Stereo at SAMPLE_RATE, generated in callback-sized blocks
+void benchSignalGenerator(const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    const char* specs[] = { "sine:1000", "sweep", "noise", "impulse", "tones", "saw" };
+    const long blocks = (long)((options.quick ? 10 : 60) * SAMPLE_RATE / FRAMES_PER_BUFFER);
+    std::vector<SAMPLE> out(FRAMES_PER_BUFFER * NUM_CHANNELS);
+
+    for (const char* spec : specs)
+    {
+        SignalParams params;
+        std::string error;
+        parseSignalSpec(spec, params, error);
+        SignalGenerator gen(params, SAMPLE_RATE, NUM_CHANNELS);
+
+        double secs = benchMedianSeconds(options.repeats, [&]() {
+            gen.reset();
+            for (long b = 0; b < blocks; b++)
+                gen.generate(out.data(), FRAMES_PER_BUFFER);
+        });
+
+        double audioSecs = (double)blocks * FRAMES_PER_BUFFER / SAMPLE_RATE;
+        results.push_back({ "generator", { { "signal", spec } },
+            { { "x_realtime", audioSecs / secs }, { "ns_per_block", secs * 1e9 / blocks } } });
+    }
+}
+
+void writeJson(std::ostream& os, const BenchOptions& options, const std::vector<BenchResult>& results)
+{
+    os << "{\n  \"sample_rate\": " << SAMPLE_RATE
+        << ",\n  \"frames_per_buffer\": " << FRAMES_PER_BUFFER
+        << ",\n  \"quick\": " << (options.quick ? "true" : "false")
+        << ",\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        os << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "\"";
+        for (const auto& p : r.params)
+            os << ", \"" << p.first << "\": \"" << p.second << "\"";
+        for (const auto& m : r.metrics)
+            os << ", \"" << m.first << "\": " << m.second;
+        os << "}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string a = argv[i];
+        if (a == "--quick") {
+            options.quick = true;
+            options.repeats = 3;
+        }
+        else if (a == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        }
+        else if (a == "--repeats" && i + 1 < argc) {
+            options.repeats = std::max(1, std::atoi(argv[++i]));
+        }
+        else {
+            std::cerr << "usage: " << argv[0] << " [--quick] [--filter NAME] [--repeats N]\n";
+            return a == "-h" || a == "--help" ? 0 : 2;
+        }
+    }
+
+    std::vector<BenchResult> results;
+
+    if (selected(options, "record_callback")) benchRecordCallback(options, results);
+    if (selected(options, "play_callback")) benchPlayCallback(options, results);
+    if (selected(options, "stream_stretch")) benchStreamingStretch(options, results);
+    if (selected(options, "offline_stretch")) benchOfflineStretch(options, results);
+    if (selected(options, "stretch_batch")) benchStretchBatch(options, results);
+    if (selected(options, "take_render")) benchTakeRender(options, results);
+    if (selected(options, "summary")) benchWaveformSummary(options, results);
+    if (selected(options, "raster")) benchWaveformRaster(options, results);
+    if (selected(options, "tiles")) benchWaveformTiles(options, results);
+    if (selected(options, "spectrogram")) benchSpectrogram(options, results);
+    if (selected(options, "level_meter")) benchLevelMeter(options, results);
+    if (selected(options, "generator")) benchSignalGenerator(options, results);
+    if (selected(options, "interleave")) benchSampleKernels(options, results);
+    if (selected(options, "storage")) benchSampleStorage(options, results);
+    if (selected(options, "take_pack")) benchTakePacking(options, results);
+    if (selected(options, "silence")) benchSilenceDetector(options, results);
+
+#ifdef SC_BENCH_PAINT
+    if (selected(options, "paint") && !runPaintBenchmarks(argc, argv, options, results))
+        std::cerr << "paint benchmarks skipped: no display\n";
+#endif
+
+    std::cout.precision(6);
+    writeJson(std::cout, options, results);
+
+    int failed = 0;
+    for (const BenchResult& r : results) {
+        if (r.failed) {
+            std::cerr << "failed: " << r.name;
+            for (const auto& p : r.params) std::cerr << " " << p.first << "=" << p.second;
+            std::cerr << "\n";
+            failed++;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * One line of soundcard_bench output. Params identify the case (ratio,
+ * preset, size), metrics are the measured numbers; both end up as flat
+ * JSON fields so results can be diffed and plotted across commits.
+ */
+struct BenchResult {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> params;
+    std::vector<std::pair<std::string, double>> metrics;
+    bool failed = false;  // a check the benchmark makes did not hold: exit 1
+};
+
+struct BenchOptions {
+    bool quick = false;        // shorter inputs and fewer repeats, for CI
+    std::string filter;        // run only benchmarks whose name contains this
+    int repeats = 5;           // timings are the median over repeats
+};
+
+// Median wall time of `repeats` calls of f(), in seconds
+template <class F>
+double benchMedianSeconds(int repeats, F&& f)
+{
+    std::vector<double> times;
+    for (int i = 0; i < repeats; i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        f();
+        times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+#ifdef SC_BENCH_PAINT
+// bench_paint.cpp: needs wxWidgets and a display; returns false (and adds
+// nothing) when the GUI cannot be initialised
+bool runPaintBenchmarks(int argc, char** argv, const BenchOptions& options, std::vector<BenchResult>& results);
+#endif
@@ -0,0 +1,89 @@
+// Waveform paint benchmarks for soundcard_bench. Draws into an offscreen
+// bitmap with the same code WavePanel uses, so it measures the DC work
+// per frame: a full redraw (resize, new take) and the incremental update
+// done by each 33 ms redraw tick while recording, and the copy to the
+// screen of the whole bitmap against only the columns a tick changed.
+#include "bench.h"
+#include "waveform_draw.h"
+#include <wx/wx.h>
+#include <wx/dcmemory.h>
+#include <wx/init.h>
+#include <cmath>
+
+bool runPaintBenchmarks(int argc, char** argv, const BenchOptions& options, std::vector<BenchResult>& results)
+{
+    wxApp::SetInstance(new wxApp());
+    if (!wxEntryStart(argc, argv))
+        return false;
+
+    AudioData data;
+    std::vector<SAMPLE> take(data.maxSamplesBuffer * NUM_CHANNELS);
+    for (long f = 0; f < data.maxSamplesBuffer; f++) {
+        float s = 0.8f * std::sin(f * 0.013f) * std::sin(f * 0.00007f);
+        for (int c = 0; c < NUM_CHANNELS; c++)
+            take[f * NUM_CHANNELS + c] = s;
+    }
+    data.storeFrames(take.data(), 0, data.maxSamplesBuffer);
+
+    const int sizes[][2] = { { 1920, 300 }, { 3840, 600 } };
+    for (const auto& size : sizes)
+    {
+        const int width = size[0], height = size[1];
+        wxBitmap bmp(width, height);
+        WaveformSummary summary;
+        summary.build(data, 0, data.maxSamplesBuffer, data.maxSamplesBuffer, width);
+
+        double fullSecs = benchMedianSeconds(options.repeats, [&]() {
+            wxMemoryDC memdc(bmp);
+            memdc.SetBackground(*wxWHITE_BRUSH);
+            memdc.Clear();
+            drawWaveformColumns(memdc, summary, 0, width - 1, height);
+        });
+
+        // One redraw tick of recording: ~33 ms of new frames plus the marker
+        const long tickFrames = SAMPLE_RATE * 33 / 1000;
+        const int ticks = 200;
+        double tickSecs = benchMedianSeconds(options.repeats, [&]() {
+            wxMemoryDC memdc(bmp);
+            for (int t = 0; t < ticks; t++) {
+                long from = (t * tickFrames) % (data.maxSamplesBuffer - tickFrames);
+                int first = summary.columnOf(from), last = summary.columnOf(from + tickFrames - 1);
+                drawWaveformColumns(memdc, summary, first, last, height);
+                memdc.SetPen(*wxBLUE_PEN);
+                memdc.DrawLine(last + 1, 0, last + 1, height);
+            }
+        });
+
+        // Copy to a second bitmap standing in for the window: the whole
+        // bitmap every tick, or (as WavePanel does) the changed columns,
+        // and nothing on ticks where no column was finished
+        wxBitmap screen(width, height);
+        double fullBlitSecs = benchMedianSeconds(options.repeats, [&]() {
+            wxMemoryDC src(bmp), dst(screen);
+            for (int t = 0; t < ticks; t++)
+                dst.Blit(0, 0, width, height, &src, 0, 0);
+        });
+        int skipped = 0;
+        double dirtyBlitSecs = benchMedianSeconds(options.repeats, [&]() {
+            wxMemoryDC src(bmp), dst(screen);
+            skipped = 0;
+            for (int t = 0; t < ticks; t++) {
+                long from = (t * tickFrames) % (data.maxSamplesBuffer - tickFrames);
+                int first = summary.columnOf(from), last = summary.columnOf(from + tickFrames);
+                if (first == last) { skipped++; continue; }
+                dst.Blit(first, 0, last - first + 2, height, &src, first, 0);
+            }
+        });
+
+        std::string dims = std::to_string(width) + "x" + std::to_string(height);
+        results.push_back({ "paint_full", { { "size", dims } }, { { "ms_per_frame", fullSecs * 1e3 } } });
+        results.push_back({ "paint_tick", { { "size", dims } }, { { "us_per_frame", tickSecs * 1e6 / ticks } } });
+        results.push_back({ "paint_blit", { { "size", dims } },
+            { { "full_us_per_tick", fullBlitSecs * 1e6 / ticks },
+              { "dirty_us_per_tick", dirtyBlitSecs * 1e6 / ticks },
+              { "skipped_ticks", (double)skipped / ticks } } });
+    }
+
+    wxEntryCleanup();
+    return true;
+}
@@ -0,0 +1,88 @@
+#include "capture_monitor.h"
+#include "spectrogram.h"
+#include "take_store.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// How often the thread looks for new frames; a few callbacks' worth
+const std::chrono::milliseconds MONITOR_PERIOD(10);
+
+} // namespace
+
+void CaptureMonitor::start(double sampleRate, const SilenceSettings& settings)
+{
+    finish(0);
+
+    detector = SilenceDetector(sampleRate, settings);
+    consumed = 0;
+    buffer.resize(READ_FRAMES * NUM_CHANNELS);
+    render.reset();
+    data->spectrogram->reset();
+    stopping.store(false);
+    thread = std::thread(&CaptureMonitor::run, this);
+}
+
+void CaptureMonitor::finish(long frames)
+{
+    if (!thread.joinable()) return;
+
+    stopping.store(true);
+    thread.join();
+    consume(frames);
+    if (render)
+        render->finish();
+}
+
+void CaptureMonitor::run()
+{
+    while (!stopping.load())
+    {
+        consume(data->take->stored());
+        std::this_thread::sleep_for(MONITOR_PERIOD);
+    }
+}
+
+void CaptureMonitor::consume(long upTo)
+{
+    SAMPLE* channels[NUM_CHANNELS];
+    for (int c = 0; c < NUM_CHANNELS; c++)
+        channels[c] = buffer.data() + c * READ_FRAMES;
+
+    double ratio = renderRatio.load();
+    if (render ? render->ratio() != ratio : ratio != 1.0)
+        restartRender(ratio);
+
+    while (consumed < upTo)
+    {
+        long n = std::min(upTo - consumed, READ_FRAMES);
+        for (int c = 0; c < NUM_CHANNELS; c++)
+            data->take->read(c, consumed, n, channels[c]);
+        detector.process(channels, NUM_CHANNELS, n);
+        data->spectrogram->process(channels, NUM_CHANNELS, n);
+        if (render)
+            render->append(channels, n);
+        consumed += n;
+    }
+}
+
+// New ratio: stretch what is already in the take again
+void CaptureMonitor::restartRender(double ratio)
+{
+    render.reset();
+    if (ratio == 1.0) return;
+
+    render = std::make_unique<TakeRender>(ratio);
+    SAMPLE* channels[NUM_CHANNELS];
+    for (int c = 0; c < NUM_CHANNELS; c++)
+        channels[c] = buffer.data() + c * READ_FRAMES;
+
+    for (long frame = 0; frame < consumed; frame += READ_FRAMES)
+    {
+        long n = std::min(consumed - frame, READ_FRAMES);
+        for (int c = 0; c < NUM_CHANNELS; c++)
+            data->take->read(c, frame, n, channels[c]);
+        render->append(channels, n);
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include "silence_detector.h"
+#include "take_render.h"
+#include "utils.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+/* Consumer side of capture: a thread that follows the recorder through
+** the take and analyses the new frames, so the record callback only has
+** to store them. It reads with TakeStore::read(), which also works on
+** chunks that were packed before it got to them.
+**
+** It also stretches the take as it grows at the render ratio (the speed
+** slider), so playback can start from a finished TakeRender. When the
+** ratio changes mid-take, the render starts over from frame 0. And it
+** feeds AudioData::spectrogram, for the spectrogram view.
+*/
+class CaptureMonitor {
+public:
+    static const long READ_FRAMES = 4096;  // frames analysed per step
+
+    explicit CaptureMonitor(AudioData* data) : data(data) {}
+    ~CaptureMonitor() { finish(0); }
+    CaptureMonitor(const CaptureMonitor&) = delete;
+    CaptureMonitor& operator=(const CaptureMonitor&) = delete;
+
+    // New take, captured at `sampleRate`: starts the thread
+    void start(double sampleRate, const SilenceSettings& settings);
+
+    // Analyse whatever is left up to frame `frames`, then stop the thread.
+    // The results below are only read once this returned.
+    void finish(long frames);
+
+    const SilenceDetector& silence() const { return detector; }
+
+    // Any thread. 1.0 renders nothing.
+    void setRenderRatio(double ratio) { renderRatio.store(ratio); }
+
+    // After finish(): the completed render, if there is one
+    std::unique_ptr<TakeRender> takeRender() { return std::move(render); }
+
+private:
+    void run();
+    void consume(long upTo);
+    void restartRender(double ratio);
+
+    AudioData* data;  // not owning
+    SilenceDetector detector{ SAMPLE_RATE };
+    long consumed = 0;
+    std::vector<SAMPLE> buffer;  // READ_FRAMES per channel
+    std::atomic<double> renderRatio{ 1.0 };
+    std::unique_ptr<TakeRender> render;
+    std::atomic<bool> stopping{ false };
+    std::thread thread;
+};
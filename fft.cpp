@@ -0,0 +1,135 @@
+#include "fft.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SC_HAVE_SSE2 1
+#endif
+
+std::shared_ptr<const FftPlan> FftPlan::forSize(int size)
+{
+    static std::mutex mutex;
+    static std::map<int, std::shared_ptr<const FftPlan>> plans;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& plan = plans[size];
+    if (!plan)
+        plan = std::make_shared<const FftPlan>(size);
+    return plan;
+}
+
+FftPlan::FftPlan(int size)
+    : n(size),
+    half(size / 2)
+{
+    const double twoPi = 6.283185307179586;
+
+    int bits = 0;
+    while ((1 << bits) < half)
+        bits++;
+    bitReverse.resize(half);
+    for (int i = 0; i < half; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        bitReverse[i] = r;
+    }
+
+    twRe.resize(std::max(half - 1, 0));
+    twIm.resize(std::max(half - 1, 0));
+    for (int len = 2; len <= half; len <<= 1) {
+        for (int k = 0; k < len / 2; k++) {
+            twRe[len / 2 - 1 + k] = (float)std::cos(twoPi * k / len);
+            twIm[len / 2 - 1 + k] = (float)-std::sin(twoPi * k / len);
+        }
+    }
+
+    splitRe.resize(half);
+    splitIm.resize(half);
+    for (int k = 0; k < half; k++) {
+        splitRe[k] = (float)std::cos(twoPi * k / n);
+        splitIm[k] = (float)-std::sin(twoPi * k / n);
+    }
+}
+
+void FftPlan::forward(const float* in, const float* window, float* re, float* im) const
+{
+    // Even samples as the real part, odd ones as the imaginary part, loaded
+    // straight into bit-reversed order
+    for (int k = 0; k < half; k++) {
+        const int j = bitReverse[k];
+        re[j] = window ? in[2 * k] * window[2 * k] : in[2 * k];
+        im[j] = window ? in[2 * k + 1] * window[2 * k + 1] : in[2 * k + 1];
+    }
+
+    for (int len = 2; len <= half; len <<= 1)
+    {
+        const int h = len / 2;
+        const float* wr = twRe.data() + h - 1;
+        const float* wi = twIm.data() + h - 1;
+        for (int base = 0; base < half; base += len)
+        {
+            float* ar = re + base;
+            float* ai = im + base;
+            float* br = ar + h;
+            float* bi = ai + h;
+            int k = 0;
+#ifdef SC_HAVE_SSE2
+            for (; k + 4 <= h; k += 4)
+            {
+                __m128 xr = _mm_loadu_ps(br + k), xi = _mm_loadu_ps(bi + k);
+                __m128 cr = _mm_loadu_ps(wr + k), ci = _mm_loadu_ps(wi + k);
+                __m128 tr = _mm_sub_ps(_mm_mul_ps(xr, cr), _mm_mul_ps(xi, ci));
+                __m128 ti = _mm_add_ps(_mm_mul_ps(xr, ci), _mm_mul_ps(xi, cr));
+                __m128 yr = _mm_loadu_ps(ar + k), yi = _mm_loadu_ps(ai + k);
+                _mm_storeu_ps(br + k, _mm_sub_ps(yr, tr));
+                _mm_storeu_ps(bi + k, _mm_sub_ps(yi, ti));
+                _mm_storeu_ps(ar + k, _mm_add_ps(yr, tr));
+                _mm_storeu_ps(ai + k, _mm_add_ps(yi, ti));
+            }
+#endif
+            for (; k < h; k++)
+            {
+                float tr = br[k] * wr[k] - bi[k] * wi[k];
+                float ti = br[k] * wi[k] + bi[k] * wr[k];
+                br[k] = ar[k] - tr;
+                bi[k] = ai[k] - ti;
+                ar[k] += tr;
+                ai[k] += ti;
+            }
+        }
+    }
+
+    // Split: X[k] = E + W^k O, with E = (Z[k] + Z*[half-k]) / 2 and
+    // O = -i (Z[k] - Z*[half-k]) / 2. Bins k and half - k use the same two
+    // values, so they are done in pairs, in place.
+    {
+        float r0 = re[0], i0 = im[0];
+        re[0] = r0 + i0;
+        im[0] = 0.0f;
+    }
+    for (int k = 1; k <= half / 2; k++)
+    {
+        const int m = half - k;
+        const float ar = re[k], ai = im[k];
+        const float br = re[m], bi = -im[m];   // conjugate of Z[half-k]
+
+        const float er = 0.5f * (ar + br), ei = 0.5f * (ai + bi);
+        const float odr = 0.5f * (ai - bi), odi = -0.5f * (ar - br);
+
+        const float xr = er + splitRe[k] * odr - splitIm[k] * odi;
+        const float xi = ei + splitRe[k] * odi + splitIm[k] * odr;
+
+        // X[half-k] = conj(E) + W^(half-k) conj(O)
+        const float yr = er + splitRe[m] * odr + splitIm[m] * odi;
+        const float yi = -ei - splitRe[m] * odi + splitIm[m] * odr;
+
+        re[k] = xr;
+        im[k] = xi;
+        re[m] = yr;
+        im[m] = yi;
+    }
+}
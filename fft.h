@@ -0,0 +1,33 @@
+#pragma once
+#include <memory>
+#include <vector>
+
+/**
+ * Radix-2 FFT of real input for one power-of-two size, done as a complex
+ * FFT of half the size and a split step. Twiddles and the bit-reversal
+ * table are made once per size: forSize() hands out a shared plan from a
+ * cache, so analysers that come and go do not rebuild them.
+ *
+ * The butterflies work on separate real and imaginary arrays, four at a
+ * time with SSE2 on x86; other builds use the plain loop. A plan is
+ * immutable, so threads may share one.
+ */
+class FftPlan {
+public:
+    static std::shared_ptr<const FftPlan> forSize(int size);
+
+    explicit FftPlan(int size);
+
+    int size() const { return n; }
+
+    // Bins 0 .. size/2 - 1 of `in` (size samples), each multiplied by
+    // window[i] first when a window is given. re and im hold size/2 each.
+    void forward(const float* in, const float* window, float* re, float* im) const;
+
+private:
+    int n;
+    int half;
+    std::vector<int> bitReverse;   // half entries
+    std::vector<float> twRe, twIm; // per stage, the stage of length L at L/2 - 1
+    std::vector<float> splitRe, splitIm;  // e^(-2 pi i k / n), k < half
+};
@@ -0,0 +1,295 @@
+#include "level_meter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SC_HAVE_SSE2 1
+#endif
+
+namespace {
+
+const int C = NUM_CHANNELS;
+const float FLUSH_LEVEL = 1e-9f;  // -180 dBFS, well under any meter floor
+
+// Level halfway between frames 1 and 2 of four (Catmull-Rom at t = 0.5)
+inline float midpoint(float a, float b, float c, float d)
+{
+    return 0.5625f * (b + c) - 0.0625f * (a + d);
+}
+
+// Peak (max |v|) and sum of squares per channel
+void measure(const SAMPLE* in, long frames, float* peak, float* sum)
+{
+    long i = 0;
+    const long n = frames * C;
+#ifdef SC_HAVE_SSE2
+    if (C == 2)
+    {
+        // Interleaved stereo: even lanes are left, odd lanes right
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        __m128 p0 = _mm_setzero_ps(), p1 = _mm_setzero_ps(), s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps();
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128 x = _mm_loadu_ps(in + i);
+            __m128 y = _mm_loadu_ps(in + i + 4);
+            p0 = _mm_max_ps(p0, _mm_and_ps(x, absMask));
+            p1 = _mm_max_ps(p1, _mm_and_ps(y, absMask));
+            s0 = _mm_add_ps(s0, _mm_mul_ps(x, x));
+            s1 = _mm_add_ps(s1, _mm_mul_ps(y, y));
+        }
+        float p[4], s[4];
+        _mm_storeu_ps(p, _mm_max_ps(p0, p1));
+        _mm_storeu_ps(s, _mm_add_ps(s0, s1));
+        for (int c = 0; c < 2; c++) {
+            peak[c] = std::max(p[c], p[c + 2]);
+            sum[c] = s[c] + s[c + 2];
+        }
+    }
+#endif
+    for (; i < n; i++)
+    {
+        const int c = (int)(i % C);
+        peak[c] = std::max(peak[c], std::fabs(in[i]));
+        sum[c] += in[i] * in[i];
+    }
+}
+
+// Largest |midpoint| per channel between frames k and k + 1, for k in
+// [first, last]; frames k - 1 .. k + 2 must exist in `in`
+void midpoints(const SAMPLE* in, long first, long last, float* out)
+{
+    long k = first;
+#ifdef SC_HAVE_SSE2
+    if (C == 2)
+    {
+        // Two stereo frames per vector, so a step makes midpoints k .. k + 3
+        // from frames k - 1 .. k + 4, and the next step starts from its last
+        // two vectors. The midpoints are kept 16 times too large, which
+        // saves a multiply each.
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        const __m128 nine = _mm_set1_ps(9.0f);
+        __m128 m0 = _mm_setzero_ps(), m1 = _mm_setzero_ps();
+        if (k + 3 <= last)
+        {
+            __m128 a = _mm_loadu_ps(in + (k - 1) * 2);
+            __m128 b = _mm_loadu_ps(in + k * 2);
+            for (; k + 3 <= last; k += 4)
+            {
+                __m128 c = _mm_loadu_ps(in + (k + 1) * 2);
+                __m128 d = _mm_loadu_ps(in + (k + 2) * 2);
+                __m128 e = _mm_loadu_ps(in + (k + 3) * 2);
+                __m128 f = _mm_loadu_ps(in + (k + 4) * 2);
+                __m128 x0 = _mm_sub_ps(_mm_mul_ps(nine, _mm_add_ps(b, c)), _mm_add_ps(a, d));
+                __m128 x1 = _mm_sub_ps(_mm_mul_ps(nine, _mm_add_ps(d, e)), _mm_add_ps(c, f));
+                m0 = _mm_max_ps(m0, _mm_and_ps(x0, absMask));
+                m1 = _mm_max_ps(m1, _mm_and_ps(x1, absMask));
+                a = e;
+                b = f;
+            }
+        }
+        float m[4];
+        _mm_storeu_ps(m, _mm_mul_ps(_mm_max_ps(m0, m1), _mm_set1_ps(0.0625f)));
+        out[0] = std::max(out[0], std::max(m[0], m[2]));
+        out[1] = std::max(out[1], std::max(m[1], m[3]));
+    }
+#endif
+    for (; k <= last; k++)
+    {
+        for (int c = 0; c < C; c++)
+        {
+            const SAMPLE* f = in + k * C + c;
+            out[c] = std::max(out[c], std::fabs(midpoint(f[-C], f[0], f[C], f[2 * C])));
+        }
+    }
+}
+
+// Peak (max |v|), sum of squares and largest |midpoint| per channel of one
+// block, for the midpoints that need no frames of other blocks: k in
+// [1, frames - 3]
+void scan(const SAMPLE* in, long frames, float* peak, float* sum, float* mid)
+{
+    long counted = 0;  // frames in peak and sum so far
+    long k = 1;        // next midpoint
+#ifdef SC_HAVE_SSE2
+    if (C == 2 && frames >= 3)
+    {
+        // Two stereo frames per vector, so the lanes are left, right, left,
+        // right, and a step makes midpoints k .. k + 3 from frames k - 1 ..
+        // k + 4. Those starting on an even frame (a, c, e) tile the block,
+        // so they also feed peak and sum: every frame is loaded once for
+        // both. Midpoints are 16 times too large, as in midpoints(); two
+        // accumulators each keep the max chains short.
+        const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+        const __m128 nine = _mm_set1_ps(9.0f);
+        __m128 a = _mm_loadu_ps(in);
+        __m128 b = _mm_loadu_ps(in + 2);
+        __m128 p0 = _mm_and_ps(a, absMask), p1 = _mm_setzero_ps();
+        __m128 s0 = _mm_mul_ps(a, a), s1 = _mm_setzero_ps();
+        __m128 m0 = _mm_setzero_ps(), m1 = _mm_setzero_ps();
+        for (; k + 3 <= frames - 3; k += 4)
+        {
+            __m128 c = _mm_loadu_ps(in + (k + 1) * 2);
+            __m128 d = _mm_loadu_ps(in + (k + 2) * 2);
+            __m128 e = _mm_loadu_ps(in + (k + 3) * 2);
+            __m128 f = _mm_loadu_ps(in + (k + 4) * 2);
+            __m128 x0 = _mm_sub_ps(_mm_mul_ps(nine, _mm_add_ps(b, c)), _mm_add_ps(a, d));
+            __m128 x1 = _mm_sub_ps(_mm_mul_ps(nine, _mm_add_ps(d, e)), _mm_add_ps(c, f));
+            m0 = _mm_max_ps(m0, _mm_and_ps(x0, absMask));
+            m1 = _mm_max_ps(m1, _mm_and_ps(x1, absMask));
+            p0 = _mm_max_ps(p0, _mm_and_ps(c, absMask));
+            p1 = _mm_max_ps(p1, _mm_and_ps(e, absMask));
+            s0 = _mm_add_ps(s0, _mm_mul_ps(c, c));
+            s1 = _mm_add_ps(s1, _mm_mul_ps(e, e));
+            a = e;
+            b = f;
+        }
+        counted = k + 1;
+
+        float p[4], s[4], m[4];
+        _mm_storeu_ps(p, _mm_max_ps(p0, p1));
+        _mm_storeu_ps(s, _mm_add_ps(s0, s1));
+        _mm_storeu_ps(m, _mm_mul_ps(_mm_max_ps(m0, m1), _mm_set1_ps(0.0625f)));
+        for (int c = 0; c < 2; c++) {
+            peak[c] = std::max(p[c], p[c + 2]);
+            sum[c] = s[c] + s[c + 2];
+            mid[c] = std::max(m[c], m[c + 2]);
+        }
+    }
+#endif
+    for (long i = counted * C; i < frames * C; i++)
+    {
+        const int c = (int)(i % C);
+        peak[c] = std::max(peak[c], std::fabs(in[i]));
+        sum[c] += in[i] * in[i];
+    }
+    midpoints(in, k, frames - 3, mid);
+}
+
+} // namespace
+
+LevelMeter::LevelMeter()
+    : seq(0)
+{
+    reset(SAMPLE_RATE);
+}
+
+void LevelMeter::reset(double sampleRate)
+{
+    rate = sampleRate;
+    ballisticsFrames = 0;
+    peakFall = 0.0f;
+    rmsCoef = 1.0f;
+    blocks = 0;
+    for (int c = 0; c < C; c++) {
+        peak[c] = meanSquare[c] = truePeak[c] = maxTruePeak[c] = 0.0f;
+        publishedPeak[c] = publishedRms[c] = publishedTruePeak[c] = publishedMaxTruePeak[c] = 0.0f;
+    }
+    std::fill(history, history + 3 * C, (SAMPLE)0);
+    interpolating = true;
+    publishedBlocks = 0;
+}
+
+void LevelMeter::process(const SAMPLE* in, unsigned long frames)
+{
+    const auto relaxed = std::memory_order_relaxed;
+    if (frames == 0)
+        return;
+
+    // Per-block factors, recomputed only when the block size changes
+    if (frames != ballisticsFrames) {
+        const double seconds = frames / rate;
+        peakFall = (float)std::pow(10.0, -PEAK_FALL_DB_PER_SECOND * seconds / 20.0);
+        rmsCoef = (float)(1.0 - std::exp(-seconds / RMS_SECONDS));
+        ballisticsFrames = frames;
+    }
+
+    float blockPeak[C] = {}, blockSum[C] = {}, blockTrue[C] = {};
+    if (in)
+    {
+        // Blocks that need their inter-sample peaks (below) tend to follow
+        // each other: then one pass over the frames makes all the levels,
+        // otherwise a cheaper one makes peak and RMS, and the midpoints
+        // get their own pass only if the guess was wrong
+        if (interpolating)
+            scan(in, (long)frames, blockPeak, blockSum, blockTrue);
+        else
+            measure(in, (long)frames, blockPeak, blockSum);
+
+        // The midpoints that need frames of the previous block (or the next
+        // one: the last two are done with the next block)
+        SAMPLE edge[6 * C];
+        const long head = std::min(frames, 3UL);
+        std::memcpy(edge, history, sizeof(history));
+        std::memcpy(edge + 3 * C, in, head * C * sizeof(SAMPLE));
+        midpoints(edge + 3 * C, -2, std::min(0L, (long)frames - 3), blockTrue);
+
+        // The rest are at most 1.25 times the largest frame of the block,
+        // so while that stays under the falling true peak they cannot move
+        // it, nor maxTruePeak, which is never below it: leave them out.
+        // This is exact, and on music skips most blocks after a loud one.
+        bool needed = false;
+        for (int c = 0; c < C; c++)
+            needed |= 1.25f * blockPeak[c] > truePeak[c] * peakFall;
+        if (needed && !interpolating)
+            midpoints(in, 1, (long)frames - 3, blockTrue);
+        interpolating = needed;
+
+        std::memcpy(history, frames >= 3 ? in + (frames - 3) * C : edge + head * C, sizeof(history));
+    }
+    else
+        std::fill(history, history + 3 * C, (SAMPLE)0);
+
+    for (int c = 0; c < C; c++)
+    {
+        const float blockTruePeak = std::max(blockTrue[c], blockPeak[c]);
+        peak[c] = std::max(blockPeak[c], peak[c] * peakFall);
+        truePeak[c] = std::max(blockTruePeak, truePeak[c] * peakFall);
+        maxTruePeak[c] = std::max(maxTruePeak[c], blockTruePeak);
+        meanSquare[c] += (blockSum[c] / frames - meanSquare[c]) * rmsCoef;
+
+        // Decaying into denormals would slow every block of silence down
+        if (peak[c] < FLUSH_LEVEL) peak[c] = 0.0f;
+        if (truePeak[c] < FLUSH_LEVEL) truePeak[c] = 0.0f;
+        if (meanSquare[c] < FLUSH_LEVEL * FLUSH_LEVEL) meanSquare[c] = 0.0f;
+    }
+    blocks++;
+
+    uint32_t s = seq.load(relaxed);
+    seq.store(s + 1, relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int c = 0; c < C; c++) {
+        publishedPeak[c].store(peak[c], relaxed);
+        publishedRms[c].store(std::sqrt(meanSquare[c]), relaxed);
+        publishedTruePeak[c].store(truePeak[c], relaxed);
+        publishedMaxTruePeak[c].store(maxTruePeak[c], relaxed);
+    }
+    publishedBlocks.store(blocks, relaxed);
+    seq.store(s + 2, std::memory_order_release);
+}
+
+LevelMeter::Snapshot LevelMeter::snapshot() const
+{
+    const auto relaxed = std::memory_order_relaxed;
+    Snapshot snap;
+    uint32_t before, after;
+    do {
+        before = seq.load(std::memory_order_acquire);
+        for (int c = 0; c < C; c++) {
+            snap.peak[c] = publishedPeak[c].load(relaxed);
+            snap.rms[c] = publishedRms[c].load(relaxed);
+            snap.truePeak[c] = publishedTruePeak[c].load(relaxed);
+            snap.maxTruePeak[c] = publishedMaxTruePeak[c].load(relaxed);
+        }
+        snap.blocks = publishedBlocks.load(relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = seq.load(relaxed);
+    } while ((before & 1) || before != after);
+    return snap;
+}
+
+float LevelMeter::toDb(float level)
+{
+    return level > 1e-6f ? 20.0f * std::log10(level) : -120.0f;
+}
@@ -0,0 +1,541 @@
+#include "lossless_codec.h"
+#include "sample_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+const size_t CODEC_BLOCK = 4096;
+const size_t RICE_PARTITION = 256;
+const int LPC_MAX_ORDER = 8;
+const int LPC_PRECISION = 13;   // bits per quantised coefficient, sign included
+const int FIXED_MAX_ORDER = 4;
+
+enum BlockType { Constant = 0, Verbatim = 1, Fixed = 2, Lpc = 3 };
+
+// Residuals whose zigzag value needs more bits than this make a predictor
+// unusable (it only happens for noise-like data, where verbatim wins anyway)
+const int MAX_RESIDUAL_BITS = 40;
+
+int unitBits(SampleStorage format)
+{
+    return format == SampleStorage::Float32 ? 32 : 16;
+}
+
+uint32_t unitAt(SampleStorage format, const void* samples, size_t i)
+{
+    if (format == SampleStorage::Float32) {
+        uint32_t u;
+        std::memcpy(&u, (const char*)samples + i * 4, 4);
+        return u;
+    }
+    return ((const uint16_t*)samples)[i];
+}
+
+void setUnit(SampleStorage format, void* samples, size_t i, uint32_t u)
+{
+    if (format == SampleStorage::Float32)
+        std::memcpy((char*)samples + i * 4, &u, 4);
+    else
+        ((uint16_t*)samples)[i] = (uint16_t)u;
+}
+
+inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+inline int64_t unzigzag(uint64_t u) { return (int64_t)(u >> 1) ^ -(int64_t)(u & 1); }
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out(out) {}
+
+    void put(uint64_t value, int bits)
+    {
+        while (bits > 0) {
+            int n = std::min(bits, 32);
+            bits -= n;
+            acc = (acc << n) | ((value >> bits) & ((1ull << n) - 1));
+            fill += n;
+            while (fill >= 8) {
+                fill -= 8;
+                out.push_back((uint8_t)(acc >> fill));
+            }
+        }
+    }
+
+    void putSigned(int64_t value, int bits) { put((uint64_t)value, bits); }
+
+    void putRice(uint64_t u, int k)
+    {
+        uint64_t q = u >> k;
+        for (; q >= 32; q -= 32) put(0, 32);
+        put(1, (int)q + 1);
+        put(u, k);
+    }
+
+    void flush()
+    {
+        if (fill > 0) put(0, 8 - fill);
+    }
+
+private:
+    std::vector<uint8_t>& out;
+    uint64_t acc = 0;
+    int fill = 0;
+};
+
+inline int leadingZeros(uint64_t v)  // v != 0
+{
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return 63 - (int)index;
+#else
+    return __builtin_clzll(v);
+#endif
+}
+
+// MSB-first reader over a 64-bit cache; reading past the end yields zeros
+// and clears ok()
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    bool ok() const { return consumed <= size * 8; }
+
+    uint64_t get(int bits)  // bits <= 32
+    {
+        if (bits == 0) return 0;
+        refill();
+        uint64_t v = cache >> (64 - bits);
+        consume(bits);
+        return v;
+    }
+
+    int64_t getSigned(int bits)
+    {
+        uint64_t v = get(bits);
+        if ((v >> (bits - 1)) & 1) v |= ~0ull << bits;
+        return (int64_t)v;
+    }
+
+    uint64_t getRice(int k)
+    {
+        uint64_t q = 0;
+        for (;;) {
+            refill();
+            if (cache != 0) break;
+            q += avail;
+            consume(avail);
+            if (!ok()) return 0;
+        }
+        int z = leadingZeros(cache);
+        q += z;
+        consume(z + 1);
+        return (q << k) | get(k);
+    }
+
+private:
+    void refill()
+    {
+        while (avail <= 56) {
+            uint64_t b = next < size ? data[next] : 0;
+            next++;
+            cache |= b << (56 - avail);
+            avail += 8;
+        }
+    }
+
+    void consume(int bits)
+    {
+        cache = bits < 64 ? cache << bits : 0;
+        avail -= bits;
+        consumed += bits;
+    }
+
+    const uint8_t* data;
+    size_t size;
+    size_t next = 0;
+    uint64_t cache = 0;
+    int avail = 0;
+    size_t consumed = 0;
+};
+
+// ------------------------------------------------------------
+// Samples <-> integers
+// ------------------------------------------------------------
+
+/* Map a block to integers x with sample = x * 2^-shift exactly, |x| < 2^31.
+** int16 is its own integer; float16 always uses shift 24 (its smallest
+** step); float32 picks the largest shift that keeps the peak below 2^30.
+** False if some sample is not such an integer (or is -0, Inf or NaN).
+*/
+bool toIntegers(SampleStorage format, const void* samples, size_t n, int64_t* x, int& shift)
+{
+    if (format == SampleStorage::Int16) {
+        shift = 0;
+        for (size_t i = 0; i < n; i++) x[i] = ((const int16_t*)samples)[i];
+        return true;
+    }
+
+    std::vector<float> v(n);
+    if (format == SampleStorage::Float16)
+        halfToFloat((const uint16_t*)samples, v.data(), n);
+    else
+        std::memcpy(v.data(), samples, n * sizeof(float));
+
+    float peak = 0.0f;
+    for (size_t i = 0; i < n; i++) {
+        if (!std::isfinite(v[i])) return false;
+        peak = std::max(peak, std::fabs(v[i]));
+    }
+    if (format == SampleStorage::Float16)
+        shift = 24;
+    else {
+        int e = 0;
+        std::frexp(peak, &e);  // peak < 2^e
+        shift = 30 - e;
+    }
+    if (shift < 0 || shift > 63) return false;
+
+    for (size_t i = 0; i < n; i++) {
+        double d = std::ldexp((double)v[i], shift);
+        if (d != std::nearbyint(d) || std::fabs(d) >= 2147483648.0) return false;
+        if (d == 0.0 && std::signbit(v[i])) return false;
+        x[i] = (int64_t)d;
+    }
+    if (format == SampleStorage::Float16) {
+        // every half in range maps exactly, but check rather than assume
+        for (size_t i = 0; i < n; i++) {
+            float back = (float)std::ldexp((double)x[i], -shift);
+            uint16_t h;
+            floatToHalf(&back, &h, 1);
+            if (h != ((const uint16_t*)samples)[i]) return false;
+        }
+    }
+    return true;
+}
+
+void fromIntegers(SampleStorage format, const int64_t* x, size_t n, int shift, void* samples)
+{
+    if (format == SampleStorage::Int16) {
+        for (size_t i = 0; i < n; i++) ((int16_t*)samples)[i] = (int16_t)x[i];
+        return;
+    }
+    std::vector<float> v(n);
+    for (size_t i = 0; i < n; i++) v[i] = (float)std::ldexp((double)x[i], -shift);
+    if (format == SampleStorage::Float16)
+        floatToHalf(v.data(), (uint16_t*)samples, n);
+    else
+        std::memcpy(samples, v.data(), n * sizeof(float));
+}
+
+// ------------------------------------------------------------
+// Predictors
+// ------------------------------------------------------------
+
+void fixedResidual(const int64_t* x, size_t n, int order, int64_t* r)
+{
+    for (size_t i = order; i < n; i++) {
+        switch (order) {
+        case 0: r[i] = x[i]; break;
+        case 1: r[i] = x[i] - x[i - 1]; break;
+        case 2: r[i] = x[i] - 2 * x[i - 1] + x[i - 2]; break;
+        case 3: r[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3]; break;
+        default: r[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4]; break;
+        }
+    }
+}
+
+void fixedRestore(int64_t* x, size_t n, int order)
+{
+    // x[order..] holds residuals on entry
+    for (size_t i = order; i < n; i++) {
+        switch (order) {
+        case 0: break;
+        case 1: x[i] += x[i - 1]; break;
+        case 2: x[i] += 2 * x[i - 1] - x[i - 2]; break;
+        case 3: x[i] += 3 * x[i - 1] - 3 * x[i - 2] + x[i - 3]; break;
+        default: x[i] += 4 * x[i - 1] - 6 * x[i - 2] + 4 * x[i - 3] - x[i - 4]; break;
+        }
+    }
+}
+
+inline int64_t lpcPredict(const int64_t* x, size_t i, const int32_t* q, int order, int qshift)
+{
+    int64_t sum = 0;
+    for (int j = 0; j < order; j++) sum += (int64_t)q[j] * x[i - 1 - j];
+    return sum >> qshift;
+}
+
+/* Welch-windowed autocorrelation, Levinson-Durbin, then quantise the
+** coefficients to LPC_PRECISION bits with error feedback. False if the
+** block gives no usable predictor.
+*/
+bool computeLpc(const int64_t* x, size_t n, int order, int32_t* q, int& qshift)
+{
+    if (n <= (size_t)order * 2) return false;
+
+    std::vector<double> w(n);
+    double half = (n - 1) / 2.0;
+    for (size_t i = 0; i < n; i++) {
+        double t = (i - half) / (half + 1.0);
+        w[i] = x[i] * (1.0 - t * t);
+    }
+
+    double ac[LPC_MAX_ORDER + 1];
+    for (int lag = 0; lag <= order; lag++) {
+        double s = 0.0;
+        for (size_t i = lag; i < n; i++) s += w[i] * w[i - lag];
+        ac[lag] = s;
+    }
+    if (ac[0] <= 0.0) return false;
+    ac[0] *= 1.0 + 1e-9;  // a whisper of white noise keeps the recursion stable
+
+    double a[LPC_MAX_ORDER] = {}, tmp[LPC_MAX_ORDER];
+    double err = ac[0];
+    for (int m = 0; m < order; m++) {
+        double k = ac[m + 1];
+        for (int j = 0; j < m; j++) k -= a[j] * ac[m - j];
+        k /= err;
+        for (int j = 0; j < m; j++) tmp[j] = a[j] - k * a[m - 1 - j];
+        for (int j = 0; j < m; j++) a[j] = tmp[j];
+        a[m] = k;
+        err *= 1.0 - k * k;
+        if (err <= 0.0) return false;
+    }
+
+    double cmax = 0.0;
+    for (int j = 0; j < order; j++) cmax = std::max(cmax, std::fabs(a[j]));
+    if (cmax == 0.0) return false;
+    int e = 0;
+    std::frexp(cmax, &e);  // cmax < 2^e
+    qshift = LPC_PRECISION - 1 - e;
+    if (qshift < 0) return false;
+    qshift = std::min(qshift, 31);
+
+    const int32_t qmax = (1 << (LPC_PRECISION - 1)) - 1;
+    double carry = 0.0;
+    for (int j = 0; j < order; j++) {
+        double v = a[j] * (double)(1 << qshift) + carry;
+        int32_t r = (int32_t)std::lround(v);
+        r = std::clamp(r, -qmax, qmax);
+        carry = v - r;
+        q[j] = r;
+    }
+    return true;
+}
+
+// ------------------------------------------------------------
+// Residual coding
+// ------------------------------------------------------------
+
+int bestRiceParameter(const uint64_t* u, size_t n, uint64_t& bits)
+{
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) sum += u[i];
+    int guess = 0;
+    if (n > 0) {
+        uint64_t mean = sum / n;
+        while (guess < 30 && (2ull << guess) <= mean) guess++;
+    }
+    int best = guess;
+    bits = ~0ull;
+    for (int k = std::max(0, guess - 1); k <= std::min(30, guess + 1); k++) {
+        uint64_t b = (uint64_t)n * (k + 1);
+        for (size_t i = 0; i < n; i++) b += u[i] >> k;
+        if (b < bits) { bits = b; best = k; }
+    }
+    return best;
+}
+
+// Bits of the Rice-coded residual r[start..n), or ~0 if it is unusable
+uint64_t residualBits(const int64_t* r, size_t start, size_t n, std::vector<uint64_t>& u, std::vector<int>& params)
+{
+    u.resize(n);
+    for (size_t i = start; i < n; i++) {
+        u[i] = zigzag(r[i]);
+        if (u[i] >> MAX_RESIDUAL_BITS) return ~0ull;
+    }
+    params.clear();
+    uint64_t total = 0;
+    for (size_t p = 0; p < n; p += RICE_PARTITION) {
+        size_t a = std::max(p, start), b = std::min(n, p + RICE_PARTITION);
+        uint64_t bits = 0;
+        int k = a < b ? bestRiceParameter(u.data() + a, b - a, bits) : 0;
+        params.push_back(k);
+        total += 5 + (a < b ? bits : 0);
+    }
+    return total;
+}
+
+void writeResidual(BitWriter& bw, const std::vector<uint64_t>& u, const std::vector<int>& params, size_t start, size_t n)
+{
+    for (size_t p = 0, idx = 0; p < n; p += RICE_PARTITION, idx++) {
+        int k = params[idx];
+        bw.put(k, 5);
+        for (size_t i = std::max(p, start); i < std::min(n, p + RICE_PARTITION); i++)
+            bw.putRice(u[i], k);
+    }
+}
+
+bool readResidual(BitReader& br, int64_t* r, size_t start, size_t n)
+{
+    for (size_t p = 0; p < n; p += RICE_PARTITION) {
+        int k = (int)br.get(5);
+        for (size_t i = std::max(p, start); i < std::min(n, p + RICE_PARTITION); i++)
+            r[i] = unzigzag(br.getRice(k));
+        if (!br.ok()) return false;
+    }
+    return true;
+}
+
+// ------------------------------------------------------------
+// Blocks
+// ------------------------------------------------------------
+
+void encodeBlock(BitWriter& bw, SampleStorage format, const void* samples, size_t n)
+{
+    const int bits = unitBits(format);
+
+    uint32_t first = unitAt(format, samples, 0);
+    bool constant = true;
+    for (size_t i = 1; i < n && constant; i++) constant = unitAt(format, samples, i) == first;
+    if (constant) {
+        bw.put(Constant, 2);
+        bw.put(first, bits);
+        return;
+    }
+
+    const uint64_t verbatimBits = (uint64_t)n * bits;
+    std::vector<int64_t> x(n), r(n);
+    int shift = 0;
+    if (toIntegers(format, samples, n, x.data(), shift))
+    {
+        // Drop trailing zero bits common to the whole block
+        uint64_t any = 0;
+        for (size_t i = 0; i < n; i++) any |= (uint64_t)x[i];
+        int wasted = 0;
+        while (wasted < 31 && !((any >> wasted) & 1)) wasted++;
+        for (size_t i = 0; i < n; i++) x[i] >>= wasted;
+
+        std::vector<uint64_t> u, bestU;
+        std::vector<int> params, bestParams;
+        uint64_t bestBits = ~0ull;
+        int bestType = Verbatim, bestOrder = 0, qshift = 0, bestQshift = 0;
+        int32_t q[LPC_MAX_ORDER], bestQ[LPC_MAX_ORDER];
+
+        for (int order = 0; order <= FIXED_MAX_ORDER && (size_t)order < n; order++) {
+            fixedResidual(x.data(), n, order, r.data());
+            uint64_t b = residualBits(r.data(), order, n, u, params);
+            if (b != ~0ull && b + 32ull * order < bestBits) {
+                bestBits = b + 32ull * order;
+                bestType = Fixed;
+                bestOrder = order;
+                bestU.swap(u);
+                bestParams.swap(params);
+            }
+        }
+
+        if (computeLpc(x.data(), n, LPC_MAX_ORDER, q, qshift)) {
+            for (size_t i = LPC_MAX_ORDER; i < n; i++)
+                r[i] = x[i] - lpcPredict(x.data(), i, q, LPC_MAX_ORDER, qshift);
+            uint64_t b = residualBits(r.data(), LPC_MAX_ORDER, n, u, params);
+            uint64_t header = 9 + (32ull + LPC_PRECISION) * LPC_MAX_ORDER;
+            if (b != ~0ull && b + header < bestBits) {
+                bestBits = b + header;
+                bestType = Lpc;
+                bestOrder = LPC_MAX_ORDER;
+                bestQshift = qshift;
+                std::copy(q, q + LPC_MAX_ORDER, bestQ);
+                bestU.swap(u);
+                bestParams.swap(params);
+            }
+        }
+
+        if (bestType != Verbatim && bestBits + 20 < verbatimBits) {
+            bw.put(bestType, 2);
+            bw.put(shift, 6);
+            bw.put(wasted, 5);
+            bw.put(bestOrder, 4);
+            if (bestType == Lpc) {
+                bw.put(bestQshift, 5);
+                for (int j = 0; j < bestOrder; j++) bw.putSigned(bestQ[j], LPC_PRECISION);
+            }
+            for (int j = 0; j < bestOrder; j++) bw.putSigned(x[j], 32);
+            writeResidual(bw, bestU, bestParams, bestOrder, n);
+            return;
+        }
+    }
+
+    bw.put(Verbatim, 2);
+    for (size_t i = 0; i < n; i++) bw.put(unitAt(format, samples, i), bits);
+}
+
+bool decodeBlock(BitReader& br, SampleStorage format, void* samples, size_t n)
+{
+    const int bits = unitBits(format);
+    int type = (int)br.get(2);
+
+    if (type == Constant) {
+        uint32_t v = (uint32_t)br.get(bits);
+        for (size_t i = 0; i < n; i++) setUnit(format, samples, i, v);
+        return br.ok();
+    }
+    if (type == Verbatim) {
+        for (size_t i = 0; i < n; i++) setUnit(format, samples, i, (uint32_t)br.get(bits));
+        return br.ok();
+    }
+
+    int shift = (int)br.get(6);
+    int wasted = (int)br.get(5);
+    int order = (int)br.get(4);
+    int qshift = 0;
+    int32_t q[15] = {};
+    if (type == Lpc) {
+        qshift = (int)br.get(5);
+        for (int j = 0; j < order; j++) q[j] = (int32_t)br.getSigned(LPC_PRECISION);
+    }
+    else if (order > FIXED_MAX_ORDER)
+        return false;
+    if (!br.ok() || (size_t)order > n) return false;
+
+    std::vector<int64_t> x(n);
+    for (int j = 0; j < order; j++) x[j] = br.getSigned(32);
+    if (!readResidual(br, x.data(), order, n)) return false;
+
+    if (type == Fixed)
+        fixedRestore(x.data(), n, order);
+    else {
+        for (size_t i = order; i < n; i++)
+            x[i] += lpcPredict(x.data(), i, q, order, qshift);
+    }
+
+    for (size_t i = 0; i < n; i++) x[i] = (int64_t)((uint64_t)x[i] << wasted);
+    fromIntegers(format, x.data(), n, shift, samples);
+    return true;
+}
+
+} // namespace
+
+void encodeChannel(SampleStorage format, const void* samples, size_t count, std::vector<uint8_t>& out)
+{
+    const size_t bytes = sampleStorageBytes(format);
+    BitWriter bw(out);
+    for (size_t at = 0; at < count; at += CODEC_BLOCK)
+        encodeBlock(bw, format, (const char*)samples + at * bytes, std::min(CODEC_BLOCK, count - at));
+    bw.flush();
+}
+
+bool decodeChannel(SampleStorage format, const uint8_t* data, size_t size, void* samples, size_t count)
+{
+    const size_t bytes = sampleStorageBytes(format);
+    BitReader br(data, size);
+    for (size_t at = 0; at < count; at += CODEC_BLOCK) {
+        if (!decodeBlock(br, format, (char*)samples + at * bytes, std::min(CODEC_BLOCK, count - at)))
+            return false;
+    }
+    return br.ok();
+}
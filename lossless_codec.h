@@ -0,0 +1,28 @@
+#pragma once
+#include "utils.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Lossless coding of one channel of samples in any SampleStorage format,
+** in the spirit of FLAC: the channel is cut into CODEC_BLOCK-sample blocks
+** and each block is stored as
+**   constant   one value (digital silence)
+**   fixed      polynomial predictor of order 0-4, Rice-coded residual
+**   lpc        quantised linear predictor of order up to LPC_MAX_ORDER,
+**              Rice-coded residual
+**   verbatim   the raw sample bits
+** whichever is smallest. Prediction runs on integers, so the round trip is
+** bit exact. Float blocks are only predicted when every sample is an exact
+** integer multiple of a power of two (true for audio that started out as
+** 16 or 24-bit PCM, and for anything int16 / float16); other float blocks
+** are stored verbatim.
+**
+** Not real-time safe (allocates); meant for a background thread.
+*/
+
+// Append the coded `count` samples of one channel to `out`
+void encodeChannel(SampleStorage format, const void* samples, size_t count, std::vector<uint8_t>& out);
+
+// Decode exactly `count` samples; false if the data is truncated or corrupt
+bool decodeChannel(SampleStorage format, const uint8_t* data, size_t size, void* samples, size_t count);
@@ -3,9 +3,32 @@
 #include "play_button.h"
 #include "utils.h"
 #include "wave_panel.h"
+#include "meter_panel.h"
 #include "my_events.h"
+#include "render_cache.h"
+#include "take_store.h"
+#include <fstream>
+
+namespace {
+    const int ID_DUMP_STATS = wxID_HIGHEST + 201;
+    const int ID_TRIM_SILENCE = wxID_HIGHEST + 202;
+    const int ID_SKIP_GAPS = wxID_HIGHEST + 203;
+    const int ID_ARM_RECORD = wxID_HIGHEST + 204;
+    const int ID_VIEW_WAVEFORM = wxID_HIGHEST + 205;
+    const int ID_VIEW_SPECTROGRAM = wxID_HIGHEST + 206;
+
+    wxString FormatStats(const char* label, const StreamStats::Snapshot& s)
+    {
+        return wxString::Format("%s: overflows %llu underflows %llu | cb avg %.0f p99 %.0f max %.0f us of %.0f | cpu %.0f%%",
+            label,
+            (unsigned long long)(s.inputOverflows + s.outputOverflows),
+            (unsigned long long)(s.inputUnderflows + s.outputUnderflows),
+            s.avgUs, s.p99Us, s.maxUs, s.budgetUs, s.cpuLoad * 100.0);
+    }
+}
 
-MainWindow::MainWindow(const wxString& title) : wxFrame(NULL, wxID_ANY, title, wxDefaultPosition, wxSize(500, 400))
+MainWindow::MainWindow(const wxString& title) : wxFrame(NULL, wxID_ANY, title, wxDefaultPosition, wxSize(500, 400)),
+    m_statsTimer(this)
 {
     // shared pointers
     pState = std::make_shared<State>();
@@ -20,6 +43,9 @@ MainWindow::MainWindow(const wxString& title) : wxFrame(NULL, wxID_ANY, title, w
 
     // Create the wave panel
     wavePanel = new WavePanel(panel, pData, pState);
+
+    // Input levels while recording, output levels while playing
+    meterPanel = new MeterPanel(panel, pData, pState);
     
     m_speedSlider = new wxSlider(
         panel,
@@ -41,6 +67,7 @@ MainWindow::MainWindow(const wxString& title) : wxFrame(NULL, wxID_ANY, title, w
     controlSizer->Add(recordButton, 0, wxALL, 5);
     controlSizer->Add(playButton, 0, wxALL, 5);
     controlSizer->Add(m_speedSlider, 0, wxALL | wxALIGN_CENTER_VERTICAL, 5);
+    controlSizer->Add(meterPanel, 1, wxALL | wxALIGN_CENTER_VERTICAL, 5);
 
 
     wxBoxSizer* mainSizer = new wxBoxSizer(wxVERTICAL);
@@ -58,6 +85,107 @@ MainWindow::MainWindow(const wxString& title) : wxFrame(NULL, wxID_ANY, title, w
         this);
 
     this->Bind(wxEVT_SLIDER, &MainWindow::OnSpeedSlider, this);
+
+    // Stream health and latency: status bar + JSON dump
+    wxMenu* toolsMenu = new wxMenu;
+    toolsMenu->Append(ID_DUMP_STATS, "Dump stream stats (JSON)...");
+    toolsMenu->AppendSeparator();
+    const SilenceSettings& silence = recordButton->getRecorder()->getSilenceSettings();
+    toolsMenu->AppendCheckItem(ID_TRIM_SILENCE, "Trim silence after recording")->Check(silence.trim);
+    toolsMenu->AppendCheckItem(ID_SKIP_GAPS, "Skip silent gaps while playing")->Check(silence.skipGaps);
+    toolsMenu->AppendCheckItem(ID_ARM_RECORD, "Record starts on signal (armed)");
+    wxMenu* viewMenu = new wxMenu;
+    viewMenu->AppendRadioItem(ID_VIEW_WAVEFORM, "Waveform");
+    viewMenu->AppendRadioItem(ID_VIEW_SPECTROGRAM, "Spectrogram");
+    wxMenuBar* menuBar = new wxMenuBar;
+    menuBar->Append(viewMenu, "&View");
+    menuBar->Append(toolsMenu, "&Tools");
+    SetMenuBar(menuBar);
+
+    CreateStatusBar(3);
+    this->Bind(wxEVT_MENU, &MainWindow::OnDumpStats, this, ID_DUMP_STATS);
+    this->Bind(wxEVT_MENU, &MainWindow::OnSilenceOption, this, ID_TRIM_SILENCE);
+    this->Bind(wxEVT_MENU, &MainWindow::OnSilenceOption, this, ID_SKIP_GAPS);
+    this->Bind(wxEVT_MENU, &MainWindow::OnArmRecord, this, ID_ARM_RECORD);
+    this->Bind(wxEVT_MENU, &MainWindow::OnViewMode, this, ID_VIEW_WAVEFORM);
+    this->Bind(wxEVT_MENU, &MainWindow::OnViewMode, this, ID_VIEW_SPECTROGRAM);
+    this->Bind(wxEVT_TIMER, &MainWindow::OnStatsTimer, this, m_statsTimer.GetId());
+    m_statsTimer.Start(250);
+}
+
+void MainWindow::OnStatsTimer(wxTimerEvent& WXUNUSED(event))
+{
+    // Pa_GetStreamCpuLoad is not callback-safe, so sample it here
+    if (AudioDevice* recDevice = recordButton->getRecorder()->getDevice())
+        pData->recordStats.setCpuLoad(recDevice->cpuLoad());
+    if (AudioDevice* playDevice = playButton->getDevice())
+        pData->playStats.setCpuLoad(playDevice->cpuLoad());
+
+    SetStatusText(FormatStats("Rec", pData->recordStats.snapshot()), 0);
+    SetStatusText(FormatStats("Play", pData->playStats.snapshot()), 1);
+
+    wxString latency = wxString::Format("Latency in %.1f ms, out %.1f ms (reported %.1f), round trip %.1f ms",
+        pData->recordClock.measuredLatency() * 1000.0,
+        pData->playClock.measuredLatency() * 1000.0,
+        pData->playClock.reportedLatency() * 1000.0,
+        pData->roundTripLatency() * 1000.0);
+    if (pData->take->compressing()) {
+        TakeStore::Usage take = pData->take->usage();
+        latency += wxString::Format(" | take %.0f MB + %.1f MB packed, %ld misses",
+            take.unpackedBytes / 1048576.0, take.packedBytes / 1048576.0, take.misses);
+    }
+    SetStatusText(latency, 2);
+}
+
+void MainWindow::OnDumpStats(wxCommandEvent& WXUNUSED(event))
+{
+    wxString path = wxFileSelector("Save stream stats", "", "stream_stats.json", "json",
+        "JSON files (*.json)|*.json", wxFD_SAVE | wxFD_OVERWRITE_PROMPT, this);
+    if (path.IsEmpty())
+        return;
+
+    std::ofstream out(path.ToStdString());
+    out << "{\n"
+        << "  \"record\": " << StreamStats::toJson(pData->recordStats.snapshot()) << ",\n"
+        << "  \"playback\": " << StreamStats::toJson(pData->playStats.snapshot()) << ",\n"
+        << "  \"latency_ms\": {\"input\": " << pData->recordClock.measuredLatency() * 1000.0
+        << ", \"output\": " << pData->playClock.measuredLatency() * 1000.0
+        << ", \"round_trip\": " << pData->roundTripLatency() * 1000.0 << "},\n";
+    TakeStore::Usage take = pData->take->usage();
+    out << "  \"take\": {\"unpacked_bytes\": " << take.unpackedBytes
+        << ", \"packed_bytes\": " << take.packedBytes
+        << ", \"packed_chunks\": " << take.packedChunks
+        << ", \"misses\": " << take.misses << "},\n";
+    RenderCache::Usage renders = pData->renderCache->usage();
+    out << "  \"render_cache\": {\"bytes\": " << renders.bytes
+        << ", \"renders\": " << renders.renders
+        << ", \"pending\": " << renders.pending << "}\n"
+        << "}\n";
+    if (!out)
+        wxMessageBox("Could not write " + path, "Error");
+}
+
+void MainWindow::OnSilenceOption(wxCommandEvent& event)
+{
+    AudioRecorder* recorder = recordButton->getRecorder();
+    SilenceSettings settings = recorder->getSilenceSettings();
+    if (event.GetId() == ID_TRIM_SILENCE)
+        settings.trim = event.IsChecked();
+    else
+        settings.skipGaps = event.IsChecked();
+    recorder->setSilenceSettings(settings);
+    wavePanel->Refresh(false);
+}
+
+void MainWindow::OnArmRecord(wxCommandEvent& event)
+{
+    AudioRecorder* recorder = recordButton->getRecorder();
+    recorder->setTrigger(recorder->getTriggerSettings(), event.IsChecked());
+}
+
+void MainWindow::OnViewMode(wxCommandEvent& event)
+{
+    wavePanel->SetViewMode(event.GetId() == ID_VIEW_SPECTROGRAM ? ViewMode::Spectrogram : ViewMode::Waveform);
 }
 
 // Called every time onTimer is called
@@ -69,7 +197,8 @@ void MainWindow::OnDrawScreen(wxCommandEvent& event)
 // Called when Record_Button posts the "stop" event
 void MainWindow::OnRecordStopped(wxCommandEvent& event)
 {
-    // Do nothing
+    // Idle from here on: render the new take at the likely speeds
+    pData->renderCache->prerender(pState->timeRatio);
 }
 
 void MainWindow::OnSpeedSlider(wxCommandEvent& WXUNUSED(event))
@@ -78,11 +207,19 @@ void MainWindow::OnSpeedSlider(wxCommandEvent& WXUNUSED(event))
 
     int value = m_speedSlider->GetValue();  // 500..2000
     double speed = static_cast<double>(value) / 1000.0;
-    double ratio = 1.0 / speed;  // inverse of speed
+    double ratio = ratioForSpeed(speed);  // inverse of speed
 
     pState->timeRatio = ratio;
     // or pState->SetTimeRatio(ratio);
 
+    // A take being recorded is re-rendered at the new ratio; while idle,
+    // the pre-renders move to the new speed; playback changes speed
+    recordButton->getRecorder()->setRenderRatio(ratio);
+    if (pState->state == Idle)
+        pData->renderCache->prerender(ratio);
+    else if (pState->state == Playing || pState->state == Paused)
+        pData->send({ EngineCommandType::SetRatio, -1, -1, ratio });  // from the next block
+
     // Optional: keep tooltip synced
     wxString tip;
     tip.Printf("Playback speed: %.2fx", speed);
@@ -1,10 +1,12 @@
 #pragma once
 #include <wx/wx.h>
+#include <wx/timer.h>
 #include "state.h"
 #include "play_button.h"
 #include "record_button.h"
 
 // forward declaration
+class MeterPanel;
 class WavePanel;
 
 class MainWindow : public wxFrame
@@ -14,6 +16,7 @@ public:
     Play_Button* playButton;
     Record_Button* recordButton;
     WavePanel* wavePanel;
+    MeterPanel* meterPanel;
     wxSlider* m_speedSlider = nullptr;
 
 private:
@@ -23,4 +26,16 @@ private:
     void OnRecordStopped(wxCommandEvent& event);
     void OnDrawScreen(wxCommandEvent& event);
     void OnSpeedSlider(wxCommandEvent& event);
+
+    // Stream health in the status bar, refreshed while a stream is open
+    wxTimer m_statsTimer;
+    void OnStatsTimer(wxTimerEvent& event);
+    void OnDumpStats(wxCommandEvent& event);
+
+    // Tools menu: silence trimming / gap skipping (see SilenceSettings)
+    void OnSilenceOption(wxCommandEvent& event);
+    // Tools menu: armed recording (see TriggerSettings)
+    void OnArmRecord(wxCommandEvent& event);
+    // View menu: waveform or spectrogram
+    void OnViewMode(wxCommandEvent& event);
 };
\ No newline at end of file
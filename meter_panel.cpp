@@ -0,0 +1,105 @@
+#include "meter_panel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    constexpr int ID_POLL_TIMER = wxID_HIGHEST + 102;
+    constexpr int POLL_MS = 33;
+    constexpr int TEXT_WIDTH = 70;   // right of the bars: true-peak readout
+
+    // Levels closer than this look the same on a bar
+    bool SameLevels(const LevelMeter::Snapshot& a, const LevelMeter::Snapshot& b)
+    {
+        for (int c = 0; c < NUM_CHANNELS; c++)
+            if (std::fabs(a.peak[c] - b.peak[c]) > 1e-4f || std::fabs(a.rms[c] - b.rms[c]) > 1e-4f
+                || a.maxTruePeak[c] != b.maxTruePeak[c])
+                return false;
+        return true;
+    }
+}
+
+wxBEGIN_EVENT_TABLE(MeterPanel, wxPanel)
+EVT_PAINT(MeterPanel::OnPaint)
+EVT_TIMER(ID_POLL_TIMER, MeterPanel::OnPollTimer)
+wxEND_EVENT_TABLE()
+
+MeterPanel::MeterPanel(wxWindow* parent, std::shared_ptr<AudioData> pData, std::shared_ptr<State> pState)
+    : wxPanel(parent, wxID_ANY, wxDefaultPosition, wxSize(220, 12 * NUM_CHANNELS + 8)),
+    m_pData(pData), pStateCpy(pState),
+    m_pollTimer(this, ID_POLL_TIMER)
+{
+    m_pollTimer.Start(POLL_MS);
+}
+
+// A snapshot is a handful of atomic loads, cheap enough to take on every
+// tick whatever the state; only a change of level costs a repaint.
+void MeterPanel::OnPollTimer(wxTimerEvent&)
+{
+    const LevelMeter* meter = nullptr;
+    if (pStateCpy->state == Recording)
+        meter = m_pData->recordLevels.get();
+    else if (pStateCpy->state == Playing || pStateCpy->state == Paused)
+        meter = m_pData->playLevels.get();
+
+    const LevelMeter::Snapshot levels = meter ? meter->snapshot() : LevelMeter::Snapshot();
+    if (m_active == (meter != nullptr) && SameLevels(levels, m_shown))
+        return;
+
+    m_active = meter != nullptr;
+    m_shown = levels;
+    Refresh(false);
+}
+
+int MeterPanel::BarX(float level, int width)
+{
+    const float db = std::max(LevelMeter::toDb(level), METER_FLOOR_DB);
+    return (int)std::lround((db - METER_FLOOR_DB) / -METER_FLOOR_DB * width);
+}
+
+void MeterPanel::OnPaint(wxPaintEvent&)
+{
+    wxPaintDC dc(this);
+
+    int width, height;
+    GetClientSize(&width, &height);
+    const int barWidth = std::max(0, width - TEXT_WIDTH);
+    const int rowHeight = height / NUM_CHANNELS;
+
+    dc.SetPen(*wxTRANSPARENT_PEN);
+    dc.SetBrush(wxBrush(GetBackgroundColour()));
+    dc.DrawRectangle(0, 0, width, height);
+
+    for (int c = 0; c < NUM_CHANNELS; c++)
+    {
+        const int y = c * rowHeight + 1;
+        const int h = std::max(1, rowHeight - 2);
+
+        dc.SetPen(*wxTRANSPARENT_PEN);
+        dc.SetBrush(wxBrush(wxColour(40, 40, 40)));
+        dc.DrawRectangle(0, y, barWidth, h);
+        if (!m_active)
+            continue;
+
+        // Green up to -6 dBFS, amber above: where the headroom runs out
+        const int rmsX = BarX(m_shown.rms[c], barWidth);
+        const int warnX = BarX(0.5f, barWidth);
+        dc.SetBrush(wxBrush(wxColour(60, 190, 80)));
+        dc.DrawRectangle(0, y, std::min(rmsX, warnX), h);
+        if (rmsX > warnX) {
+            dc.SetBrush(wxBrush(wxColour(230, 170, 40)));
+            dc.DrawRectangle(warnX, y, rmsX - warnX, h);
+        }
+
+        const int peakX = std::min(BarX(m_shown.peak[c], barWidth), barWidth - 1);
+        if (m_shown.peak[c] > 0.0f) {
+            dc.SetPen(wxPen(m_shown.peak[c] >= 1.0f ? *wxRED : *wxWHITE, 2));
+            dc.DrawLine(peakX, y, peakX, y + h);
+        }
+
+        // Over 0 dBTP clips somewhere after conversion, even if no sample does
+        const float tp = m_shown.maxTruePeak[c];
+        dc.SetTextForeground(tp > 1.0f ? *wxRED : GetForegroundColour());
+        dc.DrawText(tp > 0.0f ? wxString::Format("TP %+.1f", LevelMeter::toDb(tp)) : wxString("TP -inf"),
+            barWidth + 6, y + (h - dc.GetCharHeight()) / 2);
+    }
+}
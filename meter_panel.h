@@ -0,0 +1,40 @@
+#pragma once
+
+#include <wx/wx.h>
+#include <wx/timer.h>
+#include <memory>
+#include "level_meter.h"
+#include "state.h"
+#include "utils.h"
+
+/**
+ * Level meters for the stream that is open: the input while recording, the
+ * output while playing or paused. One bar per channel from METER_FLOOR_DB
+ * to 0 dBFS, filled to the RMS level with a tick at the peak, and the
+ * highest true peak of the stream as text, red above 0 dBTP.
+ *
+ * Polls the LevelMeter snapshot on a display-rate timer and repaints only
+ * when a level moved; the callbacks never see the UI.
+ */
+class MeterPanel : public wxPanel
+{
+public:
+    static constexpr float METER_FLOOR_DB = -60.0f;
+
+    MeterPanel(wxWindow* parent, std::shared_ptr<AudioData> pData, std::shared_ptr<State> pState);
+
+private:
+    std::shared_ptr<AudioData> m_pData;
+    std::shared_ptr<State>     pStateCpy;
+    wxTimer m_pollTimer;
+    LevelMeter::Snapshot m_shown;   // levels on screen
+    bool m_active = false;          // a stream is metered
+
+    void OnPollTimer(wxTimerEvent& event);
+    void OnPaint(wxPaintEvent& event);
+
+    // Bar position of a linear level, 0 .. width
+    static int BarX(float level, int width);
+
+    wxDECLARE_EVENT_TABLE();
+};
@@ -4,10 +4,11 @@
 #include "playback.h" // For playCallback
 #include "portaudio.h"
 #include "state.h"
-#include <rubberband/RubberBandStretcher.h>
+#include "audio_device.h"
 #include "main_window.h"
 #include "wave_panel.h"
 #include "my_events.h"
+#include "render_cache.h"
 #include <string>
 #include <filesystem>
 
@@ -21,7 +22,6 @@ Play_Button::Play_Button(
     : wxPanel(parent, wxID_ANY),
     pStateCpy(pState),
     pAudioData(pData),
-    stream(nullptr),
     m_timer(this) // Timer owned by this frame
 {
     // Create the actual wxButton
@@ -34,12 +34,20 @@ Play_Button::Play_Button(
 
     pauseBundle = wxBitmapBundle::FromSVGFile((std::string)ICONS_DIR + "/pause.svg", wxSize(24, 24));
 
+    stopButton = new wxButton(this, wxID_ANY, wxT(""));
+    stopBundle = wxBitmapBundle::FromSVGFile((std::string)ICONS_DIR + "/stop.svg", wxSize(24, 24));
+    if (stopBundle.IsOk()) stopButton->SetBitmap(stopBundle);
+    stopButton->SetToolTip("Stop");
+    stopButton->Enable(false);
+
     auto* s = new wxBoxSizer(wxHORIZONTAL);
     s->Add(button, 0, 0, 0);
+    s->Add(stopButton, 0, wxLEFT, 5);
     SetSizerAndFit(s);
 
     // When button is clicked, call OnPlay(...)
     button->Bind(wxEVT_BUTTON, &Play_Button::OnPlay, this);
+    stopButton->Bind(wxEVT_BUTTON, &Play_Button::OnStop, this);
     this->Bind(myEVT_RECORD_STARTED, &Play_Button::OnRecord, this);
 
     // The timer calls OnTimer(...) when it goes off
@@ -64,93 +72,6 @@ void Play_Button::OnPlay(wxCommandEvent& WXUNUSED(event))
         return;
     }
 
-    // OFFLINE APPROACH:
-    {
-        // 1) Create a RubberBandStretcher in offline mode
-        RubberBand::RubberBandStretcher stretcher(
-            SAMPLE_RATE,
-            NUM_CHANNELS,
-            RubberBand::RubberBandStretcher::OptionProcessOffline  // Offline
-        );
-
-        double ratio = 1.0;
-        if (pStateCpy) {
-            ratio = pStateCpy->timeRatio;
-        }
-
-        // Clamp to a sensible range just in case
-        if (ratio < 0.5) ratio = 0.5;
-        if (ratio > 2.0) ratio = 2.0;
-
-        stretcher.setTimeRatio(ratio);
-
-        // 3) Prepare to pass entire recorded buffer as a single chunk
-        //    i.e., one "study" pass, then one "process" pass, then retrieve.
-        int frames = pAudioData->totalSamplesRecorded; // how many frames we actually recorded
-        int channels = NUM_CHANNELS;
-
-        // Interleaved input => must "de-interleave" for Rubber Band's offline calls
-        // i.e. float *const *input
-        // We'll make a vector of vectors: inputPlanar[c][frame]
-        std::vector<std::vector<float>> inputPlanar(channels, std::vector<float>(frames));
-        for (int f = 0; f < frames; f++) {
-            for (int c = 0; c < channels; c++) {
-                // interleaved index = f*channels + c
-                inputPlanar[c][f] = pAudioData->recorded[f * channels + c];
-            }
-        }
-
-        // RubberBand wants an array of pointers to each channel
-        std::vector<const float*> inputPtrs(channels);
-        for (int c = 0; c < channels; c++) {
-            inputPtrs[c] = inputPlanar[c].data();
-        }
-
-        // 4) "study" pass: tell it about the entire audio
-        //    final=true => we have no more data
-        stretcher.study(inputPtrs.data(), frames, true);
-
-        // 5) "process" pass: pass the same data again
-        stretcher.process(inputPtrs.data(), frames, true);
-
-        // 6) Retrieve all the stretched frames
-        int available = stretcher.available(); // how many frames are stretched out
-        std::vector<std::vector<float>> outputPlanar(channels, std::vector<float>(available));
-        // gather pointers to each channel
-        std::vector<float*> outPtrs(channels);
-        for (int c = 0; c < channels; c++) {
-            outPtrs[c] = outputPlanar[c].data();
-        }
-
-        // read them
-        pAudioData->totalSamplesRecorded = stretcher.retrieve((float* const*)outPtrs.data(), available);
-
-        // 7) Re-interleave them back into pAudioData->recorded
-        //    so the existing callback can just play them
-        //    We'll free the old pointer and allocate a new sized buffer
-        free(pAudioData->recorded);
-        pAudioData->recorded = (SAMPLE*)malloc(pAudioData->totalSamplesRecorded * channels * sizeof(SAMPLE));
-        if (!pAudioData->recorded) {
-            wxMessageBox("Allocation failed for stretched buffer!", "Error");
-            return;
-        }
-
-        // re-interleave
-        for (int f = 0; f < pAudioData->totalSamplesRecorded; f++) {
-            for (int c = 0; c < channels; c++) {
-                pAudioData->recorded[f * channels + c] = outputPlanar[c][f];
-            }
-        }
-
-        // update currentSampleIndex / maxFrameIndex
-        pAudioData->currentSampleIndex = 0;         // will start from beginning
-    }
-
-    // At this point, pAudioData->recorded holds the new time-stretched data
-    // pAudioData->maxFrameIndex is updated to the new length
-
-    // Proceed with your existing playback code (Case 1)...
-
     if (pStateCpy->state == Idle)
     {
         // Switch to "Playing" state and label
@@ -172,52 +93,36 @@ void Play_Button::OnPlay(wxCommandEvent& WXUNUSED(event))
 
         button->SetBitmap(pauseBundle);
         button->SetToolTip("Pause");
+        stopButton->Enable(true);
 
-        // Reset to start of newly stretched data
-        pAudioData->currentSampleIndex = 0;
-
-        err = Pa_Initialize();
-        if (err != paNoError) {
-            std::cerr << "Pa_Initialize error: " << Pa_GetErrorText(err) << std::endl;
-            return;
+        double ratio = 1.0;
+        if (pStateCpy) {
+            ratio = pStateCpy->timeRatio;
         }
 
-        PaStreamParameters outputParams;
-        std::memset(&outputParams, 0, sizeof(outputParams));
+        // Clamp to a sensible range just in case
+        if (ratio < 0.5) ratio = 0.5;
+        if (ratio > 2.0) ratio = 2.0;
 
-        outputParams.device = Pa_GetDefaultOutputDevice();
-        if (outputParams.device == paNoDevice) {
-            std::cerr << "Error: No default output device.\n";
+        device = createAudioDevice(defaultDeviceSpec(AudioDevice::Playback));
+        if (!device) {
+            err = paInvalidDevice;
             goto error;
         }
-        outputParams.channelCount = NUM_CHANNELS;
-        outputParams.sampleFormat = PA_SAMPLE_TYPE;
-        outputParams.suggestedLatency =
-            Pa_GetDeviceInfo(outputParams.device)->defaultLowOutputLatency;
-        outputParams.hostApiSpecificStreamInfo = NULL;
-
-        err = Pa_OpenStream(
-            &stream,
-            NULL,
-            &outputParams,
-            SAMPLE_RATE,
-            FRAMES_PER_BUFFER,
-            paClipOff,
-            playCallback,
-            pAudioData.get()
-        );
-        if (err != paNoError) goto error;
 
-        err = Pa_StartStream(stream);
+        // The take is stretched block by block inside playCallback, so there
+        // is nothing to render up front. A cursor placed in WavePanel is a
+        // pending seek and gets applied by the first callback.
+        err = startPlayback(*device, pAudioData.get(), ratio);
         if (err != paNoError) goto error;
 
-        m_timer.Start(200);
+        m_timer.Start(50);
         return;
 
     error:
-        std::cerr << "Pa_OpenStream/Pa_StartStream error: "
+        std::cerr << "Playback start error: "
             << Pa_GetErrorText(err) << std::endl;
-        Pa_Terminate();
+        device.reset();
         // Notify WavePanel that playback stopped
         {
             wxWindow* top = wxGetTopLevelParent(this);
@@ -236,59 +141,97 @@ void Play_Button::OnPlay(wxCommandEvent& WXUNUSED(event))
         pStateCpy->transition(Idle);
         button->SetBitmap(playBundle);
         button->SetToolTip("Play");
+        stopButton->Enable(false);
+        pAudioData->renderCache->prerender(pStateCpy->timeRatio);  // idle again
     }
     else if (pStateCpy->state == Playing)
     {
-        // existing stop logic...
-        pStateCpy->transition(Idle);
-        button->SetBitmap(playBundle);
-        button->SetToolTip("Play");
-        // Notify WavePanel that playback stopped
+        // Pause: the callback fades out and then plays silence, the stream
+        // stays open and the position and stretcher are kept. The icon
+        // follows once the callback reports it (OnTimer).
+        pAudioData->send({ EngineCommandType::Pause });
+        pStateCpy->transition(Paused);
+    }
+    else if (pStateCpy->state == Paused)
+    {
+        // Resume: picked up by the next callback
+        pAudioData->send({ EngineCommandType::Play });
+        pStateCpy->transition(Playing);
+    }
+}
+
+void Play_Button::OnStop(wxCommandEvent& WXUNUSED(event))
+{
+    if (pStateCpy->state == Playing || pStateCpy->state == Paused)
+        stopPlayback();
+}
+
+void Play_Button::stopPlayback()
+{
+    PaError err;
+
+    pStateCpy->transition(Idle);
+    button->SetBitmap(playBundle);
+    button->SetToolTip("Play");
+    stopButton->Enable(false);
+    // Notify WavePanel that playback stopped
+    {
+        wxWindow* top = wxGetTopLevelParent(this);
+        if (top)
         {
-            wxWindow* top = wxGetTopLevelParent(this);
-            if (top)
+            if (auto mw = dynamic_cast<MainWindow*>(top))
             {
-                if (auto mw = dynamic_cast<MainWindow*>(top))
+                if (mw->wavePanel)
                 {
-                    if (mw->wavePanel)
-                    {
-                        wxCommandEvent evStop(myEVT_PLAY_STOPPED);
-                        wxPostEvent(mw->wavePanel, evStop);
-                    }
+                    wxCommandEvent evStop(myEVT_PLAY_STOPPED);
+                    wxPostEvent(mw->wavePanel, evStop);
                 }
             }
         }
-        m_timer.Stop();
-        if (stream) {
-            err = Pa_CloseStream(stream);
-            if (err != paNoError) {
-                std::cerr << "Pa_CloseStream error: "
-                    << Pa_GetErrorText(err) << std::endl;
-            }
-            Pa_Terminate();
-            stream = nullptr;
+    }
+    m_timer.Stop();
+    if (device) {
+        err = closePlayback(*device, pAudioData.get());
+        if (err != paNoError) {
+            std::cerr << "Playback close error: "
+                << Pa_GetErrorText(err) << std::endl;
         }
+        device.reset();
     }
+    pAudioData->renderCache->prerender(pStateCpy->timeRatio);  // idle again
 }
 
 // Called periodically to see if playback finished
 void Play_Button::OnTimer(wxTimerEvent& WXUNUSED(event))
 {
-    if (!stream) return; // safety check
+    if (!device) return; // safety check
+
+    // What the callback has done with our commands
+    EngineEvent ev;
+    while (pAudioData->events.pop(ev))
+    {
+        if (ev.type == EngineEventType::Paused) {
+            button->SetBitmap(playBundle);
+            button->SetToolTip("Resume");
+        }
+        else if (ev.type == EngineEventType::Resumed) {
+            button->SetBitmap(pauseBundle);
+            button->SetToolTip("Pause");
+        }
+    }
 
-    int active = Pa_IsStreamActive(stream);
+    int active = device->isActive();
     if (active == 0)
     {
         // Playback is done
         m_timer.Stop();
 
-        PaError err = Pa_CloseStream(stream);
+        PaError err = closePlayback(*device, pAudioData.get());
         if (err != paNoError) {
-            std::cerr << "Pa_CloseStream error: "
+            std::cerr << "Playback close error: "
                 << Pa_GetErrorText(err) << std::endl;
         }
-        Pa_Terminate();
-        stream = nullptr;
+        device.reset();
 
         // Notify WavePanel that playback stopped
         {
@@ -309,6 +252,8 @@ void Play_Button::OnTimer(wxTimerEvent& WXUNUSED(event))
         pStateCpy->transition(Idle);
         button->SetBitmap(playBundle);
         button->SetToolTip("Play");
+        stopButton->Enable(false);
+        pAudioData->renderCache->prerender(pStateCpy->timeRatio);  // idle again
     }
     else if (active < 0)
     {
@@ -317,9 +262,8 @@ void Play_Button::OnTimer(wxTimerEvent& WXUNUSED(event))
             << Pa_GetErrorText(active) << std::endl;
 
         m_timer.Stop();
-        PaError err = Pa_CloseStream(stream);
-        stream = nullptr;
-        Pa_Terminate();
+        closePlayback(*device, pAudioData.get());
+        device.reset();
 
         // Notify WavePanel that playback stopped
         {
@@ -340,5 +284,7 @@ void Play_Button::OnTimer(wxTimerEvent& WXUNUSED(event))
         pStateCpy->transition(Idle);
         button->SetBitmap(playBundle);
         button->SetToolTip("Play");
+        stopButton->Enable(false);
+        pAudioData->renderCache->prerender(pStateCpy->timeRatio);  // idle again
     }
 }
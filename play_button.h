@@ -4,9 +4,11 @@
 #include <wx/timer.h>
 #include "state.h"
 #include "utils.h"
+#include "audio_device.h"
 
 /**
- * Minimal "Play" button that can also stop playback if pressed again.
+ * "Play" button that pauses playback if pressed again and resumes it on
+ * the next press, plus a "Stop" button that ends playback.
  */
 class Play_Button : public wxPanel
 {
@@ -18,21 +20,29 @@ public:
 
     // Event handler for the button press
     void OnPlay(wxCommandEvent& event);
+    void OnStop(wxCommandEvent& event);
     void OnRecord(wxCommandEvent& event);
 
     wxButton* button;
+    wxButton* stopButton;
+
+    AudioDevice* getDevice() const { return device.get(); }
 
 private:
     // We'll store references to the shared State and AudioData,
-    // plus a PortAudio stream pointer and a timer for polling.
+    // plus the playback device and a timer for polling.
     std::shared_ptr<State> pStateCpy;
     std::shared_ptr<AudioData> pAudioData;
 
-    PaStream* stream = nullptr;
+    std::unique_ptr<AudioDevice> device;
     wxTimer m_timer;
 
     wxBitmapBundle playBundle;
     wxBitmapBundle pauseBundle;
+    wxBitmapBundle stopBundle;
+
+    // Close the stream and go back to Idle (Stop while playing or paused)
+    void stopPlayback();
 
     // We'll periodically check if playback is finished via this timer
     void OnTimer(wxTimerEvent& event);
@@ -1,4 +1,197 @@
 #include "playback.h"
+#include "audio_device.h"
+#include "level_meter.h"
+#include "sample_kernels.h"
+#include "render_cache.h"
+#include "stretch.h"
+#include "take_render.h"
+#include "take_store.h"
+#include <algorithm>
+
+// First gap that ends after `frame`, nullptr if none
+static const SilentRegion* gapAfter(const std::vector<SilentRegion>& gaps, long frame)
+{
+    auto it = std::upper_bound(gaps.begin(), gaps.end(), frame,
+        [](long f, const SilentRegion& gap) { return f < gap.end; });
+    return it != gaps.end() ? &*it : nullptr;
+}
+
+/* Copy recorded frames starting at currentSampleIndex into the channel
+** arrays out[c] and advance it. Serves both as the direct playback path
+** (via playScratch) and as the stretcher's source.
+**
+** While a loop region is set and the read position is before its end, the
+** position wraps from loopEnd back to loopStart on the exact frame. The last
+** frames before loopEnd are crossfaded with the frames just before loopStart,
+** so the wrap is continuous. Because the stretcher only ever sees this
+** spliced stream, it keeps running across loop iterations without a reset.
+**
+** Outside a loop, with AudioData::skipSilentGaps set, the read position
+** jumps over the silent gaps the capture monitor found.
+*/
+static unsigned long pullRecorded(void* ctx, SAMPLE* const* out, unsigned long frames)
+{
+    AudioData* data = (AudioData*)ctx;
+    long pos = data->currentSampleIndex;
+    long loopA = data->loopStart.load();
+    long loopB = std::min<long>(data->loopEnd.load(), data->totalSamplesRecorded);
+    bool looping = loopA >= 0 && loopB > loopA && pos < loopB;
+    long xfade = looping ? std::min<long>({ LOOP_CROSSFADE_FRAMES, std::max(0L, loopA - data->takeStart), (loopB - loopA) / 2 }) : 0;
+    const std::vector<SilentRegion>& gaps = data->silentGaps;
+    bool skipping = !looping && !gaps.empty() && data->skipSilentGaps.load();
+    unsigned long n = 0;
+
+    while (n < frames)
+    {
+        long end = looping ? loopB : data->totalSamplesRecorded;
+        if (skipping)
+        {
+            const SilentRegion* gap = gapAfter(gaps, pos);
+            if (gap && gap->start <= pos) {
+                pos = gap->end;
+                continue;
+            }
+            if (gap) end = std::min(end, gap->start);
+        }
+        if (pos >= end)
+        {
+            if (!looping) break;
+            pos = loopA;
+            continue;
+        }
+
+        unsigned long chunk = std::min<unsigned long>(frames - n, end - pos);
+
+        for (int c = 0; c < NUM_CHANNELS; c++)
+            data->loadFrames(c, pos, chunk, out[c] + n);
+
+        /* Blend in the lead-in to loopStart over the last xfade frames */
+        long fadeStart = loopB - xfade;
+        if (xfade > 0 && pos + (long)chunk > fadeStart)
+        {
+            long from = std::max(pos, fadeStart);
+            SAMPLE leadIn[LOOP_CROSSFADE_FRAMES];
+            for (int c = 0; c < NUM_CHANNELS; c++)
+            {
+                SAMPLE* fptr = out[c] + n + (from - pos);
+                const SAMPLE* lead = leadIn;
+                data->loadFrames(c, loopA - xfade + (from - fadeStart), pos + (long)chunk - from, leadIn);
+                for (long p = from; p < pos + (long)chunk; p++)
+                {
+                    float g = ((p - fadeStart) + 0.5f) / (float)xfade;
+                    *fptr = *fptr * (1.0f - g) + *lead++ * g;
+                    fptr++;
+                }
+            }
+        }
+
+        pos += chunk;
+        n += chunk;
+    }
+
+    data->currentSampleIndex = (int)pos;
+    return n;
+}
+
+/* Direct (unstretched) path: pull through the planar scratch and
+** interleave into the device buffer.
+*/
+static unsigned long copyRecorded(AudioData* data, SAMPLE* out, unsigned long frames)
+{
+    unsigned long written = 0;
+    while (written < frames)
+    {
+        unsigned long want = std::min<unsigned long>(frames - written, PLAY_SCRATCH_FRAMES);
+        unsigned long got = pullRecorded(data, data->playScratch, want);
+        interleave(data->playScratch, 0, out + written * NUM_CHANNELS, got, NUM_CHANNELS);
+        written += got;
+        if (got < want) break;
+    }
+    return written;
+}
+
+/* Prerendered path: copy frames of the take stretched while recording,
+** up to where the (possibly trimmed) take ends.
+*/
+static unsigned long copyRendered(AudioData* data, SAMPLE* out, unsigned long frames)
+{
+    const TakeRender& render = *data->render;
+    long end = std::min(render.frames(), render.frameOf(data->totalSamplesRecorded));
+    unsigned long n = (unsigned long)std::clamp<long>(end - data->renderPos, 0, (long)frames);
+    std::copy_n(render.samples() + data->renderPos * NUM_CHANNELS, n * NUM_CHANNELS, out);
+    data->renderPos += n;
+
+    // keep the take warm here in case playback goes back to the live path
+    data->take->hint((long)data->playSourcePos);
+    return n;
+}
+
+/* Move the play position to `frame` at a block boundary. The stretcher is
+** reset and primed from there rather than re-rendering the take.
+*/
+static void seekTo(AudioData* data, long frame)
+{
+    data->currentSampleIndex = (int)std::clamp<long>(frame, data->takeStart, data->totalSamplesRecorded);
+    data->playSourcePos = data->currentSampleIndex;
+    if (data->stretcher) data->stretcher->reset(data->stretcher->ratio());
+    if (data->render) data->renderPos = data->render->frameOf(data->playSourcePos);
+}
+
+/* One command from the UI, applied at the start of a block. The event
+** that reports it goes back on data->events (dropped if the UI lags that
+** far behind).
+*/
+static void applyCommand(AudioData* data, const EngineCommand& command)
+{
+    EngineEventType done = EngineEventType::Resumed;
+    switch (command.type)
+    {
+    case EngineCommandType::Play:
+        data->playPaused = false;
+        done = EngineEventType::Resumed;
+        break;
+    case EngineCommandType::Pause:
+        data->playPaused = true;
+        done = EngineEventType::Paused;
+        break;
+    case EngineCommandType::Seek:
+        seekTo(data, command.a);
+        done = EngineEventType::Seeked;
+        break;
+    case EngineCommandType::SetRatio:
+        // New speed from where the output is, like a seek; ratio 1 plays
+        // the take directly, a matching render takes over on its own
+        if (data->stretcher && command.ratio > 0.0 && command.ratio != data->stretcher->ratio())
+        {
+            data->currentSampleIndex = (int)data->playSourcePos;
+            data->stretcher->reset(command.ratio);
+            data->playFromRender = false;
+        }
+        done = EngineEventType::RatioChanged;
+        break;
+    case EngineCommandType::SetLoop:
+        data->loopStart.store(-1);
+        data->loopEnd.store(command.b);
+        data->loopStart.store(command.a);
+        done = EngineEventType::LoopChanged;
+        break;
+    }
+    data->events.push({ done, data->playSourcePos });
+}
+
+/* Linear gain ramp over one block, down to silence or up from it, so that
+** pausing and resuming do not click.
+*/
+static void fadeBlock(SAMPLE* out, unsigned long frames, bool down)
+{
+    for (unsigned long f = 0; f < frames; f++)
+    {
+        float g = (f + 0.5f) / (float)frames;
+        if (down) g = 1.0f - g;
+        for (int c = 0; c < NUM_CHANNELS; c++)
+            out[f * NUM_CHANNELS + c] = (SAMPLE)(out[f * NUM_CHANNELS + c] * g);
+    }
+}
 
 int playCallback(const void* inputBuffer, void* outputBuffer,
     unsigned long framesPerBuffer,
@@ -6,43 +199,163 @@ int playCallback(const void* inputBuffer, void* outputBuffer,
     PaStreamCallbackFlags statusFlags,
     void* userData)
 {
+    StreamStats::Clock::time_point callbackStart = StreamStats::Clock::now();
     AudioData* data = (AudioData*)userData;
-    SAMPLE* rptr = &data->recorded[data->currentSampleIndex * NUM_CHANNELS];
     SAMPLE* wptr = (SAMPLE*)outputBuffer;
-    unsigned int i;
+    unsigned long framesWritten;
+    unsigned long i;
     int finished;
-    unsigned int framesLeft = data->totalSamplesRecorded - data->currentSampleIndex;
 
     (void)inputBuffer; /* Prevent unused variable warnings. */
-    (void)timeInfo;
-    (void)statusFlags;
-    (void)userData;
 
-    if (framesLeft < framesPerBuffer)
+    /* A start position picked while idle, then the UI's commands, all at
+    ** the block boundary and in the order they were sent
+    */
+    long seek = data->seekRequest.exchange(-1);
+    if (seek >= 0)
+        seekTo(data, seek);
+    EngineCommand command;
+    while (data->commands.pop(command))
+        applyCommand(data, command);
+
+    /* Paused and faded out: keep the stream running on silence. Nothing
+    ** advances, so resuming continues with the stretcher as it was.
+    */
+    bool paused = data->playPaused;
+    if (paused && data->playSilent)
     {
-        /* final buffer... */
-        for (i = 0; i < framesLeft; i++)
-        {
-            *wptr++ = *rptr++;  /* left */
-            if (NUM_CHANNELS == 2) *wptr++ = *rptr++;  /* right */
+        std::fill_n(wptr, framesPerBuffer * NUM_CHANNELS, (SAMPLE)SAMPLE_SILENCE);
+        data->playClock.publish(data->playSourcePos, 0.0, timeInfo, true);
+        data->playLevels->process(nullptr, framesPerBuffer);
+        data->playStats.record(statusFlags, framesPerBuffer, StreamStats::Clock::now() - callbackStart);
+        return paContinue;
+    }
+
+    /* Play the render made during recording when it matches what the live
+    ** path would produce. Switching paths continues from the output
+    ** position, like a seek.
+    */
+    bool fromRender = data->render && data->stretcher && data->render->ratio() == data->stretcher->ratio()
+        && !data->hasLoop() && !data->skipSilentGaps.load();
+    if (fromRender != data->playFromRender)
+    {
+        if (fromRender)
+            data->renderPos = data->render->frameOf(data->playSourcePos);
+        else {
+            data->currentSampleIndex = (int)data->playSourcePos;
+            data->stretcher->reset(data->stretcher->ratio());
         }
-        for (; i < framesPerBuffer; i++)
+        data->playFromRender = fromRender;
+    }
+
+    /* With the stretcher primed, output frames map to take frames by the
+    ** ratio. currentSampleIndex is the read position and runs ahead of this.
+    */
+    double ratio = 1.0;
+    double blockStart = data->playSourcePos;
+
+    if (fromRender)
+    {
+        ratio = data->render->ratio();
+        framesWritten = copyRendered(data, wptr, framesPerBuffer);
+    }
+    else if (data->stretcher && data->stretcher->ratio() != 1.0)
+    {
+        ratio = data->stretcher->ratio();
+        framesWritten = data->stretcher->render(wptr, framesPerBuffer, pullRecorded, data);
+    }
+    else
+        framesWritten = copyRecorded(data, wptr, framesPerBuffer);
+
+    data->playSourcePos += framesWritten / ratio;
+    long loopA = data->loopStart.load(), loopB = data->loopEnd.load();
+    bool inLoop = loopA >= 0 && loopB > loopA && blockStart < loopB;
+    if (inLoop && data->playSourcePos >= loopB)
+        data->playSourcePos -= (loopB - loopA);
+    else if (!inLoop && data->skipSilentGaps.load())
+    {
+        // the output skipped the same gaps the read position did
+        const SilentRegion* gap = gapAfter(data->silentGaps, (long)data->playSourcePos);
+        if (gap && gap->start <= data->playSourcePos)
+            data->playSourcePos += gap->end - gap->start;
+    }
+
+    data->playClock.publish(blockStart, SAMPLE_RATE / ratio, timeInfo, true);
+
+    // First block after pause() or resume
+    if (paused != data->playSilent)
+    {
+        fadeBlock((SAMPLE*)outputBuffer, framesWritten, paused);
+        data->playSilent = paused;
+    }
+
+    if (framesWritten < framesPerBuffer)
+    {
+        /* final buffer... */
+        wptr += framesWritten * NUM_CHANNELS;
+        for (i = framesWritten; i < framesPerBuffer; i++)
         {
             *wptr++ = 0;  /* left */
             if (NUM_CHANNELS == 2) *wptr++ = 0;  /* right */
         }
-        data->currentSampleIndex += framesLeft;
         finished = paComplete;
+        data->events.push({ EngineEventType::Finished, data->playSourcePos });
     }
     else
     {
-        for (i = 0; i < framesPerBuffer; i++)
-        {
-            *wptr++ = *rptr++;  /* left */
-            if (NUM_CHANNELS == 2) *wptr++ = *rptr++;  /* right */
-        }
-        data->currentSampleIndex += framesPerBuffer;
         finished = paContinue;
     }
+
+    data->playLevels->process((const SAMPLE*)outputBuffer, framesPerBuffer);
+    data->playStats.record(statusFlags, framesPerBuffer, StreamStats::Clock::now() - callbackStart);
     return finished;
-}
\ No newline at end of file
+}
+
+
+PaError startPlayback(AudioDevice& device, AudioData* data, double ratio)
+{
+    // The stretcher is kept across plays; only its state is reset
+    if (!data->stretcher)
+        data->stretcher = std::make_unique<StreamingStretcher>(NUM_CHANNELS, FRAMES_PER_BUFFER, ratio);
+    else
+        data->stretcher->reset(ratio);
+
+    // Idle pre-rendering stops here; pick up its render for this speed
+    data->renderCache->cancel();
+    data->renderCache->adopt(ratio);
+
+    data->playStats.reset(SAMPLE_RATE);
+    data->playLevels->reset(SAMPLE_RATE);
+    data->currentSampleIndex = (int)data->takeStart;
+    data->playSourcePos = (double)data->takeStart;
+    data->playFromRender = false;
+    data->playPaused = false;
+    data->playSilent = false;
+    data->take->prefetch(data->takeStart);  // a packed start of the take would play as silence
+
+    PaError err = device.open(AudioDevice::Playback, SAMPLE_RATE, FRAMES_PER_BUFFER, playCallback, data);
+    if (err != paNoError) return err;
+
+    data->playClock.reset(device.latency());
+
+    // From here on commands go through the queue; events of the last play
+    // are stale
+    EngineEvent stale;
+    while (data->events.pop(stale)) {}
+    data->playbackRunning = true;
+    err = device.start();
+    if (err != paNoError) data->playbackRunning = false;
+    return err;
+}
+
+PaError closePlayback(AudioDevice& device, AudioData* data)
+{
+    PaError err = device.close();
+    data->playbackRunning = false;
+
+    // The callback is gone: what it did not get to is applied as if idle
+    EngineCommand command;
+    while (data->commands.pop(command))
+        data->send(command);
+    return err;
+}
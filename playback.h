@@ -1,6 +1,8 @@
 #pragma once
 #include "utils.h"
 
+class AudioDevice;
+
 /* This routine will be called by the PortAudio engine when audio is needed.
 ** It may be called at interrupt level on some machines so don't do anything
 ** that could mess up the system like calling malloc() or free().
@@ -9,4 +11,21 @@ int playCallback(const void* inputBuffer, void* outputBuffer,
     unsigned long framesPerBuffer,
     const PaStreamCallbackTimeInfo* timeInfo,
     PaStreamCallbackFlags statusFlags,
-    void* userData);
\ No newline at end of file
+    void* userData);
+
+/* Reset the stretcher, stats and play position for a new play at `ratio`,
+** then open and start `device` with playCallback. Playback starts at
+** AudioData::takeStart (after any trimmed silence) unless a seek is pending.
+** Background pre-rendering is cancelled first, and a render made for
+** `ratio` is used if there is one.
+**
+** While it runs, AudioData::send() queues transport commands (pause,
+** resume, seek, speed, loop) that the callback applies at its next block;
+** the stream stays open while paused.
+*/
+PaError startPlayback(AudioDevice& device, AudioData* data, double ratio);
+
+/* Close `device` after startPlayback(). Commands the callback did not get
+** to are applied as if sent while idle.
+*/
+PaError closePlayback(AudioDevice& device, AudioData* data);
@@ -0,0 +1,75 @@
+#include "playhead.h"
+#include <chrono>
+#include <cmath>
+
+static int64_t steadyNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+PlayheadClock::PlayheadClock()
+    : seq(0), frame(0.0), rate(0.0), lead(0.0), stampNs(0),
+    latency(0.0), reported(0.0), valid(false)
+{
+}
+
+void PlayheadClock::reset(double reportedLatency)
+{
+    reported = reportedLatency;
+    latency = reportedLatency;
+    valid = false;
+}
+
+void PlayheadClock::publish(double bufferFrame, double framesPerSecond,
+    const PaStreamCallbackTimeInfo* timeInfo, bool output)
+{
+    const auto relaxed = std::memory_order_relaxed;
+    double bufferLead;
+
+    double bufferTime = 0.0;
+    if (timeInfo)
+        bufferTime = output ? timeInfo->outputBufferDacTime : timeInfo->inputBufferAdcTime;
+
+    if (timeInfo && bufferTime != 0.0) {
+        bufferLead = bufferTime - timeInfo->currentTime;
+        latency.store(std::fabs(bufferLead), relaxed);
+    }
+    else {
+        // Some host APIs leave the timestamps at zero
+        double r = reported.load(relaxed);
+        bufferLead = output ? r : -r;
+    }
+
+    uint32_t s = seq.load(relaxed);
+    seq.store(s + 1, relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    frame.store(bufferFrame, relaxed);
+    rate.store(framesPerSecond, relaxed);
+    lead.store(bufferLead, relaxed);
+    stampNs.store(steadyNowNs(), relaxed);
+    seq.store(s + 2, std::memory_order_release);
+    valid.store(true, relaxed);
+}
+
+double PlayheadClock::audibleFrame() const
+{
+    if (!valid.load(std::memory_order_relaxed))
+        return -1.0;
+
+    double f, r, l;
+    int64_t stamp;
+    uint32_t s0, s1;
+    do {
+        s0 = seq.load(std::memory_order_acquire);
+        f = frame.load(std::memory_order_relaxed);
+        r = rate.load(std::memory_order_relaxed);
+        l = lead.load(std::memory_order_relaxed);
+        stamp = stampNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        s1 = seq.load(std::memory_order_relaxed);
+    } while ((s0 & 1) || s0 != s1);
+
+    double elapsed = (steadyNowNs() - stamp) * 1e-9;
+    return f + (elapsed - l) * r;
+}
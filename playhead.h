@@ -0,0 +1,48 @@
+#pragma once
+#include "portaudio.h"
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Maps a stream's callback timestamps to the take position that is audible
+ * (output) or arriving at the converter (input) right now.
+ *
+ * Each callback publishes the take frame of its first buffer frame together
+ * with PaStreamCallbackTimeInfo. The UI extrapolates from there with a
+ * steady clock, so the marker tracks what is heard rather than the
+ * read/write index, which runs ahead by the device latency.
+ *
+ * The anchor is published through a sequence lock: the callback never
+ * waits, and readers retry if they raced with a publish.
+ */
+class PlayheadClock {
+public:
+    PlayheadClock();
+
+    // UI thread, before the stream starts. `reportedLatency` comes from
+    // Pa_GetStreamInfo and is used when the host gives no timestamps.
+    void reset(double reportedLatency);
+
+    // Audio thread. `frame` is the take position of the first frame in the
+    // buffer; `framesPerSecond` is how fast the take advances in real time.
+    void publish(double frame, double framesPerSecond,
+        const PaStreamCallbackTimeInfo* timeInfo, bool output);
+
+    // UI thread. Returns -1 until the first publish after reset().
+    double audibleFrame() const;
+
+    // Seconds between the callback and the buffer reaching/leaving the
+    // converter, as measured by the last callback.
+    double measuredLatency() const { return latency.load(std::memory_order_relaxed); }
+    double reportedLatency() const { return reported.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint32_t> seq;
+    std::atomic<double> frame;
+    std::atomic<double> rate;
+    std::atomic<double> lead;       // buffer time - callback time, in seconds
+    std::atomic<int64_t> stampNs;   // steady clock at publish
+    std::atomic<double> latency;
+    std::atomic<double> reported;
+    std::atomic<bool> valid;
+};
@@ -48,7 +48,8 @@ Record_Button::Record_Button(
 
 void Record_Button::updateGuiRecordStarted() {
     button->SetBitmap(stopBundle);
-    button->SetToolTip("Stop Recording");
+    m_waitingForSignal = recorder->isArmed();
+    button->SetToolTip(m_waitingForSignal ? "Armed: waiting for signal" : "Stop Recording");
 
     wxWindow* top = wxGetTopLevelParent(this);
     if (top)
@@ -118,6 +119,8 @@ void Record_Button::OnRecord(wxCommandEvent& e)
     // If currently Idle, user pressed "Record" -> Start recording
     if (pStateCpy->state == Idle)
     {
+        // Stretch while recording, so Play can start from the render
+        recorder->setRenderRatio(pStateCpy->timeRatio);
         PaError err = recorder->start();
         if (err == paNoError) {
             m_timer.Start(1);
@@ -146,30 +149,32 @@ void Record_Button::OnRecord(wxCommandEvent& e)
 // Timer event handler that checks if the stream is still active
 void Record_Button::OnTimer(wxTimerEvent& WXUNUSED(event))
 {
-    if (!pAudioData->stream) return; // Safety check in case stream is null
+    if (!recorder->getDevice()) return; // Safety check in case stream is closed
 
     PaError err;
-    int active = Pa_IsStreamActive(pAudioData->stream);
+    int active = recorder->isActive();
+    if (active == 1 && m_waitingForSignal && !recorder->waitingForTrigger())
+    {
+        // Armed recording: the trigger fired, the take has begun
+        m_waitingForSignal = false;
+        button->SetToolTip("Stop Recording");
+    }
     if (active == 0)
     {
         // The callback signaled paComplete => buffer is full or done
         // Stop the timer
         m_timer.Stop();
 
-        // Close the stream
-        err = Pa_CloseStream(pAudioData->stream);
+        // Close the stream; this also records the final length
+        err = recorder->stop();
         if (err != paNoError) {
-            std::cerr << "Pa_CloseStream error: "
+            std::cerr << "Record close error: "
                 << Pa_GetErrorText(err) << std::endl;
         }
-        pAudioData->stream = nullptr;
-
-        Pa_Terminate();
 
         // Transition to Idle, reset button label
-        button->SetBitmap(recordBundle);
-        button->SetToolTip("Record");
         pStateCpy->transition(Idle);
+        updateGuiRecordStopped();
     }
     else if (active < 0)
     {
@@ -177,11 +182,8 @@ void Record_Button::OnTimer(wxTimerEvent& WXUNUSED(event))
         std::cerr << "Stream error: " << Pa_GetErrorText(active) << std::endl;
         // Also stop timer, close stream, revert to idle
         m_timer.Stop();
-        err = Pa_CloseStream(pAudioData->stream);
-        pAudioData->stream = nullptr;
-        Pa_Terminate();
-        button->SetBitmap(recordBundle);
-        button->SetToolTip("Record");
+        recorder->stop();
         pStateCpy->transition(Idle);
+        updateGuiRecordStopped();
     }
 }
@@ -18,6 +18,8 @@ public:
 
     wxButton* button;
 
+    AudioRecorder* getRecorder() const { return recorder.get(); }
+
 private:
     std::shared_ptr<State> pStateCpy;
     std::shared_ptr<AudioData> pAudioData;
@@ -28,6 +30,7 @@ private:
 
     wxBitmapBundle recordBundle;
     wxBitmapBundle stopBundle;
+    bool m_waitingForSignal = false;  // armed, take not started yet
 
     // Needed for wxWidgets event routing
     wxDECLARE_EVENT_TABLE();
@@ -0,0 +1,238 @@
+#include "render_cache.h"
+#include "stretch.h"
+#include "take_store.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+const double RenderCache::COMMON_SPEEDS[] = { 0.5, 0.75, 0.8, 0.9, 1.1, 1.25, 1.5, 2.0 };
+const int RenderCache::NUM_COMMON_SPEEDS = sizeof(COMMON_SPEEDS) / sizeof(COMMON_SPEEDS[0]);
+
+namespace {
+
+// Let the stretching yield to everything else, the audio threads above all
+void lowerThreadPriority()
+{
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+    sched_param param = {};
+    pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+#endif
+}
+
+} // namespace
+
+size_t defaultRenderBudget()
+{
+    const char* env = std::getenv("SC_RENDER_BUDGET_MB");
+    long mb = env ? std::strtol(env, nullptr, 10) : 256;
+    return (size_t)std::max(0L, mb) * 1024 * 1024;
+}
+
+RenderCache::RenderCache(AudioData* data, size_t budgetBytes)
+    : data(data),
+    budget(budgetBytes) {
+}
+
+RenderCache::~RenderCache()
+{
+    if (worker.joinable())
+    {
+        cancelled.store(true);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+}
+
+void RenderCache::prerender(double ratio)
+{
+    cancel();
+    if (data->totalSamplesRecorded <= data->takeStart || budget == 0)
+        return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    takeFrom = data->takeStart;
+    takeTo = data->totalSamplesRecorded;
+
+    // Current speed first, then the common ones, nearest first
+    std::vector<double> speeds(COMMON_SPEEDS, COMMON_SPEEDS + NUM_COMMON_SPEEDS);
+    const double speed = 1.0 / ratio;
+    std::stable_sort(speeds.begin(), speeds.end(), [speed](double a, double b) {
+        return std::fabs(a - speed) < std::fabs(b - speed);
+    });
+    std::vector<double> ratios(1, ratio);
+    for (double s : speeds)
+        ratios.push_back(ratioForSpeed(s));
+
+    // Nothing to do for ratio 1 or for what is rendered already
+    auto done = [this](double r) {
+        if (r == 1.0) return true;
+        if (data->render && data->render->ratio() == r) return true;
+        for (auto& render : ready)
+            if (render->ratio() == r) return true;
+        return false;
+    };
+    // Output past TakeRender::MAX_FRAMES would be stretched only to be
+    // thrown away, on every idle round
+    auto tooLong = [this](double r) { return (takeTo - takeFrom) * r > TakeRender::MAX_FRAMES; };
+    pending.clear();
+    for (double r : ratios) {
+        if (!done(r) && !tooLong(r) && std::find(pending.begin(), pending.end(), r) == pending.end())
+            pending.push_back(r);
+    }
+
+    trimToBudget(ratio);
+
+    if (!worker.joinable()) {
+        pool = std::make_unique<ThreadPool>();
+        worker = std::thread(&RenderCache::run, this);
+    }
+    wake.notify_all();
+}
+
+void RenderCache::cancel()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    pending.clear();
+    cancelled.store(true);
+    wake.wait(lock, [this] { return !busy; });
+    cancelled.store(false);
+}
+
+void RenderCache::clear()
+{
+    cancel();
+    std::lock_guard<std::mutex> lock(mutex);
+    ready.clear();
+}
+
+bool RenderCache::adopt(double ratio)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (data->render && data->render->ratio() == ratio)
+        return true;
+
+    auto hit = std::find_if(ready.begin(), ready.end(),
+        [ratio](const std::unique_ptr<TakeRender>& render) { return render->ratio() == ratio; });
+    if (hit == ready.end())
+        return false;
+
+    std::unique_ptr<TakeRender> render = std::move(*hit);
+    ready.erase(hit);
+    if (data->render)
+        ready.push_back(std::move(data->render));
+    data->render = std::move(render);
+    return true;
+}
+
+RenderCache::Usage RenderCache::usage() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Usage u = { 0, (int)ready.size(), (int)pending.size() + rendering };
+    for (auto& render : ready)
+        u.bytes += render->bytes();
+    return u;
+}
+
+// Under mutex: drop the renders farthest from `ratio` until what is ready
+// plus what is pending fits the budget; then drop pending that cannot fit
+void RenderCache::trimToBudget(double ratio)
+{
+    const size_t frameBytes = NUM_CHANNELS * sizeof(SAMPLE);
+    auto estimate = [&](double r) { return (size_t)((takeTo - takeFrom) * r) * frameBytes; };
+
+    size_t wanted = 0;
+    for (double r : pending) wanted += estimate(r);
+
+    std::sort(ready.begin(), ready.end(), [ratio](const std::unique_ptr<TakeRender>& a, const std::unique_ptr<TakeRender>& b) {
+        return std::fabs(1.0 / a->ratio() - 1.0 / ratio) < std::fabs(1.0 / b->ratio() - 1.0 / ratio);
+    });
+    size_t held = 0;
+    for (auto& render : ready) held += render->bytes();
+    while (!ready.empty() && held + wanted > budget) {
+        held -= ready.back()->bytes();
+        ready.pop_back();
+    }
+
+    size_t total = held;
+    std::vector<double> fits;
+    for (double r : pending) {
+        if (total + estimate(r) > budget) break;
+        total += estimate(r);
+        fits.push_back(r);
+    }
+    pending.swap(fits);
+}
+
+void RenderCache::run()
+{
+    lowerThreadPriority();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        wake.wait(lock, [this] { return stopping || !pending.empty(); });
+        if (stopping) return;
+
+        std::vector<double> ratios;
+        ratios.swap(pending);
+        rendering = (int)ratios.size();
+        long from = takeFrom, to = takeTo;
+        busy = true;
+        lock.unlock();
+
+        renderBatch(ratios, from, to);
+
+        lock.lock();
+        busy = false;
+        rendering = 0;
+        wake.notify_all();
+    }
+}
+
+// Take frames [from, to) at every ratio: a StretchBatch reads the take a
+// block at a time, once for all the renders, and appends each block to
+// them in parallel. The input held is one block, whatever the take's
+// length or storage.
+void RenderCache::renderBatch(const std::vector<double>& ratios, long from, long to)
+{
+    std::vector<std::unique_ptr<TakeRender>> renders;
+    for (double ratio : ratios) {
+        renders.push_back(std::make_unique<TakeRender>(ratio, from));
+        renders.back()->reserve(to - from);
+    }
+
+    const TakeStore* take = data->take.get();
+    StretchBatch batch([take, from](size_t at, size_t frames, float* const* planar) {
+        for (int c = 0; c < NUM_CHANNELS; c++)
+            take->read(c, from + (long)at, (long)frames, planar[c]);
+    }, (size_t)(to - from), NUM_CHANNELS, SAMPLE_RATE);
+
+    bool done = batch.feedAll(*pool, renders.size(), [&renders](size_t i, const float* const* planar, size_t frames, bool final) {
+        lowerThreadPriority();
+        renders[i]->append(planar, (long)frames);
+        if (final)
+            renders[i]->finish();
+    }, &cancelled);
+    if (!done)
+        return;
+
+    // Renders too long to keep gave up on their own
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& render : renders) {
+        rendering--;
+        if (render->ready())
+            ready.push_back(std::move(render));
+    }
+}
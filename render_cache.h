@@ -0,0 +1,79 @@
+#pragma once
+#include "take_render.h"
+#include "thread_pool.h"
+#include "utils.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Byte budget for RenderCache, from SC_RENDER_BUDGET_MB (default 256)
+size_t defaultRenderBudget();
+
+// Time ratio for a playback speed, computed exactly as the speed slider does
+inline double ratioForSpeed(double speed) { return 1.0 / speed; }
+
+/**
+ * Speculative renders of the finished take at the speeds users tend to
+ * pick, made on a low-priority thread while the app is idle. The current
+ * speed goes first, then COMMON_SPEEDS from the nearest outwards, for as
+ * long as the renders fit in the byte budget. A round is a StretchBatch over
+ * the take: it reads the take a block at a time, once for all its ratios,
+ * and every ratio renders each block in parallel on a pool.
+ *
+ * Capture and playback cancel the work before they start (cancel() returns
+ * once the worker has let go of the take). startPlayback() then swaps the
+ * render for its ratio, if there is one, into AudioData::render.
+ */
+class RenderCache {
+public:
+    static const double COMMON_SPEEDS[];
+    static const int NUM_COMMON_SPEEDS;
+
+    explicit RenderCache(AudioData* data, size_t budgetBytes = defaultRenderBudget());
+    ~RenderCache();
+    RenderCache(const RenderCache&) = delete;
+    RenderCache& operator=(const RenderCache&) = delete;
+
+    // Idle: render what is missing around `ratio` in the background
+    void prerender(double ratio);
+
+    // Stop the background work and wait until the round has let go of the take
+    void cancel();
+
+    // New take: cancel, and forget every render
+    void clear();
+
+    // Swap a ready render at `ratio` into AudioData::render; the render that
+    // was there is kept in the cache instead. Call only while nothing plays.
+    bool adopt(double ratio);
+
+    struct Usage {
+        size_t bytes;
+        int renders;
+        int pending;
+    };
+    Usage usage() const;
+
+private:
+    void run();
+    void renderBatch(const std::vector<double>& ratios, long from, long to);
+    void trimToBudget(double ratio);
+
+    AudioData* data;  // not owning
+    const size_t budget;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<double> pending;                   // ratios still to render, in order
+    std::vector<std::unique_ptr<TakeRender>> ready;
+    long takeFrom = 0, takeTo = 0;                 // the part of the take to render
+    int rendering = 0;                             // ratios taken from pending, not done yet
+    bool busy = false;                             // a round is running
+    bool stopping = false;
+    std::atomic<bool> cancelled{ false };
+    std::unique_ptr<ThreadPool> pool;              // the renders of a round
+    std::thread worker;                            // reads the take, runs rounds
+};
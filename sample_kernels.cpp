@@ -0,0 +1,278 @@
+#include "sample_kernels.h"
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SC_HAVE_SSE2 1
+#endif
+
+void deinterleave(const SAMPLE* in, SAMPLE* const* planar, size_t offset, size_t frames, int channels)
+{
+    size_t f = 0;
+
+    if (channels == 2)
+    {
+        SAMPLE* l = planar[0] + offset;
+        SAMPLE* r = planar[1] + offset;
+#ifdef SC_HAVE_SSE2
+        if (std::is_same<SAMPLE, float>::value)
+        {
+            for (; f + 4 <= frames; f += 4)
+            {
+                __m128 a = _mm_loadu_ps(in + 2 * f);      // l0 r0 l1 r1
+                __m128 b = _mm_loadu_ps(in + 2 * f + 4);  // l2 r2 l3 r3
+                _mm_storeu_ps(l + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+                _mm_storeu_ps(r + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+            }
+        }
+#endif
+        for (; f < frames; f++) {
+            l[f] = in[2 * f];
+            r[f] = in[2 * f + 1];
+        }
+        return;
+    }
+
+    for (int c = 0; c < channels; c++)
+    {
+        SAMPLE* dst = planar[c] + offset;
+        for (f = 0; f < frames; f++)
+            dst[f] = in[f * channels + c];
+    }
+}
+
+void interleave(const SAMPLE* const* planar, size_t offset, SAMPLE* out, size_t frames, int channels)
+{
+    size_t f = 0;
+
+    if (channels == 2)
+    {
+        const SAMPLE* l = planar[0] + offset;
+        const SAMPLE* r = planar[1] + offset;
+#ifdef SC_HAVE_SSE2
+        if (std::is_same<SAMPLE, float>::value)
+        {
+            for (; f + 4 <= frames; f += 4)
+            {
+                __m128 a = _mm_loadu_ps(l + f);
+                __m128 b = _mm_loadu_ps(r + f);
+                _mm_storeu_ps(out + 2 * f, _mm_unpacklo_ps(a, b));
+                _mm_storeu_ps(out + 2 * f + 4, _mm_unpackhi_ps(a, b));
+            }
+        }
+#endif
+        for (; f < frames; f++) {
+            out[2 * f] = l[f];
+            out[2 * f + 1] = r[f];
+        }
+        return;
+    }
+
+    for (int c = 0; c < channels; c++)
+    {
+        const SAMPLE* src = planar[c] + offset;
+        for (f = 0; f < frames; f++)
+            out[f * channels + c] = src[f];
+    }
+}
+
+// ------------------------------------------------------------
+// Compact storage conversions
+// ------------------------------------------------------------
+
+namespace {
+
+const float INT16_SCALE = 32767.0f;
+
+inline uint32_t floatBits(float v) { uint32_t u; std::memcpy(&u, &v, 4); return u; }
+inline float bitsFloat(uint32_t u) { float v; std::memcpy(&v, &u, 4); return v; }
+
+// Scalar twins of the SSE2 code below; same operations, same results
+inline int16_t toInt16(float v)
+{
+    v = v > -1.0f ? v : -1.0f;   // NaN clips to -1, as _mm_max_ps does
+    v = v < 1.0f ? v : 1.0f;
+    return (int16_t)std::lrint(v * INT16_SCALE);
+}
+
+inline uint16_t toHalf(float v)
+{
+    uint32_t u = floatBits(v);
+    uint32_t sign = u & 0x80000000u;
+    u ^= sign;
+
+    uint32_t h;
+    if (u >= (127u + 16) << 23)                  // overflows to Inf, or NaN
+        h = u > 255u << 23 ? 0x7e00 : 0x7c00;
+    else if (u < (127u - 14) << 23) {           // half subnormal or zero
+        const float magic = bitsFloat(((127u - 15) + (23 - 10) + 1) << 23);
+        h = floatBits(bitsFloat(u) + magic) - floatBits(magic);
+    }
+    else {                                      // normal: rebias, round to nearest even
+        uint32_t odd = (u >> 13) & 1;
+        h = (u + 0xfff - ((127u - 15) << 23) + odd) >> 13;
+    }
+    return (uint16_t)(h | (sign >> 16));
+}
+
+inline float fromHalf(uint16_t h)
+{
+    const uint32_t expMask = 0x7c00u << 13;
+    uint32_t u = (uint32_t)(h & 0x7fff) << 13;
+    uint32_t exp = u & expMask;
+    u += (127u - 15) << 23;
+    if (exp == expMask)                         // Inf / NaN
+        u += (128u - 16) << 23;
+    else if (exp == 0)                          // zero / subnormal: renormalise
+        u = floatBits(bitsFloat(u + (1u << 23)) - bitsFloat(113u << 23));
+    return bitsFloat(u | (uint32_t)(h & 0x8000) << 16);
+}
+
+#ifdef SC_HAVE_SSE2
+inline __m128i toHalf4(__m128 v)
+{
+    const __m128i f16max = _mm_set1_epi32((127 + 16) << 23);
+    const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);
+    const __m128i subMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+    const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+    __m128 sign = _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000u)));
+    __m128 absf = _mm_xor_ps(v, sign);
+    __m128i u = _mm_castps_si128(absf);
+
+    __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absf, absf));
+    __m128i special = _mm_or_si128(_mm_and_si128(isNan, _mm_set1_epi32(0x200)), _mm_set1_epi32(0x7c00));
+    __m128i isRegular = _mm_cmpgt_epi32(f16max, u);
+    __m128i isSub = _mm_cmpgt_epi32(minNormal, u);
+
+    __m128i sub = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absf, _mm_castsi128_ps(subMagic))), subMagic);
+    __m128i odd = _mm_and_si128(_mm_srli_epi32(u, 13), _mm_set1_epi32(1));
+    __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(u, normalBias), odd), 13);
+
+    __m128i h = _mm_or_si128(_mm_and_si128(isSub, sub), _mm_andnot_si128(isSub, normal));
+    h = _mm_or_si128(_mm_and_si128(isRegular, h), _mm_andnot_si128(isRegular, special));
+    // sign >> 16 arithmetically keeps each lane a valid int16 for the pack
+    return _mm_or_si128(h, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
+
+inline __m128 fromHalf4(__m128i h)  // h: one half per 32-bit lane, zero-extended
+{
+    const __m128i expMask = _mm_set1_epi32(0x7c00 << 13);
+    __m128i u = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13);
+    __m128i exp = _mm_and_si128(u, expMask);
+    u = _mm_add_epi32(u, _mm_set1_epi32((127 - 15) << 23));
+
+    __m128i isInfNan = _mm_cmpeq_epi32(exp, expMask);
+    u = _mm_add_epi32(u, _mm_and_si128(isInfNan, _mm_set1_epi32((128 - 16) << 23)));
+
+    __m128i isSub = _mm_cmpeq_epi32(exp, _mm_setzero_si128());
+    __m128 renorm = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(u, _mm_set1_epi32(1 << 23))),
+                               _mm_castsi128_ps(_mm_set1_epi32(113 << 23)));
+    u = _mm_or_si128(_mm_and_si128(isSub, _mm_castps_si128(renorm)), _mm_andnot_si128(isSub, u));
+
+    __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+    return _mm_castsi128_ps(_mm_or_si128(u, sign));
+}
+#endif
+
+} // namespace
+
+void floatToInt16(const float* in, int16_t* out, size_t n)
+{
+    size_t i = 0;
+#ifdef SC_HAVE_SSE2
+    const __m128 lo = _mm_set1_ps(-1.0f), hi = _mm_set1_ps(1.0f), scale = _mm_set1_ps(INT16_SCALE);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), lo), hi);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), lo), hi);
+        __m128i ia = _mm_cvtps_epi32(_mm_mul_ps(a, scale));
+        __m128i ib = _mm_cvtps_epi32(_mm_mul_ps(b, scale));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(ia, ib));
+    }
+#endif
+    for (; i < n; i++)
+        out[i] = toInt16(in[i]);
+}
+
+void int16ToFloat(const int16_t* in, float* out, size_t n)
+{
+    size_t i = 0;
+#ifdef SC_HAVE_SSE2
+    const __m128 scale = _mm_set1_ps(1.0f / INT16_SCALE);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        // sign-extend by placing each sample in the top half, then shifting down
+        __m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i b = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+    }
+#endif
+    for (; i < n; i++)
+        out[i] = in[i] * (1.0f / INT16_SCALE);
+}
+
+void floatToHalf(const float* in, uint16_t* out, size_t n)
+{
+    size_t i = 0;
+#ifdef SC_HAVE_SSE2
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i a = toHalf4(_mm_loadu_ps(in + i));
+        __m128i b = toHalf4(_mm_loadu_ps(in + i + 4));
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(a, b));
+    }
+#endif
+    for (; i < n; i++)
+        out[i] = toHalf(in[i]);
+}
+
+void halfToFloat(const uint16_t* in, float* out, size_t n)
+{
+    size_t i = 0;
+#ifdef SC_HAVE_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        _mm_storeu_ps(out + i, fromHalf4(_mm_unpacklo_epi16(v, zero)));
+        _mm_storeu_ps(out + i + 4, fromHalf4(_mm_unpackhi_epi16(v, zero)));
+    }
+#endif
+    for (; i < n; i++)
+        out[i] = fromHalf(in[i]);
+}
+
+float sumOfSquares(const float* in, size_t n)
+{
+    size_t i = 0;
+    float sum = 0.0f;
+#ifdef SC_HAVE_SSE2
+    __m128 a = _mm_setzero_ps(), b = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128 x = _mm_loadu_ps(in + i);
+        __m128 y = _mm_loadu_ps(in + i + 4);
+        a = _mm_add_ps(a, _mm_mul_ps(x, x));
+        b = _mm_add_ps(b, _mm_mul_ps(y, y));
+    }
+    __m128 s = _mm_add_ps(a, b);                  // s0 s1 s2 s3
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));       // s0+s2 s1+s3
+    sum = _mm_cvtss_f32(s) + _mm_cvtss_f32(_mm_shuffle_ps(s, s, 1));
+#else
+    float lanes[8] = {};
+    for (; i + 8 <= n; i += 8)
+        for (int k = 0; k < 8; k++)
+            lanes[k] += in[i + k] * in[i + k];
+    float s[4];
+    for (int k = 0; k < 4; k++) s[k] = lanes[k] + lanes[k + 4];
+    sum = (s[0] + s[2]) + (s[1] + s[3]);
+#endif
+    for (; i < n; i++)
+        sum += in[i] * in[i];
+    return sum;
+}
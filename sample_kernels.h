@@ -0,0 +1,33 @@
+#pragma once
+#include "utils.h"
+#include <cstddef>
+#include <cstdint>
+
+/* Conversions between the interleaved frames PortAudio and WAV files use
+** and the planar (one array per channel) layout AudioData keeps. The
+** planar side is addressed as planar[c][offset + f]; no alignment is
+** required of either side.
+**
+** Stereo float has an SSE2 path (4 frames per step); everything else, and
+** non-x86 builds, use the plain loops.
+*/
+void deinterleave(const SAMPLE* in, SAMPLE* const* planar, size_t offset, size_t frames, int channels);
+void interleave(const SAMPLE* const* planar, size_t offset, SAMPLE* out, size_t frames, int channels);
+
+/* Conversions for the compact SampleStorage formats, SSE2 on x86 (8
+** samples per step) with a scalar fallback that gives identical results.
+**
+** Int16 is symmetric: v * 32767, rounded to nearest and clipped to
+** [-1, 1]; back as s / 32767. Float16 is IEEE half precision, round to
+** nearest even; values beyond 65504 become infinity, NaN stays NaN.
+*/
+void floatToInt16(const float* in, int16_t* out, size_t n);
+void int16ToFloat(const int16_t* in, float* out, size_t n);
+void floatToHalf(const float* in, uint16_t* out, size_t n);
+void halfToFloat(const uint16_t* in, float* out, size_t n);
+
+/* Sum of v * v over n samples, for RMS levels. SSE2 keeps 8 partial sums
+** (two registers); the scalar fallback adds in the same order, so both
+** give the same result.
+*/
+float sumOfSquares(const float* in, size_t n);
@@ -0,0 +1,86 @@
+#include "scratch_arena.h"
+#include <algorithm>
+#include <new>
+
+namespace {
+    const size_t MIN_BLOCK = 64 * 1024;
+
+    size_t roundUp(size_t n) { return (n + ScratchArena::ALIGN - 1) / ScratchArena::ALIGN * ScratchArena::ALIGN; }
+}
+
+ScratchArena::~ScratchArena()
+{
+    releaseAll();
+}
+
+void ScratchArena::releaseAll()
+{
+    for (Block& b : blocks)
+        ::operator delete(b.data, std::align_val_t(ALIGN));
+    blocks.clear();
+    current = offset = 0;
+}
+
+void ScratchArena::addBlock(size_t bytes)
+{
+    Block b;
+    b.size = std::max(roundUp(bytes), MIN_BLOCK);
+    b.data = static_cast<char*>(::operator new(b.size, std::align_val_t(ALIGN)));
+    blocks.push_back(b);
+    allocations++;
+}
+
+void* ScratchArena::allocBytes(size_t bytes)
+{
+    bytes = roundUp(std::max<size_t>(bytes, 1));
+
+    // Bump in the current block, else move on to (or add) a big enough one
+    while (current < blocks.size() && offset + bytes > blocks[current].size) {
+        current++;
+        offset = 0;
+    }
+    if (current == blocks.size()) {
+        size_t grow = blocks.empty() ? 0 : blocks.back().size;
+        addBlock(std::max(bytes, grow));
+    }
+
+    void* p = blocks[current].data + offset;
+    offset += bytes;
+    inUse += bytes;
+    peak = std::max(peak, inUse);
+    return p;
+}
+
+void ScratchArena::reserve(size_t bytes)
+{
+    size_t freeInCurrent = current < blocks.size() ? blocks[current].size - offset : 0;
+    if (freeInCurrent >= roundUp(bytes))
+        return;
+    if (inUse == 0) {
+        releaseAll();
+        addBlock(bytes);
+    }
+    else {
+        addBlock(bytes);
+    }
+}
+
+void ScratchArena::reset()
+{
+    // Fold several blocks into one that holds the high-water mark, so the
+    // next round fits in a single block
+    if (blocks.size() > 1) {
+        releaseAll();
+        addBlock(peak);
+    }
+    current = offset = 0;
+    inUse = 0;
+}
+
+size_t ScratchArena::capacity() const
+{
+    size_t total = 0;
+    for (const Block& b : blocks)
+        total += b.size;
+    return total;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+/**
+ * Bump allocator for render scratch: planar blocks, pointer tables and
+ * the like. Every allocation is ALIGN-byte aligned. reset() releases all
+ * allocations but keeps the memory (folded into one block of the largest
+ * size seen), so once a render has run at a given size, running it again
+ * makes no system allocations.
+ *
+ * Not thread-safe; give each thread its own arena.
+ */
+class ScratchArena {
+public:
+    static const size_t ALIGN = 64;
+
+    ScratchArena() = default;
+    ~ScratchArena();
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    // Uninitialised storage for `count` objects of a trivial type T
+    template <class T>
+    T* alloc(size_t count) { return static_cast<T*>(allocBytes(count * sizeof(T))); }
+
+    // Make sure the next `bytes` of allocations fit without growing
+    void reserve(size_t bytes);
+
+    void reset();
+
+    size_t capacity() const;                            // bytes held
+    size_t highWater() const { return peak; }           // most bytes in use between resets
+    size_t systemAllocations() const { return allocations; }  // blocks obtained so far
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    void* allocBytes(size_t bytes);
+    void addBlock(size_t bytes);
+    void releaseAll();
+
+    std::vector<Block> blocks;
+    size_t current = 0;     // block being bumped
+    size_t offset = 0;      // into blocks[current]
+    size_t inUse = 0;
+    size_t peak = 0;
+    size_t allocations = 0;
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include "utils.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class SignalType { Sine, Sweep, Noise, Impulse, MultiTone, Sawtooth };
+
+struct SignalParams {
+    SignalType type = SignalType::Sine;
+    double level = -6.0;                 // peak level, dBFS
+    std::vector<double> frequencies = { 440.0 };  // Sine/Sawtooth: one, MultiTone: several
+    double sweepStart = 20.0;            // Sweep: exponential, repeating
+    double sweepEnd = 20000.0;
+    double sweepSeconds = 10.0;
+    double impulseInterval = 0.5;        // Impulse: seconds between clicks
+    uint32_t seed = 1;                   // Noise
+};
+
+/* Parse a signal spec of the form <type>[:<args>][@<level dBFS>]:
+**   sine[:FREQ]              sine, default 440 Hz
+**   sweep[:F0-F1[:SECONDS]]  exponential sine sweep, default 20-20000 Hz over 10 s
+**   noise                    white noise
+**   impulse[:SECONDS]        one-sample clicks, default every 0.5 s
+**   tones[:F,F,...]          sum of sines, default an A major triad
+**   saw[:FREQ]               naive (aliasing) sawtooth, default 220 Hz
+** e.g. "sweep:50-5000:4@-12". Returns false and sets `error` if malformed.
+*/
+bool parseSignalSpec(const std::string& spec, SignalParams& params, std::string& error);
+
+/**
+ * Synthesises test signals block by block, the same on every channel.
+ * Works on fixed-size mono blocks with straight-line loops over plain
+ * arrays (polynomial sine, lane-parallel xorshift noise) so the compiler
+ * vectorises them; a stereo stream runs several hundred times faster than
+ * real time. generate() does not allocate and is safe in an audio callback.
+ */
+class SignalGenerator {
+public:
+    // Elements processed per step of the inner loops
+    static const unsigned LANES = 8;
+
+    SignalGenerator(const SignalParams& params, double sampleRate, int channels);
+
+    // Back to t = 0 with the initial noise state
+    void reset();
+
+    // Next `frames` frames, interleaved
+    void generate(SAMPLE* out, unsigned long frames);
+
+    const SignalParams& params() const { return p; }
+
+private:
+    static const unsigned BLOCK = 256;   // frames per mono block, a multiple of LANES
+
+    void generateMono(unsigned n);
+    void sweepPhases(float* phase, unsigned n);
+
+    SignalParams p;
+    double rate;
+    int channels;
+    float amplitude;
+
+    uint64_t frame = 0;                  // frames generated since reset()
+    std::vector<double> tonePhases;      // cycles, [0, 1)
+    double sweepBase = 0.0;              // phase carried across sweep restarts
+    double sweepFrame = 0.0;             // frames into the current sweep
+    uint32_t noiseState[LANES];          // one xorshift32 per lane
+
+    std::vector<float> mono;             // BLOCK frames of output
+    std::vector<float> phase;            // BLOCK phases in [-0.5, 0.5)
+};
@@ -0,0 +1,95 @@
+#include "silence_detector.h"
+#include "sample_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+SilenceSettings defaultSilenceSettings()
+{
+    SilenceSettings settings;
+    if (const char* db = std::getenv("SC_SILENCE_DB"))
+        settings.thresholdDb = std::strtof(db, nullptr);
+    if (const char* trim = std::getenv("SC_SILENCE_TRIM"))
+        settings.trim = std::strcmp(trim, "0") != 0;
+    if (const char* skip = std::getenv("SC_SKIP_GAPS"))
+        settings.skipGaps = std::strcmp(skip, "1") == 0;
+    return settings;
+}
+
+SilenceDetector::SilenceDetector(double sampleRate, const SilenceSettings& settings)
+    : settings(settings),
+    openLevel(std::pow(10.0f, settings.thresholdDb / 10.0f)),
+    closeLevel(std::pow(10.0f, (settings.thresholdDb - settings.hysteresisDb) / 10.0f)),
+    holdFrames((long)(settings.holdSeconds * sampleRate)),
+    padFrames((long)(settings.padSeconds * sampleRate)),
+    minGapFrames((long)(settings.minGapSeconds * sampleRate)) {
+}
+
+void SilenceDetector::reset()
+{
+    seen = 0;
+    windowFill = 0;
+    windowSum = 0.0f;
+    open = false;
+    firstSound = -1;
+    lastLoudEnd = -1;
+    silences.clear();
+}
+
+void SilenceDetector::process(const SAMPLE* const* channels, int numChannels, long frames)
+{
+    for (long done = 0; done < frames; )
+    {
+        long n = std::min(frames - done, WINDOW_FRAMES - windowFill);
+        for (int c = 0; c < numChannels; c++)
+            windowSum += sumOfSquares(channels[c] + done, n);
+        windowFill += n;
+        done += n;
+
+        if (windowFill == WINDOW_FRAMES) {
+            long end = seen + done;
+            closeWindow(end - WINDOW_FRAMES, windowSum / (WINDOW_FRAMES * numChannels));
+            windowFill = 0;
+            windowSum = 0.0f;
+        }
+    }
+    seen += frames;
+}
+
+void SilenceDetector::closeWindow(long windowStart, float meanSquare)
+{
+    bool loud = meanSquare >= (open ? closeLevel : openLevel);
+
+    if (loud)
+    {
+        if (!open) {
+            open = true;
+            if (firstSound < 0)
+                firstSound = windowStart;
+            else if (windowStart > lastLoudEnd)
+                silences.push_back({ lastLoudEnd, windowStart });
+        }
+        lastLoudEnd = windowStart + WINDOW_FRAMES;
+    }
+    else if (open && windowStart + WINDOW_FRAMES - lastLoudEnd >= holdFrames)
+        open = false;
+}
+
+SilentRegion SilenceDetector::soundBounds() const
+{
+    if (firstSound < 0)
+        return { 0, seen };
+    return { std::max(0L, firstSound - padFrames), std::min(seen, lastLoudEnd + padFrames) };
+}
+
+std::vector<SilentRegion> SilenceDetector::gaps() const
+{
+    std::vector<SilentRegion> result;
+    for (const SilentRegion& s : silences) {
+        SilentRegion g{ s.start + padFrames, s.end - padFrames };
+        if (g.end - g.start >= minGapFrames)
+            result.push_back(g);
+    }
+    return result;
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "utils.h"
+#include <vector>
+
+/* What counts as silence, and what to do about it. */
+struct SilenceSettings {
+    float thresholdDb = -60.0f;  // RMS that opens the gate, dBFS
+    float hysteresisDb = 6.0f;   // the gate closes this far below the threshold
+    double holdSeconds = 0.25;   // quiet this long before the gate closes
+    double padSeconds = 0.05;    // kept on each side of sound when cutting
+    double minGapSeconds = 2.0;  // shorter silent gaps are not skipped
+    bool trim = true;            // drop leading / trailing silence when recording stops
+    bool skipGaps = false;       // jump over long silent gaps while playing
+};
+
+// From SC_SILENCE_DB (threshold), SC_SILENCE_TRIM ("0" keeps the whole
+// take) and SC_SKIP_GAPS ("1" skips gaps)
+SilenceSettings defaultSilenceSettings();
+
+/* Streaming RMS gate. Frames are fed in order, in planar blocks of any
+** size; every WINDOW_FRAMES frames the mean square over all channels is
+** compared against the gate. The gate opens when a window reaches
+** thresholdDb and closes once the level has stayed hysteresisDb below it
+** for holdSeconds, so the dips between notes do not count as silence.
+**
+** Positions are in frames fed so far (take frames when fed from frame 0).
+** Cheap enough for any thread, but not real-time safe: gaps are kept in a
+** growing vector.
+*/
+class SilenceDetector {
+public:
+    static const long WINDOW_FRAMES = 256;  // ~6 ms at 44.1 kHz
+
+    explicit SilenceDetector(double sampleRate, const SilenceSettings& settings = SilenceSettings());
+
+    void reset();
+    void process(const SAMPLE* const* channels, int numChannels, long frames);
+
+    long framesSeen() const { return seen; }
+    bool soundFound() const { return firstSound >= 0; }
+
+    // The part of the take worth keeping: first to last sound, padded.
+    // The whole of it when nothing but silence was seen.
+    SilentRegion soundBounds() const;
+
+    // Silent gaps between sounds of at least minGapSeconds, shrunk by the
+    // padding on both sides. Sorted, not overlapping.
+    std::vector<SilentRegion> gaps() const;
+
+private:
+    void closeWindow(long windowStart, float meanSquare);
+
+    SilenceSettings settings;
+    float openLevel;   // mean square that opens the gate
+    float closeLevel;  // and below which it starts closing
+    long holdFrames;
+    long padFrames;
+    long minGapFrames;
+
+    long seen = 0;
+    long windowFill = 0;
+    float windowSum = 0.0f;
+
+    bool open = false;
+    long firstSound = -1;
+    long lastLoudEnd = -1;  // end of the last window that kept the gate open
+    std::vector<SilentRegion> silences;  // closed gaps between sounds, unpadded
+};
@@ -0,0 +1,76 @@
+#include "spectrogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+Spectrogram::Spectrogram(long capacity)
+    : plan(FftPlan::forSize(FFT_SIZE)),
+    window(FFT_SIZE),
+    history(FFT_SIZE, 0.0f),
+    re(FFT_SIZE / 2),
+    im(FFT_SIZE / 2),
+    blocks(std::max(capacity, 0L) / HOP / BLOCK_FRAMES + 1)
+{
+    const double twoPi = 6.283185307179586;
+    for (int i = 0; i < FFT_SIZE; i++)
+        window[i] = (float)(0.5 - 0.5 * std::cos(twoPi * i / FFT_SIZE));
+}
+
+void Spectrogram::reset()
+{
+    std::fill(history.begin(), history.end(), 0.0f);
+    fill = 0;
+    written = 0;
+    published.store(0);
+}
+
+void Spectrogram::process(const SAMPLE* const* channels, int numChannels, long frames)
+{
+    const float gain = 1.0f / numChannels;
+    long f = 0;
+    while (f < frames)
+    {
+        const long n = std::min<long>(frames - f, HOP - fill);
+        float* out = history.data() + (FFT_SIZE - HOP) + fill;
+        for (long i = 0; i < n; i++) {
+            float s = 0.0f;
+            for (int c = 0; c < numChannels; c++)
+                s += channels[c][f + i];
+            out[i] = s * gain;
+        }
+        fill += (int)n;
+        f += n;
+
+        if (fill == HOP) {
+            transform();
+            std::memmove(history.data(), history.data() + HOP, (FFT_SIZE - HOP) * sizeof(float));
+            fill = 0;
+        }
+    }
+}
+
+void Spectrogram::transform()
+{
+    if (written >= (long)blocks.size() * BLOCK_FRAMES)
+        return;  // the take is full
+
+    plan->forward(history.data(), window.data(), re.data(), im.data());
+
+    auto& block = blocks[written / BLOCK_FRAMES];
+    if (!block)
+        block.reset(new uint8_t[BLOCK_FRAMES * BINS]);
+    uint8_t* out = block.get() + (written % BLOCK_FRAMES) * BINS;
+
+    // A full-scale sine through the Hann window peaks at FFT_SIZE / 4
+    const float powerScale = 16.0f / ((float)FFT_SIZE * FFT_SIZE);
+    const float steps = 255.0f / -FLOOR_DB;
+    for (int k = 0; k < BINS; k++)
+    {
+        const float power = (re[k] * re[k] + im[k] * im[k]) * powerScale;
+        const float db = 10.0f * std::log10(power + 1e-20f);
+        out[k] = (uint8_t)std::clamp((db - FLOOR_DB) * steps + 0.5f, 0.0f, 255.0f);
+    }
+
+    written++;
+    published.store(written, std::memory_order_release);
+}
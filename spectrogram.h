@@ -0,0 +1,61 @@
+#pragma once
+#include "fft.h"
+#include "utils.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/* Magnitude spectra of the take, made while it is captured. The channels
+** are mixed to mono and every HOP frames the last FFT_SIZE are windowed
+** (Hann) and transformed with a shared FftPlan. Each spectrum is kept as
+** BINS bytes, 0 at FLOOR_DB or below up to 255 at 0 dBFS (0.38 dB steps),
+** so the view can redraw at any zoom without transforming anything again:
+** 512 bytes per 11.6 ms at 44.1 kHz, about 2.6 MB per minute.
+**
+** Spectrum i is centred on take frame i * HOP. One thread (the capture
+** monitor) writes with process(); any thread may read the spectra below
+** frames() without locking, as the storage comes in blocks that are never
+** moved or freed before the Spectrogram is. A reader still busy with the
+** last take after reset() sees the new take's levels, never freed memory.
+*/
+class Spectrogram {
+public:
+    static const int FFT_SIZE = 1024;
+    static const int HOP = FFT_SIZE / 2;
+    static const int BINS = FFT_SIZE / 2;  // DC up to just below Nyquist
+    static constexpr float FLOOR_DB = -96.0f;
+
+    // For takes of up to `capacity` frames
+    explicit Spectrogram(long capacity);
+    Spectrogram(const Spectrogram&) = delete;
+    Spectrogram& operator=(const Spectrogram&) = delete;
+
+    // New take; not while process() runs
+    void reset();
+
+    // Writer: the next `frames` frames of the take, planar
+    void process(const SAMPLE* const* channels, int numChannels, long frames);
+
+    // Spectra ready so far
+    long frames() const { return published.load(std::memory_order_acquire); }
+
+    // BINS levels of spectrum i < frames()
+    const uint8_t* frame(long i) const { return blocks[i / BLOCK_FRAMES].get() + (i % BLOCK_FRAMES) * BINS; }
+
+    static float levelToDb(uint8_t level) { return FLOOR_DB - FLOOR_DB * level / 255.0f; }
+
+private:
+    static const long BLOCK_FRAMES = 256;  // spectra per storage block (128 KB)
+
+    void transform();
+
+    std::shared_ptr<const FftPlan> plan;
+    std::vector<float> window;
+    std::vector<float> history;   // FFT_SIZE mono frames, the newest last
+    int fill = 0;                 // new frames in the second half of history
+    std::vector<float> re, im;
+    std::vector<std::unique_ptr<uint8_t[]>> blocks;  // allocated as they first fill
+    long written = 0;
+    std::atomic<long> published{ 0 };
+};
@@ -24,7 +24,18 @@ bool State::transition(states newState) {
 	}
 	else if (newState == Playing) {
 		if ((state == Idle) ||
-			(state == Playing))
+			(state == Playing) ||
+			(state == Paused))
+		{
+			state = newState;
+			success = true;
+		}
+		else
+			success = false;
+	}
+	else if (newState == Paused) {
+		if ((state == Playing) ||
+			(state == Paused))
 		{
 			state = newState;
 			success = true;
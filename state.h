@@ -4,6 +4,7 @@ enum states {
     Idle,
     Recording,
     Playing,
+    Paused,     // playback stream open, outputting silence
 };
 
 class State {
@@ -0,0 +1,136 @@
+#include "stream_stats.h"
+#include <cstdio>
+#include <limits>
+
+StreamStats::StreamStats()
+    : sampleRate(0.0)
+{
+    reset(0.0);
+}
+
+void StreamStats::reset(double rate)
+{
+    sampleRate = rate;
+    callbacks = 0;
+    inputOverflows = 0;
+    inputUnderflows = 0;
+    outputOverflows = 0;
+    outputUnderflows = 0;
+    primingOutput = 0;
+    totalNs = 0;
+    minNs = std::numeric_limits<uint64_t>::max();
+    maxNs = 0;
+    lastFrames = 0;
+    cpuLoad = 0.0;
+    for (auto& b : histogram) b = 0;
+}
+
+void StreamStats::record(PaStreamCallbackFlags statusFlags, unsigned long frames, Clock::duration elapsed)
+{
+    const auto relaxed = std::memory_order_relaxed;
+    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+
+    if (statusFlags & paInputOverflow)   inputOverflows.fetch_add(1, relaxed);
+    if (statusFlags & paInputUnderflow)  inputUnderflows.fetch_add(1, relaxed);
+    if (statusFlags & paOutputOverflow)  outputOverflows.fetch_add(1, relaxed);
+    if (statusFlags & paOutputUnderflow) outputUnderflows.fetch_add(1, relaxed);
+    if (statusFlags & paPrimingOutput)   primingOutput.fetch_add(1, relaxed);
+
+    totalNs.fetch_add(ns, relaxed);
+    lastFrames.store(frames, relaxed);
+
+    uint64_t cur = minNs.load(relaxed);
+    while (ns < cur && !minNs.compare_exchange_weak(cur, ns, relaxed)) {}
+    cur = maxNs.load(relaxed);
+    while (ns > cur && !maxNs.compare_exchange_weak(cur, ns, relaxed)) {}
+
+    histogram[bucketFor(ns / 1000)].fetch_add(1, relaxed);
+
+    // Count last so a snapshot never sees more callbacks than durations
+    callbacks.fetch_add(1, std::memory_order_release);
+}
+
+void StreamStats::setCpuLoad(double load)
+{
+    cpuLoad.store(load, std::memory_order_relaxed);
+}
+
+StreamStats::Snapshot StreamStats::snapshot() const
+{
+    const auto relaxed = std::memory_order_relaxed;
+    Snapshot s;
+
+    s.callbacks = callbacks.load(std::memory_order_acquire);
+    s.inputOverflows = inputOverflows.load(relaxed);
+    s.inputUnderflows = inputUnderflows.load(relaxed);
+    s.outputOverflows = outputOverflows.load(relaxed);
+    s.outputUnderflows = outputUnderflows.load(relaxed);
+    s.primingOutput = primingOutput.load(relaxed);
+    s.cpuLoad = cpuLoad.load(relaxed);
+    s.budgetUs = sampleRate > 0 ? lastFrames.load(relaxed) * 1e6 / sampleRate : 0.0;
+
+    if (s.callbacks == 0)
+        return s;
+
+    s.minUs = minNs.load(relaxed) / 1000.0;
+    s.maxUs = maxNs.load(relaxed) / 1000.0;
+    s.avgUs = totalNs.load(relaxed) / 1000.0 / s.callbacks;
+
+    // p99 from the histogram; counts may trail `callbacks` by a few
+    uint64_t total = 0;
+    for (const auto& b : histogram) total += b.load(relaxed);
+    uint64_t rank = total - total / 100;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram[i].load(relaxed);
+        if (seen >= rank) {
+            s.p99Us = bucketValue(i);
+            break;
+        }
+    }
+    if (s.p99Us > s.maxUs) s.p99Us = s.maxUs;
+
+    return s;
+}
+
+int StreamStats::bucketFor(uint64_t us)
+{
+    if (us < 32)
+        return (int)us;
+
+    int msb = 5;
+    while ((us >> (msb + 1)) != 0) msb++;
+    int sub = (int)((us >> (msb - 4)) & 15);
+    int bucket = 32 + (msb - 5) * 16 + sub;
+    return bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1;
+}
+
+// Upper edge of a bucket, so percentiles err on the pessimistic side
+double StreamStats::bucketValue(int bucket)
+{
+    if (bucket < 32)
+        return bucket + 1.0;
+
+    int msb = 5 + (bucket - 32) / 16;
+    int sub = (bucket - 32) % 16;
+    return (double)((16 + sub + 1) * (1ull << (msb - 4)));
+}
+
+std::string StreamStats::toJson(const Snapshot& s)
+{
+    char buf[512];
+    std::snprintf(buf, sizeof(buf),
+        "{\"callbacks\": %llu, \"input_overflows\": %llu, \"input_underflows\": %llu, "
+        "\"output_overflows\": %llu, \"output_underflows\": %llu, \"priming_output\": %llu, "
+        "\"callback_us\": {\"min\": %.3f, \"avg\": %.3f, \"max\": %.3f, \"p99\": %.3f}, "
+        "\"budget_us\": %.3f, \"cpu_load\": %.4f}",
+        (unsigned long long)s.callbacks,
+        (unsigned long long)s.inputOverflows,
+        (unsigned long long)s.inputUnderflows,
+        (unsigned long long)s.outputOverflows,
+        (unsigned long long)s.outputUnderflows,
+        (unsigned long long)s.primingOutput,
+        s.minUs, s.avgUs, s.maxUs, s.p99Us,
+        s.budgetUs, s.cpuLoad);
+    return buf;
+}
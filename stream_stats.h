@@ -0,0 +1,69 @@
+#pragma once
+#include "portaudio.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * Real-time health counters for one PortAudio stream.
+ *
+ * record() is called at the end of every callback. It only does relaxed
+ * atomic increments and compare-exchange loops, so it is lock-free and
+ * never allocates. The UI thread reads the counters through snapshot().
+ */
+class StreamStats {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Snapshot {
+        uint64_t callbacks = 0;
+        uint64_t inputOverflows = 0;
+        uint64_t inputUnderflows = 0;
+        uint64_t outputOverflows = 0;
+        uint64_t outputUnderflows = 0;
+        uint64_t primingOutput = 0;
+        double minUs = 0.0;
+        double avgUs = 0.0;
+        double maxUs = 0.0;
+        double p99Us = 0.0;
+        double budgetUs = 0.0;  // length of the last buffer in real time
+        double cpuLoad = 0.0;   // Pa_GetStreamCpuLoad, 0..1
+    };
+
+    StreamStats();
+
+    // Clear all counters. Call from the UI thread before the stream starts.
+    void reset(double sampleRate);
+
+    // Audio thread: account for one callback
+    void record(PaStreamCallbackFlags statusFlags, unsigned long frames, Clock::duration elapsed);
+
+    // UI thread: Pa_GetStreamCpuLoad must not be called from the callback
+    void setCpuLoad(double load);
+
+    Snapshot snapshot() const;
+
+    static std::string toJson(const Snapshot& s);
+
+private:
+    // Log-linear histogram of callback durations in microseconds:
+    // exact below 32 us, then 16 buckets per power of two.
+    static const int HISTOGRAM_BUCKETS = 512;
+    static int bucketFor(uint64_t us);
+    static double bucketValue(int bucket);
+
+    std::atomic<uint64_t> callbacks;
+    std::atomic<uint64_t> inputOverflows;
+    std::atomic<uint64_t> inputUnderflows;
+    std::atomic<uint64_t> outputOverflows;
+    std::atomic<uint64_t> outputUnderflows;
+    std::atomic<uint64_t> primingOutput;
+    std::atomic<uint64_t> totalNs;
+    std::atomic<uint64_t> minNs;
+    std::atomic<uint64_t> maxNs;
+    std::atomic<unsigned long> lastFrames;
+    std::atomic<double> cpuLoad;
+    double sampleRate;
+    std::atomic<uint32_t> histogram[HISTOGRAM_BUCKETS];
+};
@@ -0,0 +1,372 @@
+#include "stretch.h"
+#include "sample_kernels.h"
+#include "thread_pool.h"
+#include <rubberband/RubberBandStretcher.h>
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+using RubberBand::RubberBandStretcher;
+
+static RubberBandStretcher::Options presetOptions(StretchPreset preset)
+{
+    switch (preset) {
+    case StretchPreset::Percussive:
+        return RubberBandStretcher::OptionWindowShort | RubberBandStretcher::OptionPhaseIndependent;
+    case StretchPreset::Smooth:
+        return RubberBandStretcher::OptionWindowLong | RubberBandStretcher::OptionTransientsSmooth;
+    case StretchPreset::Finer:
+        return RubberBandStretcher::OptionEngineFiner;
+    case StretchPreset::Default:
+    default:
+        return 0;
+    }
+}
+
+bool parseStretchPreset(const std::string& name, StretchPreset& preset)
+{
+    for (StretchPreset p : { StretchPreset::Default, StretchPreset::Percussive,
+                             StretchPreset::Smooth, StretchPreset::Finer }) {
+        if (name == stretchPresetName(p)) {
+            preset = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* stretchPresetName(StretchPreset preset)
+{
+    switch (preset) {
+    case StretchPreset::Percussive: return "percussive";
+    case StretchPreset::Smooth:     return "smooth";
+    case StretchPreset::Finer:      return "finer";
+    case StretchPreset::Default:
+    default:                        return "default";
+    }
+}
+
+namespace {
+    // Offline renders go through the stretcher in blocks of this many
+    // frames, so scratch is a few hundred KB whatever the take length
+    const size_t RENDER_BLOCK = 16384;
+
+    // Per thread, so concurrent CLI jobs each keep their own
+    thread_local ScratchArena renderScratch;
+}
+
+static std::unique_ptr<RubberBandStretcher> offlineStretcher(size_t frames, int channels, int sampleRate,
+    const StretchParams& params)
+{
+    auto stretcher = std::make_unique<RubberBandStretcher>(
+        sampleRate,
+        channels,
+        RubberBandStretcher::OptionProcessOffline | presetOptions(params.preset),
+        params.ratio,
+        std::pow(2.0, params.pitchSemitones / 12.0)
+    );
+    stretcher->setExpectedInputDuration(frames);
+    return stretcher;
+}
+
+// Output goes straight into `out`. Reserving the expected length up front
+// means a reused `out` is not reallocated, and a fresh one only once,
+// instead of doubling while the planar output grows.
+static void reserveOutput(size_t frames, int channels, const StretchParams& params, std::vector<float>& out)
+{
+    out.clear();
+    out.reserve((size_t)(frames * params.ratio + RENDER_BLOCK) * channels);
+}
+
+// Append what the stretcher has ready to `out`, `total` frames so far,
+// through `planar` (RENDER_BLOCK frames per channel)
+static void retrieveAvailable(RubberBandStretcher& stretcher, float* const* planar, int channels,
+    std::vector<float>& out, size_t& total)
+{
+    int available;
+    while ((available = stretcher.available()) > 0)
+    {
+        size_t got = stretcher.retrieve(planar, std::min<size_t>(available, RENDER_BLOCK));
+        out.resize((total + got) * channels);
+        interleave(planar, 0, out.data() + total * channels, got, channels);
+        total += got;
+    }
+}
+
+// Shared by both renderStretched overloads. loadBlock(from, n, ptrs) points
+// ptrs[c] at n frames of channel c starting at `from`, using `planar`
+// (RENDER_BLOCK frames per channel) if it has to copy.
+template <class LoadBlock>
+static size_t renderBlocks(size_t frames, int channels, int sampleRate,
+    const StretchParams& params, std::vector<float>& out, ScratchArena* scratch, LoadBlock loadBlock)
+{
+    std::unique_ptr<RubberBandStretcher> stretcher = offlineStretcher(frames, channels, sampleRate, params);
+
+    ScratchArena& arena = scratch ? *scratch : renderScratch;
+    arena.reset();
+    arena.reserve(ScratchArena::ALIGN * (2 + channels) + sizeof(float) * RENDER_BLOCK * channels);
+    float** planar = arena.alloc<float*>(channels);
+    const float** in = arena.alloc<const float*>(channels);
+    for (int c = 0; c < channels; c++) {
+        planar[c] = arena.alloc<float>(RENDER_BLOCK);
+    }
+
+    // One study pass over everything, block by block
+    size_t from = 0;
+    do {
+        size_t n = std::min(RENDER_BLOCK, frames - from);
+        loadBlock(from, n, planar, in);
+        from += n;
+        stretcher->study(in, n, from >= frames);
+    } while (from < frames);
+
+    reserveOutput(frames, channels, params, out);
+    size_t total = 0;
+
+    // Then the process pass, retrieving as output becomes available
+    from = 0;
+    do {
+        size_t n = std::min(RENDER_BLOCK, frames - from);
+        loadBlock(from, n, planar, in);
+        from += n;
+        stretcher->process(in, n, from >= frames);
+        retrieveAvailable(*stretcher, planar, channels, out, total);
+    } while (from < frames);
+    retrieveAvailable(*stretcher, planar, channels, out, total);
+
+    return total;
+}
+
+size_t renderStretched(const float* interleaved, size_t frames, int channels, int sampleRate,
+    const StretchParams& params, std::vector<float>& out, ScratchArena* scratch)
+{
+    return renderBlocks(frames, channels, sampleRate, params, out, scratch,
+        [&](size_t from, size_t n, float** planar, const float** in) {
+            deinterleave(interleaved + from * channels, planar, 0, n, channels);
+            for (int c = 0; c < channels; c++) in[c] = planar[c];
+        });
+}
+
+size_t renderStretched(const float* const* planar, size_t frames, int channels, int sampleRate,
+    const StretchParams& params, std::vector<float>& out, ScratchArena* scratch)
+{
+    return renderBlocks(frames, channels, sampleRate, params, out, scratch,
+        [&](size_t from, size_t, float**, const float** in) {
+            for (int c = 0; c < channels; c++) in[c] = planar[c] + from;
+        });
+}
+
+StretchBatch::StretchBatch(const float* interleaved, size_t frames, int channels, int sampleRate)
+    : read([interleaved, channels](size_t from, size_t n, float* const* planar) {
+        deinterleave(interleaved + from * channels, planar, 0, n, channels);
+    }),
+    numFrames(frames),
+    numChannels(channels),
+    rate(sampleRate) {
+}
+
+StretchBatch::StretchBatch(const float* const* planar, size_t frames, int channels, int sampleRate)
+    : ptrs(planar, planar + channels),
+    numFrames(frames),
+    numChannels(channels),
+    rate(sampleRate) {
+}
+
+StretchBatch::StretchBatch(ReadFn read, size_t frames, int channels, int sampleRate)
+    : read(std::move(read)),
+    numFrames(frames),
+    numChannels(channels),
+    rate(sampleRate) {
+}
+
+bool StretchBatch::feedAll(ThreadPool& pool, size_t count, const FeedFn& feed,
+    const std::atomic<bool>* cancelled) const
+{
+    std::vector<float> buffer(read ? RENDER_BLOCK * numChannels : 0);
+    std::vector<float*> planar(numChannels);
+    std::vector<const float*> in(numChannels);
+    for (int c = 0; c < numChannels; c++)
+        planar[c] = buffer.data() + c * RENDER_BLOCK;
+
+    // One job per render and block, all waited for before the next block
+    std::vector<std::future<void>> jobs;
+    size_t from = 0;
+    do {
+        if (cancelled && cancelled->load())
+            return false;
+        const size_t n = std::min(RENDER_BLOCK, numFrames - from);
+        if (read)
+            read(from, n, planar.data());
+        for (int c = 0; c < numChannels; c++)
+            in[c] = read ? planar[c] : ptrs[c] + from;
+        from += n;
+
+        const bool final = from >= numFrames;
+        jobs.clear();
+        for (size_t i = 0; i < count; i++)
+            jobs.push_back(pool.submit([&feed, &in, i, n, final]() { feed(i, in.data(), n, final); }));
+        for (auto& job : jobs)
+            job.get();
+    } while (from < numFrames);
+    return true;
+}
+
+std::vector<size_t> StretchBatch::renderAll(ThreadPool& pool, const StretchParams& params,
+    const std::vector<double>& ratios, std::vector<std::vector<float>>& outs) const
+{
+    // A stretcher per ratio, and a block of planar output each to retrieve into
+    struct Render {
+        std::unique_ptr<RubberBandStretcher> stretcher;
+        std::vector<float> block;
+        std::vector<float*> planar;
+        size_t frames = 0;
+    };
+    std::vector<Render> renders(ratios.size());
+    outs.resize(ratios.size());
+    for (size_t i = 0; i < ratios.size(); i++) {
+        StretchParams p = params;
+        p.ratio = ratios[i];
+        Render& r = renders[i];
+        r.stretcher = offlineStretcher(numFrames, numChannels, rate, p);
+        r.block.resize(RENDER_BLOCK * numChannels);
+        for (int c = 0; c < numChannels; c++)
+            r.planar.push_back(r.block.data() + c * RENDER_BLOCK);
+        reserveOutput(numFrames, numChannels, p, outs[i]);
+    }
+
+    // The study pass, then the process pass, retrieving as output becomes
+    // available, as in renderStretched()
+    feedAll(pool, renders.size(), [&](size_t i, const float* const* in, size_t n, bool final) {
+        renders[i].stretcher->study(in, n, final);
+    });
+    feedAll(pool, renders.size(), [&](size_t i, const float* const* in, size_t n, bool final) {
+        Render& r = renders[i];
+        r.stretcher->process(in, n, final);
+        retrieveAvailable(*r.stretcher, r.planar.data(), numChannels, outs[i], r.frames);
+        if (final)
+            retrieveAvailable(*r.stretcher, r.planar.data(), numChannels, outs[i], r.frames);
+    });
+
+    std::vector<size_t> frames;
+    for (auto& r : renders)
+        frames.push_back(r.frames);
+    return frames;
+}
+
+StreamingStretcher::StreamingStretcher(int channels, unsigned long maxBlockFrames, double ratio)
+    : channels(channels),
+    maxBlock(maxBlockFrames),
+    timeRatio(ratio),
+    delayToDrop(0),
+    sourceDone(false),
+    planarIn(nullptr),
+    planarOut(nullptr)
+{
+    // Threading off: process() runs inline on the audio thread
+    stretcher = std::make_unique<RubberBandStretcher>(
+        SAMPLE_RATE,
+        channels,
+        RubberBandStretcher::OptionProcessRealTime |
+        RubberBandStretcher::OptionThreadingNever,
+        ratio
+    );
+    stretcher->setMaxProcessSize(maxBlock);
+
+    // All block buffers in one aligned allocation
+    scratch.reserve(ScratchArena::ALIGN * (2 + 2 * channels) +
+        sizeof(SAMPLE) * maxBlock * channels * 2);
+    planarIn = scratch.alloc<float*>(channels);
+    planarOut = scratch.alloc<float*>(channels);
+    for (int c = 0; c < channels; c++) {
+        planarIn[c] = scratch.alloc<float>(maxBlock);
+        planarOut[c] = scratch.alloc<float>(maxBlock);
+    }
+
+    reset(ratio);
+}
+
+StreamingStretcher::~StreamingStretcher() = default;
+
+void StreamingStretcher::reset(double ratio)
+{
+    stretcher->reset();
+    stretcher->setTimeRatio(ratio);
+    timeRatio = ratio;
+    sourceDone = false;
+
+    // Feed the preferred start pad as silence, then throw away the start
+    // delay on the output side so output frame 0 == source frame 0.
+    for (int c = 0; c < channels; c++) {
+        std::fill(planarIn[c], planarIn[c] + maxBlock, 0.0f);
+    }
+    size_t pad = stretcher->getPreferredStartPad();
+    while (pad > 0) {
+        size_t n = std::min<size_t>(pad, maxBlock);
+        stretcher->process(planarIn, n, false);
+        pad -= n;
+    }
+    delayToDrop = stretcher->getStartDelay();
+}
+
+// One retrieve() of at most maxBlock ready frames, minus the start delay
+unsigned long StreamingStretcher::retrieveSome(SAMPLE* out, unsigned long frames, size_t avail)
+{
+    size_t want = std::min<size_t>({ avail, maxBlock, delayToDrop + frames });
+
+    size_t got = stretcher->retrieve(planarOut, want);
+    size_t skip = std::min(delayToDrop, got);
+    delayToDrop -= skip;
+
+    interleave(planarOut, skip, out, got - skip, channels);
+    return (unsigned long)(got - skip);
+}
+
+void StreamingStretcher::process(const SAMPLE* const* in, unsigned long frames, bool final)
+{
+    frames = std::min(frames, maxBlock);
+    for (int c = 0; c < channels && frames > 0; c++)
+        std::copy(in[c], in[c] + frames, planarIn[c]);
+    stretcher->process(planarIn, frames, final);
+    sourceDone = final;
+}
+
+unsigned long StreamingStretcher::drain(SAMPLE* out, unsigned long frames)
+{
+    unsigned long written = 0;
+    while (written < frames)
+    {
+        int avail = stretcher->available();
+        if (avail <= 0) break;
+        written += retrieveSome(out + written * channels, frames - written, avail);
+    }
+    return written;
+}
+
+unsigned long StreamingStretcher::render(SAMPLE* out, unsigned long frames, SourcePullFn pull, void* ctx)
+{
+    unsigned long written = 0;
+
+    while (written < frames)
+    {
+        int avail = stretcher->available();
+        if (avail < 0) break;  // final block processed and fully drained
+
+        if (avail > 0)
+        {
+            written += retrieveSome(out + written * channels, frames - written, avail);
+            continue;
+        }
+
+        if (sourceDone) break;
+
+        size_t need = stretcher->getSamplesRequired();
+        need = std::min<size_t>(std::max<size_t>(need, 1), maxBlock);
+
+        unsigned long got = pull(ctx, planarIn, (unsigned long)need);
+
+        sourceDone = got < need;
+        stretcher->process(planarIn, got, sourceDone);
+    }
+
+    return written;
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include "scratch_arena.h"
+#include "utils.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace RubberBand { class RubberBandStretcher; }
+class ThreadPool;
+
+enum class StretchPreset {
+    Default,     // RubberBand defaults (R2 engine)
+    Percussive,  // short window, independent phase: keeps drum hits tight
+    Smooth,      // long window, smooth transients: sustained material
+    Finer,       // R3 engine: best quality, most CPU
+};
+
+bool parseStretchPreset(const std::string& name, StretchPreset& preset);
+const char* stretchPresetName(StretchPreset preset);
+
+struct StretchParams {
+    double ratio = 1.0;            // output length / input length
+    double pitchSemitones = 0.0;
+    StretchPreset preset = StretchPreset::Default;
+};
+
+/**
+ * Offline (study + process) stretch of a whole interleaved buffer.
+ * This is the highest quality path; it is what the CLI uses.
+ * Returns the number of frames written to `out` (resized to fit).
+ *
+ * The input is fed through in fixed-size blocks, and the output is
+ * interleaved straight into `out`. Peak memory is therefore the input plus
+ * the output. Block scratch comes from `scratch`, or from a per-thread
+ * arena if null. When the same `out` vector is passed again, repeated
+ * renders make no large allocations.
+ */
+size_t renderStretched(const float* interleaved, size_t frames, int channels, int sampleRate,
+    const StretchParams& params, std::vector<float>& out, ScratchArena* scratch = nullptr);
+
+// Same for planar input (planar[c][f], e.g. AudioData::recorded), which is
+// handed to the stretcher in place without any copy
+size_t renderStretched(const float* const* planar, size_t frames, int channels, int sampleRate,
+    const StretchParams& params, std::vector<float>& out, ScratchArena* scratch = nullptr);
+
+/**
+ * One source rendered at several ratios. feedAll() reads the source a
+ * block at a time, once for all the renders, and hands each block to every
+ * render in parallel on a pool before it reads the next, so the input held
+ * is one block whatever the source: planar memory is used in place,
+ * interleaved memory is deinterleaved a block at a time, and anything else
+ * (a TakeStore) is read through a ReadFn.
+ *
+ * renderAll() is the offline stretch on top of it, for soundcard_stretch;
+ * RenderCache feeds its TakeRenders with it. RubberBand keeps its study()
+ * analysis inside each stretcher, so the offline renders read the source
+ * twice, once per pass.
+ */
+class StretchBatch {
+public:
+    // Fills planar[c] with `frames` frames of channel c from source frame `from`
+    typedef std::function<void(size_t from, size_t frames, float* const* planar)> ReadFn;
+
+    // Hands render `index` its next block; `final` is set on the last one
+    typedef std::function<void(size_t index, const float* const* planar, size_t frames, bool final)> FeedFn;
+
+    // The source memory must outlive the batch
+    StretchBatch(const float* interleaved, size_t frames, int channels, int sampleRate);
+    StretchBatch(const float* const* planar, size_t frames, int channels, int sampleRate);
+
+    // `read` is called on the thread that runs feedAll()
+    StretchBatch(ReadFn read, size_t frames, int channels, int sampleRate);
+
+    size_t frames() const { return numFrames; }
+    int channels() const { return numChannels; }
+    int sampleRate() const { return rate; }
+
+    /**
+     * Every block of the source to feed(i, ...) for each i below `count`,
+     * in parallel on `pool`. Returns false, without the final block, if
+     * `cancelled` is set on the way. Blocks until done, so call it from
+     * outside the pool.
+     */
+    bool feedAll(ThreadPool& pool, size_t count, const FeedFn& feed,
+        const std::atomic<bool>* cancelled = nullptr) const;
+
+    /**
+     * `params` at each of `ratios`, as renderStretched() would render them;
+     * outs[i] gets ratios[i] and the result holds its frame count.
+     */
+    std::vector<size_t> renderAll(ThreadPool& pool, const StretchParams& params,
+        const std::vector<double>& ratios, std::vector<std::vector<float>>& outs) const;
+
+private:
+    ReadFn read;                     // empty when the source is planar memory
+    std::vector<const float*> ptrs;  // that memory
+    size_t numFrames;
+    int numChannels;
+    int rate;
+};
+
+/* Pulls up to `frames` source frames into the channel arrays out[c] and
+** returns how many were written. Returning fewer than requested means the
+** source is done. Called from the audio callback, so it must not allocate
+** or block.
+*/
+typedef unsigned long (*SourcePullFn)(void* ctx, SAMPLE* const* out, unsigned long frames);
+
+/**
+ * Real-time RubberBand wrapper driven from playCallback.
+ * All buffers are allocated in the constructor, so reset() and render()
+ * can be called from the audio thread.
+ */
+class StreamingStretcher {
+public:
+    StreamingStretcher(int channels, unsigned long maxBlockFrames, double ratio);
+    ~StreamingStretcher();
+
+    /**
+     * Drop everything buffered and prime with the start pad, so the first
+     * rendered frame lines up with the next frame pulled from the source.
+     * Used on play start and on seek instead of re-rendering the take.
+     */
+    void reset(double ratio);
+
+    double ratio() const { return timeRatio; }
+
+    /**
+     * Fill `out` with up to `frames` interleaved frames, pulling source
+     * frames as the stretcher asks for them. Returns the number of frames
+     * written; fewer than `frames` means the source ran out and the tail
+     * has been flushed.
+     */
+    unsigned long render(SAMPLE* out, unsigned long frames, SourcePullFn pull, void* ctx);
+
+    /**
+     * Push-style use, for a source that is still growing (TakeRender):
+     * process() up to maxBlockFrames source frames at a time, with
+     * `final` on the last call, and drain() the output in between.
+     * drain() returns the interleaved frames written, up to `frames`.
+     */
+    void process(const SAMPLE* const* in, unsigned long frames, bool final);
+    unsigned long drain(SAMPLE* out, unsigned long frames);
+
+private:
+    unsigned long retrieveSome(SAMPLE* out, unsigned long frames, size_t avail);
+
+    std::unique_ptr<RubberBand::RubberBandStretcher> stretcher;
+    int channels;
+    unsigned long maxBlock;
+    double timeRatio;
+    size_t delayToDrop;  // output frames still to discard after reset()
+    bool sourceDone;
+
+    ScratchArena scratch;      // owns the buffers below
+    float** planarIn;          // channels x maxBlock
+    float** planarOut;
+};
@@ -0,0 +1,369 @@
+// Headless batch time-stretcher: renders WAV files at one or more ratios
+// using the same offline stretch as the GUI, in parallel on a thread pool.
+// With --engine the file is instead captured and played through the app's
+// own callbacks on file devices, which exercises the real-time pipeline.
+#include "audio_device.h"
+#include "audio_recorder.h"
+#include "playback.h"
+#include "sample_kernels.h"
+#include "silence_detector.h"
+#include "stretch.h"
+#include "thread_pool.h"
+#include "wav_file.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+void printUsage(const char* argv0)
+{
+    std::cerr <<
+        "usage: " << argv0 << " [options] input.wav [input.wav ...]\n"
+        "\n"
+        "  -r, --ratio R[,R...]   time ratio(s), output length / input length (default 1.0)\n"
+        "  -s, --speed S[,S...]   playback speed(s), same as the GUI slider (ratio = 1/speed)\n"
+        "  -p, --pitch SEMITONES  pitch shift in semitones (default 0)\n"
+        "      --preset NAME      default | percussive | smooth | finer\n"
+        "  -o, --outdir DIR       output directory (default: next to each input)\n"
+        "  -j, --jobs N           worker threads (default: one per core)\n"
+        "      --pcm16            write 16-bit PCM instead of 32-bit float\n"
+        "      --engine           run through recordCallback/playCallback on file devices\n"
+        "                         (streaming stretch, 44.1 kHz input, --pitch/--preset ignored)\n"
+        "      --storage FORMAT   with --engine: keep the take as float32 | int16 | float16\n"
+        "      --trim-silence     drop leading and trailing silence before stretching\n"
+        "\n"
+        "Outputs are named <input>_r<ratio>.wav.\n";
+}
+
+bool parseList(const std::string& arg, std::vector<double>& values)
+{
+    std::stringstream ss(arg);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        char* end = nullptr;
+        double v = std::strtod(item.c_str(), &end);
+        if (end == item.c_str() || *end != '\0' || v <= 0.0) return false;
+        values.push_back(v);
+    }
+    return !values.empty();
+}
+
+// A whole argument as a finite number, nothing after it
+bool parseNumber(const char* arg, double& value)
+{
+    char* end = nullptr;
+    value = std::strtod(arg, &end);
+    return end != arg && *end == '\0' && std::isfinite(value);
+}
+
+// Worker count, 1 up to MAX_JOBS
+const long MAX_JOBS = 1024;
+bool parseJobs(const char* arg, unsigned& jobs)
+{
+    char* end = nullptr;
+    long v = std::strtol(arg, &end, 10);
+    if (end == arg || *end != '\0' || v < 1 || v > MAX_JOBS) return false;
+    jobs = (unsigned)v;
+    return true;
+}
+
+struct Job {
+    fs::path input;
+    fs::path output;
+    StretchParams params;
+};
+
+// Capture `input` with recordCallback from a file device, then play the take
+// back with playCallback into a file device, exactly as the GUI would. Both
+// devices move whole blocks, so the take and the output would end on
+// silence padding: the take counts only the file's frames, and the output
+// device keeps the take stretched by the ratio.
+bool renderThroughEngine(const Job& job, SampleStorage storage, bool trim, std::string& error)
+{
+    AudioData data(storage);
+    AudioRecorder recorder(&data);
+    recorder.setDeviceSpec("file+fast:" + job.input.string());
+    SilenceSettings silence = defaultSilenceSettings();
+    silence.trim = trim;
+    silence.skipGaps = false;
+    recorder.setSilenceSettings(silence);
+    recorder.setRenderRatio(job.params.ratio);
+
+    PaError err = recorder.start();
+    if (err != paNoError) {
+        error = job.input.string() + ": capture failed: " + Pa_GetErrorText(err);
+        return false;
+    }
+    while (recorder.isActive() == 1)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    const FileDevice* source = dynamic_cast<const FileDevice*>(recorder.getDevice());
+    const long sourceFrames = source ? (long)source->sourceFrames() : 0;
+    err = recorder.stop();
+    if (err != paNoError) {
+        error = job.input.string() + ": capture failed: " + Pa_GetErrorText(err);
+        return false;
+    }
+
+    if (data.captureSampleRate != SAMPLE_RATE) {
+        error = job.input.string() + ": --engine needs " + std::to_string(SAMPLE_RATE) + " Hz input";
+        return false;
+    }
+
+    const long takeFrames = std::min<long>(data.totalSamplesRecorded, sourceFrames) - data.takeStart;
+    auto out = std::make_unique<FileDevice>(job.output.string(), false);
+    out->setMaxFrames((size_t)std::llround(std::max(0L, takeFrames) * job.params.ratio));
+    err = startPlayback(*out, &data, job.params.ratio);
+    if (err != paNoError) {
+        error = job.output.string() + ": playback failed: " + Pa_GetErrorText(err);
+        return false;
+    }
+    while (out->isActive() == 1)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    err = out->close();
+    if (err != paNoError) {
+        error = job.output.string() + ": write failed";
+        return false;
+    }
+    return true;
+}
+
+// Cut `wav` down to its first to last sound, as the recorder does at the
+// end of a take
+void trimSilence(WavData& wav)
+{
+    const size_t BLOCK = 4096;
+    std::vector<std::vector<SAMPLE>> planar(wav.channels, std::vector<SAMPLE>(BLOCK));
+    std::vector<SAMPLE*> channels;
+    for (auto& c : planar) channels.push_back(c.data());
+
+    SilenceDetector detector(wav.sampleRate, defaultSilenceSettings());
+    for (size_t f = 0; f < wav.frames(); f += BLOCK) {
+        size_t n = std::min(BLOCK, wav.frames() - f);
+        deinterleave(wav.samples.data() + f * wav.channels, channels.data(), 0, n, wav.channels);
+        detector.process(channels.data(), wav.channels, (long)n);
+    }
+
+    SilentRegion keep = detector.soundBounds();
+    wav.samples.erase(wav.samples.begin() + keep.end * wav.channels, wav.samples.end());
+    wav.samples.erase(wav.samples.begin(), wav.samples.begin() + keep.start * wav.channels);
+}
+
+// Render `count` jobs of one input, which differ only in ratio: the input
+// is read and trimmed once, and a StretchBatch feeds it to all the ratios in
+// parallel on `pool`. Returns the number of jobs that failed.
+int renderInput(ThreadPool& pool, const Job* jobs, size_t count, bool trim, WavSampleFormat outFormat,
+    std::mutex& logMutex)
+{
+    auto start = std::chrono::steady_clock::now();
+    std::string error;
+    WavData in;
+    if (!readWav(jobs[0].input.string(), in, error)) {
+        std::lock_guard<std::mutex> lock(logMutex);
+        std::cerr << "error: " << error << "\n";
+        return (int)count;
+    }
+    if (trim)
+        trimSilence(in);
+
+    std::vector<double> ratios;
+    for (size_t i = 0; i < count; i++)
+        ratios.push_back(jobs[i].params.ratio);
+    StretchBatch batch(in.samples.data(), in.frames(), in.channels, in.sampleRate);
+    std::vector<std::vector<float>> outs;
+    batch.renderAll(pool, jobs[0].params, ratios, outs);
+
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double audio = in.sampleRate > 0 ? (double)in.frames() / in.sampleRate : 0.0;
+    int failed = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        WavData out;
+        out.sampleRate = in.sampleRate;
+        out.channels = in.channels;
+        out.samples.swap(outs[i]);
+        bool ok = writeWav(jobs[i].output.string(), out, outFormat, error);
+
+        std::lock_guard<std::mutex> lock(logMutex);
+        if (ok)
+            std::cout << jobs[i].output.string() << "  (" << audio << " s audio, " << count << (count == 1 ? " ratio" : " ratios") << " in "
+                << secs << " s, " << (secs > 0 ? audio * count / secs : 0.0) << "x real time)\n";
+        else {
+            std::cerr << "error: " << error << "\n";
+            failed++;
+        }
+    }
+    return failed;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<double> ratios;
+    StretchParams base;
+    fs::path outdir;
+    unsigned jobsArg = 0;
+    WavSampleFormat outFormat = WavSampleFormat::Float32;
+    bool engine = false;
+    bool trim = false;
+    SampleStorage storage = SampleStorage::Float32;
+    std::vector<fs::path> inputs;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string a = argv[i];
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                std::cerr << "missing value for " << a << "\n";
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+
+        if (a == "-h" || a == "--help") {
+            printUsage(argv[0]);
+            return 0;
+        }
+        else if (a == "-r" || a == "--ratio") {
+            if (!parseList(next(), ratios)) { std::cerr << "bad ratio list\n"; return 2; }
+        }
+        else if (a == "-s" || a == "--speed") {
+            std::vector<double> speeds;
+            if (!parseList(next(), speeds)) { std::cerr << "bad speed list\n"; return 2; }
+            for (double s : speeds) ratios.push_back(1.0 / s);
+        }
+        else if (a == "-p" || a == "--pitch") {
+            if (!parseNumber(next(), base.pitchSemitones)) { std::cerr << "bad pitch\n"; return 2; }
+        }
+        else if (a == "--preset") {
+            if (!parseStretchPreset(next(), base.preset)) { std::cerr << "unknown preset\n"; return 2; }
+        }
+        else if (a == "-o" || a == "--outdir") {
+            outdir = next();
+        }
+        else if (a == "-j" || a == "--jobs") {
+            if (!parseJobs(next(), jobsArg)) { std::cerr << "bad job count (1 to " << MAX_JOBS << ")\n"; return 2; }
+        }
+        else if (a == "--pcm16") {
+            outFormat = WavSampleFormat::Pcm16;
+        }
+        else if (a == "--engine") {
+            engine = true;
+        }
+        else if (a == "--trim-silence") {
+            trim = true;
+        }
+        else if (a == "--storage") {
+            if (!parseSampleStorage(next(), storage)) { std::cerr << "unknown storage format\n"; return 2; }
+        }
+        else if (!a.empty() && a[0] == '-') {
+            std::cerr << "unknown option " << a << "\n";
+            printUsage(argv[0]);
+            return 2;
+        }
+        else {
+            inputs.push_back(a);
+        }
+    }
+
+    if (inputs.empty()) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    if (ratios.empty()) ratios.push_back(1.0);
+
+    if (!outdir.empty()) {
+        std::error_code ec;
+        fs::create_directories(outdir, ec);
+        if (ec) {
+            std::cerr << "cannot create " << outdir << ": " << ec.message() << "\n";
+            return 1;
+        }
+    }
+
+    std::vector<Job> jobs;
+    for (const auto& in : inputs) {
+        for (double r : ratios) {
+            char suffix[32];
+            std::snprintf(suffix, sizeof(suffix), "_r%.3f.wav", r);
+            fs::path dir = outdir.empty() ? in.parent_path() : outdir;
+
+            Job job;
+            job.input = in;
+            job.output = dir / (in.stem().string() + suffix);
+            job.params = base;
+            job.params.ratio = r;
+            jobs.push_back(job);
+        }
+    }
+
+    ThreadPool pool(jobsArg);
+    std::mutex logMutex;
+    std::vector<std::future<bool>> results;
+    int failed = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+
+    if (engine)
+    {
+        for (const Job& job : jobs)
+        {
+            results.push_back(pool.submit([&logMutex, job, storage, trim]() {
+                auto start = std::chrono::steady_clock::now();
+                std::string error;
+                bool ok = renderThroughEngine(job, storage, trim, error);
+                double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                std::lock_guard<std::mutex> lock(logMutex);
+                if (ok)
+                    std::cout << job.output.string() << "  (engine, " << secs << " s)\n";
+                else
+                    std::cerr << "error: " << error << "\n";
+                return ok;
+            }));
+        }
+    }
+    else
+    {
+        // Every input has all the ratios. With fewer ratios than threads,
+        // several inputs render at once to keep the pool busy.
+        const size_t perInput = ratios.size();
+        const size_t together = std::max<size_t>(1, pool.size() / perInput);
+        for (size_t first = 0; first < jobs.size(); first += together * perInput)
+        {
+            std::vector<std::future<int>> inputs;
+            const size_t end = std::min(jobs.size(), first + together * perInput);
+            for (size_t j = first; j < end; j += perInput) {
+                inputs.push_back(std::async(std::launch::async, [&pool, &jobs, &logMutex, j, perInput, trim, outFormat]() {
+                    return renderInput(pool, &jobs[j], perInput, trim, outFormat, logMutex);
+                }));
+            }
+            for (auto& input : inputs)
+                failed += input.get();
+        }
+    }
+
+    for (auto& r : results) {
+        if (!r.get()) failed++;
+    }
+
+    double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << jobs.size() - failed << "/" << jobs.size() << " renders done in " << total
+        << " s on " << pool.size() << " threads\n";
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,58 @@
+#include "take_render.h"
+#include <algorithm>
+
+TakeRender::TakeRender(double ratio, long origin)
+    : timeRatio(ratio),
+    originFrame(origin),
+    stretcher(NUM_CHANNELS, FRAMES_PER_BUFFER, ratio) {
+}
+
+void TakeRender::reserve(long takeFrames)
+{
+    // Plus a block of stretcher slack and the block collect() drains into,
+    // so even a render that ends right at MAX_FRAMES never reallocates
+    long expected = std::min((long)std::ceil(takeFrames * timeRatio), MAX_FRAMES) + 2 * FRAMES_PER_BUFFER;
+    out.reserve((size_t)expected * NUM_CHANNELS);
+}
+
+void TakeRender::append(const SAMPLE* const* planar, long frames)
+{
+    if (finished || abandoned) return;
+
+    const SAMPLE* piece[NUM_CHANNELS];
+    for (long done = 0; done < frames; done += FRAMES_PER_BUFFER)
+    {
+        for (int c = 0; c < NUM_CHANNELS; c++)
+            piece[c] = planar[c] + done;
+        stretcher.process(piece, std::min<long>(FRAMES_PER_BUFFER, frames - done), false);
+        collect();
+    }
+
+    if (this->frames() > MAX_FRAMES) {
+        abandoned = true;
+        std::vector<SAMPLE>().swap(out);
+    }
+}
+
+void TakeRender::finish()
+{
+    if (finished) return;
+    if (!abandoned) {
+        stretcher.process(nullptr, 0, true);
+        collect();
+    }
+    finished = true;
+}
+
+// Move everything the stretcher has ready onto the end of `out`
+void TakeRender::collect()
+{
+    for (;;)
+    {
+        size_t at = out.size();
+        out.resize(at + FRAMES_PER_BUFFER * NUM_CHANNELS);
+        unsigned long got = stretcher.drain(out.data() + at, FRAMES_PER_BUFFER);
+        out.resize(at + got * NUM_CHANNELS);
+        if (got < FRAMES_PER_BUFFER) break;
+    }
+}
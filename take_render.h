@@ -0,0 +1,57 @@
+#pragma once
+#include "stretch.h"
+#include "utils.h"
+#include <cmath>
+#include <vector>
+
+/**
+ * The take stretched at one ratio, rendered while it is being recorded.
+ * CaptureMonitor appends every block it reads; finish() flushes the
+ * stretcher once the take is complete, so at the end of recording only
+ * the last block is left to do. Playback then copies rendered frames
+ * instead of stretching in the callback (see playCallback).
+ *
+ * It uses the same real-time stretcher as playback, so both paths sound
+ * the same. Output frame 0 lines up with take frame `origin` (0 while
+ * recording; the trimmed start for RenderCache). Once the output would
+ * pass MAX_FRAMES the render gives up, and playback stretches live as
+ * before.
+ */
+class TakeRender {
+public:
+    static const long MAX_FRAMES = 2L * NUM_SECONDS * SAMPLE_RATE;
+
+    explicit TakeRender(double ratio, long origin = 0);
+
+    // Room for the output of `takeFrames` frames, when the length is known
+    // up front (otherwise the buffer grows by doubling)
+    void reserve(long takeFrames);
+
+    // Monitor thread, until finish()
+    void append(const SAMPLE* const* planar, long frames);
+    void finish();
+
+    // Complete and usable: written once, read-only from then on
+    bool ready() const { return finished && !abandoned; }
+    double ratio() const { return timeRatio; }
+    long origin() const { return originFrame; }
+    long frames() const { return (long)(out.size() / NUM_CHANNELS); }
+    size_t bytes() const { return out.capacity() * sizeof(SAMPLE); }
+    const SAMPLE* samples() const { return out.data(); }
+
+    // Rendered frame that plays take frame `takeFrame` (0 before the origin)
+    long frameOf(double takeFrame) const
+    {
+        return takeFrame > originFrame ? (long)std::llround((takeFrame - originFrame) * timeRatio) : 0;
+    }
+
+private:
+    void collect();
+
+    double timeRatio;
+    long originFrame;
+    StreamingStretcher stretcher;
+    std::vector<SAMPLE> out;  // interleaved
+    bool finished = false;
+    bool abandoned = false;
+};
@@ -0,0 +1,442 @@
+#include "take_store.h"
+#include "lossless_codec.h"
+#include "sample_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+namespace {
+
+// How often the worker looks for chunks to pack or unpack
+const std::chrono::milliseconds WORKER_PERIOD(2);
+
+// Keep a packed copy only when it saves at least this fraction
+const size_t PACK_MIN_SAVING_DIV = 8;
+
+// Narrow one channel of planar SAMPLE into the storage format
+void narrow(SampleStorage format, const SAMPLE* in, char* out, long frames)
+{
+    if (format == SampleStorage::Int16)
+        floatToInt16(in, (int16_t*)out, frames);
+    else if (format == SampleStorage::Float16)
+        floatToHalf(in, (uint16_t*)out, frames);
+    else
+        std::memcpy(out, in, frames * sizeof(SAMPLE));
+}
+
+void widen(SampleStorage format, const char* in, SAMPLE* out, long frames)
+{
+    if (format == SampleStorage::Int16)
+        int16ToFloat((const int16_t*)in, out, frames);
+    else if (format == SampleStorage::Float16)
+        halfToFloat((const uint16_t*)in, out, frames);
+    else
+        std::memcpy(out, in, frames * sizeof(SAMPLE));
+}
+
+} // namespace
+
+TakeStore::TakeStore(SampleStorage format, long capacityFrames, bool compress, const std::atomic<long>* loopStart)
+    : format(format),
+    compress(compress),
+    capacityFrames(capacityFrames),
+    numChunks((capacityFrames + CHUNK_FRAMES - 1) / CHUNK_FRAMES),
+    chunks(new Chunk[numChunks]),
+    loopStart(loopStart) {
+
+    if (!compress)
+    {
+        // Everything up front, in one block, as before compression existed
+        block = ::operator new(numChunks * chunkBytes(), std::align_val_t(SAMPLE_ALIGN), std::nothrow);
+        if (block == NULL)
+        {
+            std::cerr << "Could not allocate record array.\n";
+            this->capacityFrames = 0;
+            return;
+        }
+        std::memset(block, 0, numChunks * chunkBytes());
+        for (long i = 0; i < numChunks; i++)
+            chunks[i].samples.store((char*)block + i * chunkBytes());
+        unpackedChunks.store(numChunks);
+        return;
+    }
+
+    beginTake();
+    worker = std::thread(&TakeStore::run, this);
+}
+
+TakeStore::~TakeStore()
+{
+    if (worker.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    if (block)
+        ::operator delete(block, std::align_val_t(SAMPLE_ALIGN));
+    else {
+        for (long i = 0; i < numChunks; i++)
+            freeChunk(chunks[i].samples.load());
+    }
+}
+
+size_t TakeStore::chunkBytes() const
+{
+    return (size_t)CHUNK_FRAMES * NUM_CHANNELS * sampleStorageBytes(format);
+}
+
+char* TakeStore::allocateChunk()
+{
+    return (char*)::operator new(chunkBytes(), std::align_val_t(SAMPLE_ALIGN), std::nothrow);
+}
+
+void TakeStore::freeChunk(char* samples)
+{
+    if (samples)
+        ::operator delete(samples, std::align_val_t(SAMPLE_ALIGN));
+}
+
+/* A reader announces itself before looking at the pointer; evict() clears
+** the pointer before waiting for the readers to leave. Either the reader
+** sees nullptr, or evict() sees the reader and waits for it.
+*/
+char* TakeStore::pin(long index) const
+{
+    const Chunk& chunk = chunks[index];
+    chunk.readers.fetch_add(1);
+    char* samples = chunk.samples.load();
+    if (!samples)
+        chunk.readers.fetch_sub(1);
+    return samples;
+}
+
+// ------------------------------------------------------------
+// Audio thread
+// ------------------------------------------------------------
+
+void TakeStore::store(const SAMPLE* interleaved, long at, long frames)
+{
+    const size_t bytes = sampleStorageBytes(format);
+    writeHead.store(at + frames);
+
+    // Split into a small planar block on the stack, then narrow each channel
+    const long PIECE = 256;
+    SAMPLE tmp[NUM_CHANNELS][PIECE];
+    SAMPLE* planar[NUM_CHANNELS];
+    for (int c = 0; c < NUM_CHANNELS; c++) planar[c] = tmp[c];
+
+    for (long done = 0; done < frames; )
+    {
+        long frame = at + done;
+        long index = frame / CHUNK_FRAMES, offset = frame % CHUNK_FRAMES;
+        long n = std::min(frames - done, CHUNK_FRAMES - offset);
+
+        char* samples = pin(index);
+        if (!samples)
+            misses.fetch_add(1);
+        else
+        {
+            for (long p = 0; p < n; p += PIECE)
+            {
+                long m = std::min(PIECE, n - p);
+                if (interleaved)
+                    deinterleave(interleaved + (done + p) * NUM_CHANNELS, planar, 0, m, NUM_CHANNELS);
+                for (int c = 0; c < NUM_CHANNELS; c++) {
+                    char* dst = samples + ((size_t)c * CHUNK_FRAMES + offset + p) * bytes;
+                    if (interleaved)
+                        narrow(format, tmp[c], dst, m);
+                    else
+                        std::memset(dst, 0, m * bytes);  // silence is all-zero bits in every format
+                }
+            }
+            unpin(index);
+        }
+        done += n;
+    }
+
+    if (at + frames > highWater.load())
+        highWater.store(at + frames);
+}
+
+void TakeStore::load(int channel, long from, long frames, SAMPLE* out) const
+{
+    const size_t bytes = sampleStorageBytes(format);
+    readHead.store(from + frames);
+
+    for (long done = 0; done < frames; )
+    {
+        long frame = from + done;
+        long index = frame / CHUNK_FRAMES, offset = frame % CHUNK_FRAMES;
+        long n = std::min(frames - done, CHUNK_FRAMES - offset);
+
+        char* samples = pin(index);
+        if (samples) {
+            widen(format, samples + ((size_t)channel * CHUNK_FRAMES + offset) * bytes, out + done, n);
+            unpin(index);
+        }
+        else {
+            std::fill_n(out + done, n, SAMPLE_SILENCE);
+            if (frame < highWater.load()) misses.fetch_add(1);
+        }
+        done += n;
+    }
+}
+
+// ------------------------------------------------------------
+// Other threads
+// ------------------------------------------------------------
+
+void TakeStore::forEachSegment(int channel, long from, long to,
+    const std::function<void(const void* samples, long first, long count)>& fn) const
+{
+    const size_t bytes = sampleStorageBytes(format);
+    std::vector<char> unpacked;
+
+    from = std::max(from, 0L);
+    to = std::min(to, capacityFrames);
+    for (long frame = from; frame < to; )
+    {
+        long index = frame / CHUNK_FRAMES, offset = frame % CHUNK_FRAMES;
+        long n = std::min(to - frame, CHUNK_FRAMES - offset);
+        const size_t at = ((size_t)channel * CHUNK_FRAMES + offset) * bytes;
+
+        char* samples = pin(index);
+        if (samples) {
+            fn(samples + at, frame, n);
+            unpin(index);
+        }
+        else {
+            // Packed (or never written): unpack a private copy
+            unpacked.assign(chunkBytes(), 0);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                decodeInto(index, unpacked.data());
+            }
+            fn(unpacked.data() + at, frame, n);
+        }
+        frame += n;
+    }
+}
+
+void TakeStore::read(int channel, long from, long frames, SAMPLE* out) const
+{
+    forEachSegment(channel, from, from + frames, [&](const void* samples, long first, long count) {
+        widen(format, (const char*)samples, out + (first - from), count);
+    });
+}
+
+void TakeStore::beginTake()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (long i = 0; i < numChunks; i++) {
+        std::vector<uint8_t>().swap(chunks[i].packed);
+        chunks[i].incompressible = false;
+    }
+    packedBytes.store(0);
+    packedChunks.store(0);
+    highWater.store(0);
+    lowWater.store(0);
+    writeHead.store(0);
+    readHead.store(-1);
+
+    // The recorder starts writing right away: make sure it has somewhere to
+    if (compress) {
+        for (long i = 0; i <= CHUNKS_AHEAD && i < numChunks; i++)
+            unpack(i);
+    }
+}
+
+void TakeStore::trim(long from, long to)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    lowWater.store(from);
+    if (to < highWater.load())
+        highWater.store(to);
+    if (!compress) return;
+
+    for (long i = 0; i < numChunks; i++) {
+        if ((i + 1) * CHUNK_FRAMES <= from || i * CHUNK_FRAMES >= to)
+            drop(i);
+    }
+}
+
+void TakeStore::prefetch(long frame)
+{
+    hint(frame);
+    if (!compress) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    long first = std::max(0L, frame / CHUNK_FRAMES - 1);
+    for (long i = first; i <= frame / CHUNK_FRAMES + CHUNKS_AHEAD && i < numChunks; i++)
+        unpack(i);
+}
+
+void TakeStore::settle()
+{
+    if (!compress) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    while (pass()) {}
+}
+
+TakeStore::Usage TakeStore::usage() const
+{
+    return { unpackedChunks.load() * chunkBytes(), packedBytes.load(), packedChunks.load(), misses.load() };
+}
+
+// ------------------------------------------------------------
+// Worker (everything below runs under mutex)
+// ------------------------------------------------------------
+
+bool TakeStore::decodeInto(long index, char* samples) const
+{
+    const Chunk& chunk = chunks[index];
+    if (chunk.packed.empty()) return false;
+
+    const size_t bytes = sampleStorageBytes(format);
+    uint32_t begin = 0;
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+        if (!decodeChannel(format, chunk.packed.data() + begin, chunk.channelEnd[c] - begin,
+                samples + (size_t)c * CHUNK_FRAMES * bytes, CHUNK_FRAMES)) {
+            std::cerr << "take chunk " << index << " failed to unpack\n";
+            return false;
+        }
+        begin = chunk.channelEnd[c];
+    }
+    return true;
+}
+
+// Make chunk `index` unpacked: decode it if packed, else fresh memory
+bool TakeStore::unpack(long index)
+{
+    Chunk& chunk = chunks[index];
+    if (chunk.samples.load()) return true;
+
+    char* samples = allocateChunk();
+    if (!samples) return false;
+    if (!decodeInto(index, samples))
+        std::memset(samples, 0, chunkBytes());
+
+    chunk.samples.store(samples);
+    unpackedChunks.fetch_add(1);
+    return true;
+}
+
+void TakeStore::pack(long index)
+{
+    Chunk& chunk = chunks[index];
+    const char* samples = chunk.samples.load();
+    const size_t bytes = sampleStorageBytes(format);
+
+    std::vector<uint8_t> packed;
+    for (int c = 0; c < NUM_CHANNELS; c++) {
+        encodeChannel(format, samples + (size_t)c * CHUNK_FRAMES * bytes, CHUNK_FRAMES, packed);
+        chunk.channelEnd[c] = (uint32_t)packed.size();
+    }
+
+    if (packed.size() > chunkBytes() - chunkBytes() / PACK_MIN_SAVING_DIV) {
+        chunk.incompressible = true;
+        return;
+    }
+    packed.shrink_to_fit();
+    packedBytes.fetch_add(packed.size());
+    packedChunks.fetch_add(1);
+    chunk.packed.swap(packed);
+}
+
+void TakeStore::evict(long index)
+{
+    Chunk& chunk = chunks[index];
+    char* samples = chunk.samples.exchange(nullptr);
+    if (!samples) return;
+
+    while (chunk.readers.load() != 0)
+        std::this_thread::yield();
+    freeChunk(samples);
+    unpackedChunks.fetch_sub(1);
+}
+
+// Forget chunk `index` entirely: packed data and samples
+void TakeStore::drop(long index)
+{
+    Chunk& chunk = chunks[index];
+    if (!chunk.packed.empty()) {
+        packedBytes.fetch_sub(chunk.packed.size());
+        packedChunks.fetch_sub(1);
+        std::vector<uint8_t>().swap(chunk.packed);
+    }
+    chunk.incompressible = false;
+    evict(index);
+}
+
+bool TakeStore::isHot(long index, long writeChunk, long readChunk, long loopChunk) const
+{
+    auto near = [index](long at, long before) {
+        return at >= 0 && index >= at - before && index <= at + CHUNKS_AHEAD;
+    };
+    return near(writeChunk, 0) || near(readChunk, 1) || near(loopChunk, 0);
+}
+
+// One round of work; true if anything was packed or freed
+bool TakeStore::pass()
+{
+    long write = writeHead.load(), read = readHead.load();
+    long loop = loopStart ? loopStart->load() : -1;
+    long writeChunk = write >= 0 ? write / CHUNK_FRAMES : -1;
+    long readChunk = read >= 0 ? std::min(read, capacityFrames - 1) / CHUNK_FRAMES : -1;
+    long loopChunk = loop >= 0 ? std::max(0L, loop - LOOP_CROSSFADE_FRAMES) / CHUNK_FRAMES : -1;
+
+    // Chunks about to be written or read must be unpacked
+    for (long i = 0; i < numChunks; i++) {
+        if (isHot(i, writeChunk, readChunk, loopChunk))
+            unpack(i);
+    }
+
+    // Then pack (or just drop) one cold chunk. store() moves writeHead past
+    // a block before writing it and highWater only after, so a block that
+    // fills a whole chunk leaves it cold and above highWater meanwhile:
+    // only what is past both is left over.
+    const long stored = highWater.load(), trimmed = lowWater.load();
+    for (long i = 0; i < numChunks; i++)
+    {
+        Chunk& chunk = chunks[i];
+        if (!chunk.samples.load() || isHot(i, writeChunk, readChunk, loopChunk))
+            continue;
+
+        if (i * CHUNK_FRAMES >= std::max(stored, write) || (i + 1) * CHUNK_FRAMES <= trimmed) {
+            drop(i);  // left over from an earlier take or trimmed, nothing to keep
+            return true;
+        }
+        if ((i + 1) * CHUNK_FRAMES > stored || chunk.incompressible)
+            continue;  // the partly written last chunk, or not worth packing
+
+        if (chunk.packed.empty())
+            pack(i);
+        if (!chunk.packed.empty())
+            evict(i);
+        return true;
+    }
+    return false;
+}
+
+void TakeStore::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping)
+    {
+        if (!pass())
+            wake.wait_for(lock, WORKER_PERIOD);
+        else {
+            // let read() / prefetch() in between packs
+            lock.unlock();
+            lock.lock();
+        }
+    }
+}
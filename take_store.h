@@ -0,0 +1,132 @@
+#pragma once
+#include "utils.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Storage behind AudioData: the take is cut into chunks of CHUNK_FRAMES
+ * frames, each holding all channels in the take's SampleStorage format.
+ *
+ * Without compression every chunk lives in one block allocated up front.
+ * With compression a worker thread keeps only the chunks around the write
+ * and read positions (and the loop start) unpacked. Full chunks outside
+ * those windows are packed with lossless_codec, and their samples are
+ * freed. Packed chunks are unpacked again before the read position gets
+ * to them.
+ *
+ * store() and load() are real-time safe: they never allocate, lock or
+ * wait. A chunk that is not unpacked in time is written nowhere, or read
+ * as silence, and counted as a miss. read() and forEachSegment() are for
+ * other threads and unpack what they need themselves.
+ */
+class TakeStore {
+public:
+    static const long CHUNK_FRAMES = 65536;  // ~1.5 s at 44.1 kHz
+    static const long CHUNKS_AHEAD = 3;      // kept unpacked past the read / write position
+
+    TakeStore(SampleStorage format, long capacityFrames, bool compress,
+        const std::atomic<long>* loopStart = nullptr);
+    ~TakeStore();
+    TakeStore(const TakeStore&) = delete;
+    TakeStore& operator=(const TakeStore&) = delete;
+
+    bool ok() const { return capacityFrames > 0; }
+    long capacity() const { return capacityFrames; }
+    bool compressing() const { return compress; }
+
+    // Audio thread. interleaved == nullptr writes silence.
+    void store(const SAMPLE* interleaved, long at, long frames);
+    void load(int channel, long from, long frames, SAMPLE* out) const;
+
+    // Any other thread: like load(), but unpacks chunks instead of missing
+    void read(int channel, long from, long frames, SAMPLE* out) const;
+
+    // Calls fn(samples, first, count) for consecutive pieces of [from, to)
+    // of one channel, in the storage format; samples[0] is frame `first`
+    void forEachSegment(int channel, long from, long to,
+        const std::function<void(const void* samples, long first, long count)>& fn) const;
+
+    // Frames stored this take so far; what is below has been written
+    long stored() const { return highWater.load(); }
+
+    // Start of a new take: drops all packed data (not real-time safe)
+    void beginTake();
+
+    // Only [from, to) of the take is wanted any more: when compressing, the
+    // chunks wholly outside it are freed, packed or not (not real-time safe)
+    void trim(long from, long to);
+
+    // The read position is about to jump to `frame` (seek, start of playback)
+    void hint(long frame) { readHead.store(frame); }
+
+    // Unpack the chunks around `frame` now, on the calling thread
+    void prefetch(long frame);
+
+    // Do the worker's pending packing on the calling thread, until every
+    // cold chunk is packed (benchmarks, tests)
+    void settle();
+
+    struct Usage {
+        size_t unpackedBytes;
+        size_t packedBytes;
+        long packedChunks;
+        long misses;
+    };
+    Usage usage() const;
+
+private:
+    struct Chunk {
+        std::atomic<char*> samples{ nullptr };  // unpacked data, all channels
+        mutable std::atomic<int> readers{ 0 };
+        std::vector<uint8_t> packed;            // under mutex
+        uint32_t channelEnd[NUM_CHANNELS] = {}; // offsets into packed
+        bool incompressible = false;            // packing did not pay off
+    };
+
+    // Pins chunk `index` for reading; nullptr (unpinned) when not unpacked
+    char* pin(long index) const;
+    void unpin(long index) const { chunks[index].readers.fetch_sub(1); }
+
+    size_t chunkBytes() const;
+    char* allocateChunk();
+    void freeChunk(char* samples);
+
+    // under mutex
+    bool unpack(long index);
+    void pack(long index);
+    void evict(long index);
+    void drop(long index);
+    bool decodeInto(long index, char* samples) const;
+
+    void run();
+    bool pass();
+    bool isHot(long index, long writeChunk, long readChunk, long loopChunk) const;
+
+    const SampleStorage format;
+    const bool compress;
+    long capacityFrames;
+    long numChunks;
+    std::unique_ptr<Chunk[]> chunks;
+    void* block = nullptr;                // the up-front block without compression
+
+    std::atomic<long> writeHead{ -1 };
+    std::atomic<long> highWater{ 0 };     // frames stored this take
+    std::atomic<long> lowWater{ 0 };      // frames before this were trimmed
+    mutable std::atomic<long> readHead{ -1 };
+    const std::atomic<long>* loopStart;
+    mutable std::atomic<long> misses{ 0 };
+    std::atomic<size_t> packedBytes{ 0 };
+    std::atomic<long> packedChunks{ 0 };
+    std::atomic<long> unpackedChunks{ 0 };
+
+    mutable std::mutex mutex;             // chunk packing / unpacking
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread worker;
+};
@@ -1,26 +1,161 @@
 #include "utils.h"
+#include "stretch.h"
+#include "level_meter.h"
+#include "render_cache.h"
+#include "spectrogram.h"
+#include "take_render.h"
+#include "take_store.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <cstring>
+#include <new>
 
 using namespace std;
 
-AudioData::AudioData()
+bool parseSampleStorage(const std::string& name, SampleStorage& storage)
+{
+    for (SampleStorage s : { SampleStorage::Float32, SampleStorage::Int16, SampleStorage::Float16 }) {
+        if (name == sampleStorageName(s)) {
+            storage = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* sampleStorageName(SampleStorage storage)
+{
+    switch (storage) {
+    case SampleStorage::Int16: return "int16";
+    case SampleStorage::Float16: return "float16";
+    default: return "float32";
+    }
+}
+
+size_t sampleStorageBytes(SampleStorage storage)
+{
+    return storage == SampleStorage::Float32 ? sizeof(SAMPLE) : sizeof(uint16_t);
+}
+
+SampleStorage defaultSampleStorage()
+{
+    SampleStorage storage = SampleStorage::Float32;
+    const char* env = std::getenv("SC_SAMPLE_STORAGE");
+    if (env && *env && !parseSampleStorage(env, storage))
+        std::cerr << "SC_SAMPLE_STORAGE: unknown format " << env << ", using float32\n";
+    return storage;
+}
+
+bool defaultCompressTake()
+{
+    const char* env = std::getenv("SC_COMPRESS_TAKE");
+    return env && std::strcmp(env, "1") == 0;
+}
+
+AudioData::AudioData(SampleStorage storage, bool compress)
     : lastSampleIndex(0),
     currentSampleIndex(0),
     totalSamplesRecorded(0),
     maxSamplesBuffer(0),
-    recorded(nullptr) {
+    sampleStorage(storage),
+    takeStart(0),
+    skipSilentGaps(false),
+    seekRequest(-1),
+    playbackRunning(false),
+    loopStart(-1),
+    loopEnd(-1),
+    captureSampleRate(SAMPLE_RATE),
+    playSourcePos(0.0),
+    playFromRender(false),
+    renderPos(0),
+    playPaused(false),
+    playSilent(false),
+    block(nullptr) {
 
-    // Alloc mem
-    maxSamplesBuffer = NUM_SECONDS * SAMPLE_RATE;
-    int numSamples = maxSamplesBuffer * NUM_CHANNELS;
-    int numBytes = numSamples * sizeof(SAMPLE);
+    // Without compression the take is allocated up front, and compact
+    // formats get NUM_SECONDS worth of float memory, i.e. a longer take.
+    // With compression only the parts near the play / record position are
+    // held unpacked, so the take can be hours long.
+    long frames = compress ? (long)COMPRESSED_NUM_SECONDS * SAMPLE_RATE
+        : (long)(NUM_SECONDS * SAMPLE_RATE * sizeof(SAMPLE) / sampleStorageBytes(sampleStorage));
+    take = std::make_unique<TakeStore>(sampleStorage, frames, compress, &loopStart);
+    renderCache = std::make_unique<RenderCache>(this);
+    spectrogram = std::make_unique<Spectrogram>(take->capacity());
+    recordLevels = std::make_unique<LevelMeter>();
+    playLevels = std::make_unique<LevelMeter>();
 
-    /* Init recorded samples buffer */
-    recorded = (SAMPLE*)std::malloc(numBytes);
-    if (recorded == NULL)
+    /* Init playback scratch */
+    block = ::operator new(PLAY_SCRATCH_FRAMES * NUM_CHANNELS * sizeof(SAMPLE), std::align_val_t(SAMPLE_ALIGN), std::nothrow);
+    if (block == NULL || !take->ok())
     {
         std::cerr << "Could not allocate record array.\n";
+        for (int c = 0; c < NUM_CHANNELS; c++) playScratch[c] = nullptr;
+        return;
     }
-    std::memset(recorded, 0, numBytes);
+    for (int c = 0; c < NUM_CHANNELS; c++)
+        playScratch[c] = (SAMPLE*)block + c * PLAY_SCRATCH_FRAMES;
+    maxSamplesBuffer = (int)take->capacity();
+}
+
+void AudioData::storeFrames(const SAMPLE* interleaved, long at, long frames)
+{
+    take->store(interleaved, at, frames);
+}
+
+void AudioData::loadFrames(int channel, long from, long frames, SAMPLE* out) const
+{
+    take->load(channel, from, frames, out);
+}
+
+bool AudioData::send(const EngineCommand& command)
+{
+    if (command.type == EngineCommandType::Seek)
+        take->hint(command.a);
+
+    if (playbackRunning)
+    {
+        if (commands.push(command))
+            return true;
+        std::cerr << "Engine command queue full, command dropped" << std::endl;
+        return false;
+    }
+
+    switch (command.type)
+    {
+    case EngineCommandType::Seek:
+        seekRequest.store(command.a);
+        break;
+    case EngineCommandType::SetLoop:
+        loopStart.store(-1);  // never a moment with the new start and the old end
+        loopEnd.store(command.b);
+        loopStart.store(command.a);
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+long AudioData::audiblePlayFrame() const {
+    double f = playClock.audibleFrame();
+    if (f < 0) return -1;
+
+    // The anchor is per block; extrapolating past a loop wrap folds back
+    long a = loopStart.load(), b = loopEnd.load();
+    if (a >= 0 && b > a && f >= b && f < b + (b - a))
+        f -= (b - a);
+
+    return std::clamp<long>((long)f, 0, totalSamplesRecorded);
+}
+
+long AudioData::audibleRecordFrame() const {
+    double f = recordClock.audibleFrame();
+    if (f < 0) return -1;
+    return std::clamp<long>((long)f, 0, maxSamplesBuffer);
+}
+
+AudioData::~AudioData() {
+    if (block)
+        ::operator delete(block, std::align_val_t(SAMPLE_ALIGN));
 }
\ No newline at end of file
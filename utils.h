@@ -1,6 +1,13 @@
 #pragma once
 #include "portaudio.h"
+#include "playhead.h"
+#include "spsc_queue.h"
+#include "stream_stats.h"
+#include <atomic>
+#include <cstddef>
 #include <memory>
+#include <string>
+#include <vector>
 
 #define RECORD_STR "Record"
 #define RECORDING_STR "Recording"
@@ -12,7 +19,15 @@
 #define SAMPLE_RATE  (44100)
 #define FRAMES_PER_BUFFER (512)
 #define NUM_SECONDS     (100)
+/* Take length when cold parts of the take are compressed (SC_COMPRESS_TAKE) */
+#define COMPRESSED_NUM_SECONDS (4 * 60 * 60)
 #define NUM_CHANNELS    (2)
+/* Length of the crossfade at the loop wrap point (~6 ms at 44.1 kHz). */
+#define LOOP_CROSSFADE_FRAMES (256)
+/* Alignment of each channel of the planar capture buffer (one cache line). */
+#define SAMPLE_ALIGN    (64)
+/* Planar scratch the direct playback path reads into before interleaving. */
+#define PLAY_SCRATCH_FRAMES (1024)
 /* #define DITHER_FLAG     (paDitherOff) */
 #define DITHER_FLAG     (0) /**/
 /** Set to 1 if you want to capture the recording to a file. */
@@ -41,14 +56,187 @@ typedef unsigned char SAMPLE;
 #define PRINTF_S_FORMAT "%d"
 #endif
 
+class RenderCache;
+class LevelMeter;
+class Spectrogram;
+class StreamingStretcher;
+class TakeRender;
+class TakeStore;
+
+/* How AudioData keeps captured samples. The devices and callbacks always
+** work in SAMPLE (float); the compact formats are converted on the way in
+** and out and fit twice the capture length into the same memory.
+**   Float32  lossless
+**   Int16    clips at full scale; noise floor ~-101 dBFS (SNR ~98 dB for a
+**            full-scale sine)
+**   Float16  no clipping (up to 65504); the error scales with the level and
+**            stays ~74 dB below the signal down to ~-84 dBFS
+** soundcard_bench --filter storage measures the actual error.
+*/
+enum class SampleStorage { Float32, Int16, Float16 };
+
+bool parseSampleStorage(const std::string& name, SampleStorage& storage);
+const char* sampleStorageName(SampleStorage storage);
+size_t sampleStorageBytes(SampleStorage storage);
+
+// From SC_SAMPLE_STORAGE ("float32", "int16", "float16"), Float32 when unset
+SampleStorage defaultSampleStorage();
+
+// From SC_COMPRESS_TAKE ("1" packs cold parts of the take, see TakeStore)
+bool defaultCompressTake();
+
+// [start, end) in frames of the take
+struct SilentRegion {
+    long start;
+    long end;
+};
+
+/* Armed recording (see AudioRecorder::setTrigger). recordCallback keeps
+** the input in the preRoll ring until a block reaches openLevel, then
+** starts the take with the ring's contents. Once the input has stayed
+** below quietLevel for tailFrames, the callback completes. Everything but
+** phase is set up before the stream starts and then belongs to the audio
+** thread.
+*/
+enum class CapturePhase { Direct, Armed, Triggered };
+
+struct CaptureTrigger {
+    std::atomic<CapturePhase> phase{ CapturePhase::Direct };
+    float openLevel = 0.0f;       // block mean square that starts the take
+    float quietLevel = 0.0f;      // blocks below this count towards the tail
+    long tailFrames = 0;          // quiet this long ends the take; 0 = never
+    std::vector<SAMPLE> preRoll;  // interleaved ring
+    long preRollPos = 0;
+    long preRollFill = 0;
+    long quietFrames = 0;
+};
+
+/* Transport commands from the UI to playCallback, which applies them at
+** the start of its next block, in the order they were sent. Send them with
+** AudioData::send().
+*/
+enum class EngineCommandType { Play, Pause, Seek, SetRatio, SetLoop };
+
+struct EngineCommand {
+    EngineCommandType type;
+    long a = -1;         // Seek: frame. SetLoop: start, -1 clears the loop
+    long b = -1;         // SetLoop: end
+    double ratio = 1.0;  // SetRatio
+};
+
+/* What playCallback did, for the UI: one event per command applied, plus
+** Finished when the take runs out. `frame` is the take position of the
+** block boundary where it happened.
+*/
+enum class EngineEventType { Resumed, Paused, Seeked, RatioChanged, LoopChanged, Finished };
+
+struct EngineEvent {
+    EngineEventType type;
+    double frame;
+};
+
 class AudioData {
 public:
     int lastSampleIndex;
     int currentSampleIndex;
     int totalSamplesRecorded;
     int maxSamplesBuffer;
-    float* recorded;
-    PaStream* stream;
 
-    AudioData();
+    // Planar capture buffer of maxSamplesBuffer frames in sampleStorage
+    // format, SAMPLE_ALIGN-aligned, in chunks that may be packed when
+    // compressing. The callbacks convert from / to the interleaved device
+    // buffers at the edges with storeFrames() / loadFrames().
+    const SampleStorage sampleStorage;
+    std::unique_ptr<TakeStore> take;
+
+    // PLAY_SCRATCH_FRAMES per channel for playCallback (audio thread only)
+    SAMPLE* playScratch[NUM_CHANNELS];
+
+    // What is left of the take after trimming silence: takeStart up to
+    // totalSamplesRecorded. silentGaps are the long gaps the capture monitor
+    // found in between (see silence_detector.h); playback jumps over them
+    // while skipSilentGaps is set. Only changed while no stream runs.
+    long takeStart;
+    std::vector<SilentRegion> silentGaps;
+    std::atomic<bool> skipSilentGaps;
+
+    CaptureTrigger trigger;
+
+    // Where the next play starts, set by a Seek sent while no playback runs
+    // and picked up by its first callback. -1 means takeStart.
+    std::atomic<long> seekRequest;
+
+    // UI -> playCallback and back (see EngineCommand). Single producer and
+    // single consumer each: only the UI thread sends and drains events.
+    SpscQueue<EngineCommand, 64> commands;
+    SpscQueue<EngineEvent, 64> events;
+    bool playbackRunning;      // a stream runs playCallback (startPlayback to closePlayback)
+
+    // Selected loop region in frames of the recorded take, -1 when unset.
+    std::atomic<long> loopStart;
+    std::atomic<long> loopEnd;
+
+    // Streaming time-stretcher used by playCallback (created by Play_Button)
+    std::unique_ptr<StreamingStretcher> stretcher;
+
+    // The take already stretched during recording (see TakeRender), set
+    // when the take stops. playCallback copies from it while the ratio
+    // matches and neither a loop nor gap skipping is in effect.
+    std::unique_ptr<TakeRender> render;
+
+    // Renders at other speeds, made while idle (declared after the take and
+    // the render, so its worker stops before they go)
+    std::unique_ptr<RenderCache> renderCache;
+
+    // Spectra of the take, made by the capture monitor as it records and
+    // read by the spectrogram view (see Spectrogram)
+    std::unique_ptr<Spectrogram> spectrogram;
+
+    // Xrun and callback-duration counters, written from the callbacks
+    StreamStats recordStats;
+    StreamStats playStats;
+
+    // Peak, RMS and true-peak levels, written from the callbacks and polled
+    // by the meters (see LevelMeter)
+    std::unique_ptr<LevelMeter> recordLevels;
+    std::unique_ptr<LevelMeter> playLevels;
+
+    // Audible position, published from the callbacks' timestamps
+    PlayheadClock recordClock;
+    PlayheadClock playClock;
+    double captureSampleRate;  // rate the capture stream was opened at
+    double playSourcePos;      // take position of the next output frame (audio thread only)
+    bool playFromRender;       // playing from `render` (audio thread only)
+    long renderPos;            // next frame of `render` to play (audio thread only)
+    bool playPaused;           // Pause applied: fade out, then silence (audio thread only)
+    bool playSilent;           // paused and faded out (audio thread only)
+
+    explicit AudioData(SampleStorage storage = defaultSampleStorage(), bool compress = defaultCompressTake());
+    ~AudioData();
+    AudioData(const AudioData&) = delete;
+    AudioData& operator=(const AudioData&) = delete;
+
+    bool hasBuffer() const { return maxSamplesBuffer > 0; }
+
+    // Write interleaved frames at frame `at` (nullptr writes silence), and
+    // read frames of one channel back as SAMPLE. Real-time safe.
+    void storeFrames(const SAMPLE* interleaved, long at, long frames);
+    void loadFrames(int channel, long from, long frames, SAMPLE* out) const;
+
+    // Queue `command` for playCallback. With no playback running it is
+    // applied here instead: a seek sets where the next play starts, a loop
+    // is set right away, the rest has nothing to act on.
+    bool send(const EngineCommand& command);
+    void requestSeek(long frame) { send({ EngineCommandType::Seek, frame }); }
+    bool hasLoop() const { return loopStart.load() >= 0 && loopEnd.load() > loopStart.load(); }
+
+    // Take frames that are audible / being captured right now, -1 if unknown
+    long audiblePlayFrame() const;
+    long audibleRecordFrame() const;
+
+    // Input + output latency as measured by the last callbacks, in seconds
+    double roundTripLatency() const { return recordClock.measuredLatency() + playClock.measuredLatency(); }
+
+private:
+    void* block;  // aligned block behind playScratch[]
 };
\ No newline at end of file
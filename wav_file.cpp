@@ -0,0 +1,155 @@
+#include "wav_file.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace {
+    const uint16_t FORMAT_PCM = 1;
+    const uint16_t FORMAT_IEEE_FLOAT = 3;
+    const uint16_t FORMAT_EXTENSIBLE = 0xFFFE;
+
+    uint16_t le16(const unsigned char* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+    uint32_t le32(const unsigned char* p) { return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+    void put16(std::ofstream& f, uint16_t v) { char b[2] = { (char)(v & 0xff), (char)(v >> 8) }; f.write(b, 2); }
+    void put32(std::ofstream& f, uint32_t v) { char b[4] = { (char)(v & 0xff), (char)((v >> 8) & 0xff), (char)((v >> 16) & 0xff), (char)(v >> 24) }; f.write(b, 4); }
+}
+
+bool readWav(const std::string& path, WavData& out, std::string& error)
+{
+    std::ifstream f(path, std::ios::binary);
+    if (!f) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    unsigned char riff[12];
+    if (!f.read((char*)riff, 12) || std::memcmp(riff, "RIFF", 4) != 0 || std::memcmp(riff + 8, "WAVE", 4) != 0) {
+        error = path + " is not a RIFF/WAVE file";
+        return false;
+    }
+
+    uint16_t format = 0, channels = 0, bits = 0;
+    uint32_t rate = 0;
+    bool haveFmt = false;
+
+    unsigned char hdr[8];
+    while (f.read((char*)hdr, 8))
+    {
+        uint32_t size = le32(hdr + 4);
+
+        if (std::memcmp(hdr, "fmt ", 4) == 0)
+        {
+            std::vector<unsigned char> fmt(size);
+            if (size < 16 || !f.read((char*)fmt.data(), size)) break;
+            format = le16(&fmt[0]);
+            channels = le16(&fmt[2]);
+            rate = le32(&fmt[4]);
+            bits = le16(&fmt[14]);
+            if (format == FORMAT_EXTENSIBLE && size >= 26)
+                format = le16(&fmt[24]);  // first two bytes of the sub-format GUID
+            haveFmt = true;
+        }
+        else if (std::memcmp(hdr, "data", 4) == 0)
+        {
+            if (!haveFmt) break;
+
+            bool supported = (format == FORMAT_PCM && (bits == 16 || bits == 24 || bits == 32)) ||
+                (format == FORMAT_IEEE_FLOAT && bits == 32);
+            if (!supported || channels == 0) {
+                error = path + ": unsupported sample format (format " + std::to_string(format) +
+                    ", " + std::to_string(bits) + " bit)";
+                return false;
+            }
+
+            size_t bytesPerSample = bits / 8;
+            size_t count = size / bytesPerSample;
+            count -= count % channels;
+
+            std::vector<unsigned char> raw(count * bytesPerSample);
+            f.read((char*)raw.data(), raw.size());
+            count = (size_t)f.gcount() / bytesPerSample;
+            count -= count % channels;
+
+            out.sampleRate = (int)rate;
+            out.channels = channels;
+            out.samples.resize(count);
+
+            const unsigned char* p = raw.data();
+            for (size_t i = 0; i < count; i++, p += bytesPerSample)
+            {
+                if (format == FORMAT_IEEE_FLOAT) {
+                    uint32_t u = le32(p);
+                    std::memcpy(&out.samples[i], &u, 4);
+                }
+                else if (bits == 16) {
+                    out.samples[i] = (int16_t)le16(p) / 32768.0f;
+                }
+                else if (bits == 24) {
+                    int32_t v = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) >> 8;
+                    out.samples[i] = v / 8388608.0f;
+                }
+                else {
+                    out.samples[i] = (int32_t)le32(p) / 2147483648.0f;
+                }
+            }
+            return true;
+        }
+        else
+        {
+            // Chunks are padded to an even size
+            f.seekg(size + (size & 1), std::ios::cur);
+        }
+    }
+
+    error = path + ": no fmt/data chunk found";
+    return false;
+}
+
+bool writeWav(const std::string& path, const WavData& in, WavSampleFormat format, std::string& error)
+{
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    if (!f) {
+        error = "cannot create " + path;
+        return false;
+    }
+
+    const uint16_t bits = format == WavSampleFormat::Pcm16 ? 16 : 32;
+    const uint16_t tag = format == WavSampleFormat::Pcm16 ? FORMAT_PCM : FORMAT_IEEE_FLOAT;
+    const uint32_t dataBytes = (uint32_t)(in.samples.size() * (bits / 8));
+    const uint16_t blockAlign = (uint16_t)(in.channels * (bits / 8));
+
+    f.write("RIFF", 4);
+    put32(f, 36 + dataBytes);
+    f.write("WAVE", 4);
+    f.write("fmt ", 4);
+    put32(f, 16);
+    put16(f, tag);
+    put16(f, (uint16_t)in.channels);
+    put32(f, (uint32_t)in.sampleRate);
+    put32(f, (uint32_t)in.sampleRate * blockAlign);
+    put16(f, blockAlign);
+    put16(f, bits);
+    f.write("data", 4);
+    put32(f, dataBytes);
+
+    if (format == WavSampleFormat::Pcm16) {
+        std::vector<int16_t> pcm(in.samples.size());
+        for (size_t i = 0; i < pcm.size(); i++) {
+            float v = std::clamp(in.samples[i], -1.0f, 1.0f);
+            pcm[i] = (int16_t)std::lrint(v * 32767.0f);
+        }
+        f.write((const char*)pcm.data(), pcm.size() * sizeof(int16_t));
+    }
+    else {
+        f.write((const char*)in.samples.data(), in.samples.size() * sizeof(float));
+    }
+
+    if (!f) {
+        error = "write failed: " + path;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/**
+ * Interleaved float audio as read from / written to a RIFF WAVE file.
+ */
+struct WavData {
+    int sampleRate = 0;
+    int channels = 0;
+    std::vector<float> samples;  // interleaved, frames * channels
+
+    size_t frames() const { return channels > 0 ? samples.size() / channels : 0; }
+};
+
+enum class WavSampleFormat {
+    Float32,
+    Pcm16,
+};
+
+// Reads 16/24/32-bit PCM and 32-bit float files (plain or WAVE_FORMAT_EXTENSIBLE).
+// On failure returns false and leaves a message in `error`.
+bool readWav(const std::string& path, WavData& out, std::string& error);
+
+bool writeWav(const std::string& path, const WavData& in, WavSampleFormat format, std::string& error);
@@ -1,9 +1,51 @@
 #include "wave_panel.h"
 #include "my_events.h"
+#include "main_window.h"
+#include "spectrogram.h"
+#include <wx/rawbmp.h>
 #include <algorithm>  // for std::min, etc.
+#include <cstdlib>
 
 namespace {
     constexpr int ID_REDRAW_TIMER = wxID_HIGHEST + 101;
+    constexpr int DRAG_THRESHOLD_PX = 3;  // below this a drag counts as a click
+
+    // Raster columns [first, last] into the bitmap, each logical pixel
+    // repeated over the physical pixels it covers on high-DPI screens
+    void copyRaster(const WaveformRaster& raster, wxBitmap& bmp, int first, int last)
+    {
+        const int w = raster.width(), h = raster.height();
+        if (!bmp.IsOk() || w == 0 || h == 0)
+            return;
+
+        wxNativePixelData pixels(bmp);
+        if (!pixels)
+            return;
+
+        const int pw = pixels.GetWidth(), ph = pixels.GetHeight();
+        first = std::clamp(first, 0, w - 1);
+        last = std::clamp(last, first, w - 1);
+        const int px0 = (int)((long long)first * pw / w);
+        const int px1 = std::min(pw, (int)(((long long)last + 1) * pw / w));
+
+        std::vector<int> column(px1 - px0);
+        for (int px = px0; px < px1; px++)
+            column[px - px0] = (int)((long long)px * w / pw);
+
+        wxNativePixelData::Iterator p(pixels);
+        for (int py = 0; py < ph; py++)
+        {
+            const uint32_t* row = raster.row((int)((long long)py * h / ph));
+            p.MoveTo(pixels, px0, py);
+            for (int i = 0; i < px1 - px0; i++, ++p)
+            {
+                uint32_t c = row[column[i]];
+                p.Red() = (unsigned char)(c >> 16);
+                p.Green() = (unsigned char)(c >> 8);
+                p.Blue() = (unsigned char)c;
+            }
+        }
+    }
 }
 
 // Macro for event table
@@ -15,10 +57,18 @@ EVT_COMMAND(wxID_ANY, myEVT_RECORD_STARTED, WavePanel::OnRecordStarted)
 EVT_COMMAND(wxID_ANY, myEVT_RECORD_STOPPED, WavePanel::OnRecordStopped)
 EVT_COMMAND(wxID_ANY, myEVT_PLAY_STARTED, WavePanel::OnPlayStarted)
 EVT_COMMAND(wxID_ANY, myEVT_PLAY_STOPPED, WavePanel::OnPlayStopped)
+EVT_LEFT_DOWN(WavePanel::OnLeftDown)
+EVT_LEFT_UP(WavePanel::OnLeftUp)
+EVT_LEFT_DCLICK(WavePanel::OnLeftDClick)
+EVT_MOTION(WavePanel::OnMotion)
+EVT_MOUSEWHEEL(WavePanel::OnMouseWheel)
+EVT_MOUSE_CAPTURE_LOST(WavePanel::OnCaptureLost)
 wxEND_EVENT_TABLE()
 
 WavePanel::WavePanel(wxWindow* parent, std::shared_ptr<AudioData> pData, std::shared_ptr<State> pState)
-    : wxPanel(parent, wxID_ANY), m_pData(pData), pStateCpy(pState), m_redrawTimer(this, ID_REDRAW_TIMER)
+    : wxPanel(parent, wxID_ANY), m_pData(pData), pStateCpy(pState),
+    m_tiles(std::make_unique<WaveformTiles>(pData.get())),
+    m_redrawTimer(this, ID_REDRAW_TIMER)
 {
     // Nothing special in constructor right now.
     // If you want to do double-buffering or set background style:
@@ -27,9 +77,18 @@ WavePanel::WavePanel(wxWindow* parent, std::shared_ptr<AudioData> pData, std::sh
 
 void WavePanel::OnSize(wxSizeEvent& event)
 {
-    InitPanelBmp();
+    // Wider may mean the zoom level now shows it all; either way the view
+    // must stay inside the take
+    if (Zoomed()) {
+        if (m_zoomLevel >= OverviewLevel()) {
+            m_zoomLevel = -1;
+            m_tileBitmaps.clear();
+        }
+        else
+            ScrollTo(m_viewStart);
+    }
 
-    m_pData->lastSampleIndex = 0;
+    RebuildWaveform();
 
     // Trigger repaint with new size
     Refresh(false);
@@ -38,13 +97,24 @@ void WavePanel::OnSize(wxSizeEvent& event)
 
 void WavePanel::OnRecordStarted(wxCommandEvent& event)
 {
+    // Recording always shows the whole buffer; the old take's tiles are done
+    m_zoomLevel = -1;
+    m_tiles->invalidate();
+    m_tileBitmaps.clear();
+
     InitPanelBmp();
 
     if (m_pData) {
         m_pData->lastSampleIndex = 0;
+        m_spectrumDrawn = 0;
+        m_summary.reset(m_pData->maxSamplesBuffer, GetClientSize().x);
     }
 
     marker_position = -1;
+    m_cursorFrame = -1;
+
+    if (m_pData)
+        m_pData->send({ EngineCommandType::SetLoop, -1, -1 });
 
     m_redrawTimer.Start(33);
     Refresh(false);
@@ -53,15 +123,25 @@ void WavePanel::OnRecordStarted(wxCommandEvent& event)
 void WavePanel::OnRecordStopped(wxCommandEvent& event)
 {
     m_redrawTimer.Stop();
+    m_tiles->invalidate();   // the stop may have trimmed the end
+
+    // the frames that came after the last tick
+    if (m_bmp.IsOk() && m_pData && m_pData->hasBuffer() && m_summary.columns() > 0)
+    {
+        FoldFrames(std::min(m_pData->totalSamplesRecorded, m_pData->maxSamplesBuffer));
+        DrawNewSpectra();
+        RefreshDirty();
+    }
     Refresh(false);            // final repaint if needed
 }
 
 void WavePanel::OnPlayStarted(wxCommandEvent& event)
 {
-    if (!m_pData || !m_pData->recorded)
+    if (!m_pData || !m_pData->hasBuffer())
         return;
 
     marker_position = -1;
+    m_cursorFrame = -1;
 
     m_redrawTimer.Start(33);
     Refresh(false);
@@ -70,9 +150,22 @@ void WavePanel::OnPlayStarted(wxCommandEvent& event)
 void WavePanel::OnPlayStopped(wxCommandEvent& event)
 {
     m_redrawTimer.Stop();
+    m_cursorFrame = -1;
     Refresh(false);  // one last update (e.g. to leave marker at end or clear it)
 }
 
+void WavePanel::SetViewMode(ViewMode mode)
+{
+    if (mode == m_viewMode)
+        return;
+
+    m_viewMode = mode;
+    m_tiles->setMode(mode);
+    m_tileBitmaps.clear();
+    RebuildWaveform();
+    Refresh(false);
+}
+
 void WavePanel::InitPanelBmp()
 {
     const wxSize size = GetClientSize();
@@ -83,15 +176,41 @@ void WavePanel::InitPanelBmp()
     m_bmp.CreateWithDIPSize(size, GetDPIScaleFactor());
 
     // Make panel white again
-    wxMemoryDC memdc(m_bmp);
-    memdc.SetBrush(*wxWHITE_BRUSH);
-    memdc.SetPen(*wxWHITE_PEN);
-    memdc.DrawRectangle(0, 0, size.x, size.y);
+    m_raster.resize(size.x, size.y);
+    CopyToBitmap(0, size.x - 1);
 
     marker_position = -1;
+    m_dirty.clear();
 }
 
-// The main drawing routine, called whenever wxWidgets must refresh the panel
+// Clear the bitmap and summarise everything recorded so far for the current
+// width, then draw it. Recording continues from there on the next paint.
+void WavePanel::RebuildWaveform()
+{
+    InitPanelBmp();
+
+    const wxSize size = GetClientSize();
+    if (!m_pData || !m_pData->hasBuffer() || size.x <= 0 || size.y <= 0) {
+        m_summary.reset(1, 0);
+        return;
+    }
+
+    long frames = pStateCpy->state == Recording ? m_pData->currentSampleIndex : m_pData->totalSamplesRecorded;
+    frames = std::min<long>(frames, m_pData->maxSamplesBuffer);
+
+    m_summary.build(*m_pData, 0, frames, m_pData->maxSamplesBuffer, size.x);
+
+    m_spectrumDrawn = m_pData->spectrogram->frames();
+    DrawColumns(0, m_summary.columns() - 1);
+    CopyToBitmap(0, size.x - 1);
+
+    m_pData->lastSampleIndex = (int)frames;
+}
+
+// The main drawing routine, called whenever wxWidgets must refresh the panel.
+// The bitmap is kept current by UpdateBitmap(); this only copies the parts
+// that were invalidated, which during recording and playback is a few
+// columns per tick.
 void WavePanel::OnPaint(wxPaintEvent& event)
 {   
     wxPaintDC dc(this);
@@ -99,90 +218,567 @@ void WavePanel::OnPaint(wxPaintEvent& event)
     int width, height;
     GetClientSize(&width, &height);
 
-    if (!m_bmp.IsOk())
-        InitPanelBmp();
+    if (!m_bmp.IsOk() || m_summary.columns() != width)
+        RebuildWaveform();
 
+    if (Zoomed())
+    {
+        PaintTiles(dc);
+        DrawOverlay(dc);
+        if (marker_position >= 0)
+        {
+            dc.SetPen(*wxBLUE_PEN);   // WaveformRaster::MARKER
+            dc.DrawLine(marker_position, 0, marker_position, height);
+        }
+        return;
+    }
+
+    // If no audio data
+    if (!m_pData || !m_pData->hasBuffer())
     {
         wxMemoryDC memdc(m_bmp);
+        memdc.SetBrush(*wxWHITE_BRUSH);
+        memdc.SetPen(*wxWHITE_PEN);
+        memdc.DrawRectangle(0, 0, width, height);
 
-        // If no audio data
-        if (!m_pData || !m_pData->recorded)
-        {
-            memdc.SetBrush(*wxWHITE_BRUSH);
-            memdc.SetPen(*wxWHITE_PEN);
-            memdc.DrawRectangle(0, 0, width, height);
+        memdc.SetTextForeground(*wxBLACK);
+        memdc.DrawText("No audio recorded.", 10, 10);
+    }
 
-            memdc.SetTextForeground(*wxBLACK);
-            memdc.DrawText("No audio recorded.", 10, 10);
+    {
+        wxMemoryDC memdc(m_bmp);
+        for (wxRegionIterator upd(GetUpdateRegion()); upd; ++upd)
+        {
+            wxRect r = upd.GetRect();
+            dc.Blit(r.x, r.y, r.width, r.height, &memdc, r.x, r.y);
         }
-        else if (pStateCpy->state == Recording)
+    }
+
+    DrawOverlay(dc);
+}
+
+void WavePanel::UpdateBitmap()
+{
+    if (!m_bmp.IsOk() || !m_pData || !m_pData->hasBuffer() || m_summary.columns() == 0)
+        return;
+
+    if (pStateCpy->state == Recording)
+    {
+        int currentSampleIndex = std::min(m_pData->currentSampleIndex, m_pData->maxSamplesBuffer);
+        int lastSampleIndex = m_pData->lastSampleIndex;
+
+        // marker where the input is right now, falling back to the write
+        // index until the first callback
+        long captured = m_pData->audibleRecordFrame();
+        int x = XFromFrame(captured >= 0 ? captured : currentSampleIndex) + 1;
+
+        // Frames that have not finished a column yet wait for the next tick
+        bool newColumn = currentSampleIndex > lastSampleIndex &&
+            m_summary.columnOf(currentSampleIndex) != m_summary.columnOf(lastSampleIndex);
+        bool newSpectra = m_viewMode == ViewMode::Spectrogram &&
+            m_pData->spectrogram->frames() > m_spectrumDrawn;
+        if (!newColumn && !newSpectra && x == marker_position)
+            return;
+
+        EraseMarker();
+        FoldFrames(currentSampleIndex);
+        DrawNewSpectra();
+        DrawMarker(x);
+    }
+    else if (pStateCpy->state == Playing || pStateCpy->state == Paused)
+    {
+        // marker at what is audible, not at the read index, which runs
+        // ahead by the output (and stretcher) latency
+        long audible = m_pData->audiblePlayFrame();
+        if (audible < 0)
+            audible = m_pData->lastSampleIndex;
+        m_pData->lastSampleIndex = std::min(m_pData->currentSampleIndex, m_pData->maxSamplesBuffer);
+
+        int x = XFromFrame(audible) + 1;
+        if (x == marker_position)
+            return;
+
+        EraseMarker();
+        DrawMarker(x);
+    }
+}
+
+// Fold the frames recorded since lastSampleIndex into the summary and draw
+// the columns they touched
+void WavePanel::FoldFrames(long upTo)
+{
+    long from = m_pData->lastSampleIndex;
+    if (upTo <= from)
+        return;
+
+    m_summary.update(*m_pData, 0, from, upTo);
+    int first = m_summary.columnOf(from), last = m_summary.columnOf(upTo - 1);
+    DrawColumns(first, last);
+    MarkDirty(first, last);
+
+    m_pData->lastSampleIndex = (int)upTo;
+}
+
+// Columns [first, last] of the overview in the current view mode
+void WavePanel::DrawColumns(int first, int last)
+{
+    if (m_viewMode == ViewMode::Spectrogram)
+        m_raster.drawSpectrum(*m_pData->spectrogram, 0, m_summary.capacity(), m_summary.columns(), first, last);
+    else
+        m_raster.drawColumns(m_summary, first, last);
+}
+
+// The spectra come a monitor period or so behind the frames, so while
+// recording their columns are drawn again as they arrive
+void WavePanel::DrawNewSpectra()
+{
+    if (m_viewMode != ViewMode::Spectrogram)
+        return;
+
+    const long ready = m_pData->spectrogram->frames();
+    if (ready <= m_spectrumDrawn)
+        return;
+
+    // Spectrum i is the nearest one for frames i * HOP -+ HOP / 2
+    const long hop = Spectrogram::HOP;
+    int first = m_summary.columnOf(std::max(0L, m_spectrumDrawn * hop - hop / 2));
+    int last = m_summary.columnOf((ready - 1) * hop + hop / 2 - 1);
+    DrawColumns(first, last);
+    MarkDirty(first, last);
+
+    m_spectrumDrawn = ready;
+}
+
+// Restore the waveform under the marker
+void WavePanel::EraseMarker()
+{
+    if (marker_position < 0)
+        return;
+
+    DrawColumns(marker_position, marker_position);
+    MarkDirty(marker_position, marker_position);
+    marker_position = -1;
+}
+
+void WavePanel::DrawMarker(int x)
+{
+    m_raster.drawMarker(x);
+    MarkDirty(x, x);
+    marker_position = x;
+}
+
+void WavePanel::MarkDirty(int first, int last)
+{
+    // Spans that touch are merged; a jump (seek, loop wrap) gives a second one
+    for (auto& span : m_dirty)
+    {
+        if (first <= span.second + 1 && last >= span.first - 1)
         {
-            int currentSampleIndex = std::min(m_pData->currentSampleIndex, m_pData->maxSamplesBuffer);
+            span.first = std::min(span.first, first);
+            span.second = std::max(span.second, last);
+            return;
+        }
+    }
+    m_dirty.emplace_back(first, last);
+}
 
-            SAMPLE* samples = m_pData->recorded;
-            const float midY = height / 2.0f;
+void WavePanel::RefreshDirty()
+{
+    const int height = GetClientSize().y;
+    for (const auto& span : m_dirty)
+    {
+        CopyToBitmap(span.first, span.second);
+        RefreshRect(wxRect(span.first, 0, span.second - span.first + 1, height), false);
+    }
+    m_dirty.clear();
+}
 
-            float lastX = (float)m_pData->lastSampleIndex * (width / (float)m_pData->maxSamplesBuffer);
-            float lastY = midY;
+void WavePanel::CopyToBitmap(int first, int last)
+{
+    copyRaster(m_raster, m_bmp, first, last);
+}
 
-            // Erase previous marker
-            if (marker_position >= 0) {
-                memdc.SetPen(*wxWHITE_PEN);
-                memdc.DrawLine(marker_position, 0, marker_position, height);
-            }
+// Selection and idle cursor are drawn on top of the bitmap, so they never
+// touch the waveform pixels underneath.
+void WavePanel::DrawOverlay(wxDC& dc)
+{
+    if (!m_pData)
+        return;
 
-            // draw waveform
-            memdc.SetPen(*wxBLACK_PEN);
-            for (int i = m_pData->lastSampleIndex; i < currentSampleIndex; ++i)
-            {
-                float sampleVal = samples[i * NUM_CHANNELS];
-                float y = midY - sampleVal * (height / 2.0f);
-                float x = (float)i * (width / (float)m_pData->maxSamplesBuffer);
+    int width, height;
+    GetClientSize(&width, &height);
 
-                memdc.DrawLine((int)lastX, (int)lastY, (int)x, (int)y);
-                lastX = x;
-                lastY = y;
-            }
+    // Zoomed in, either end may be off screen (x of -1 or width)
+    bool selection = false;
+    int selA = -1, selB = -1;
+    if (m_dragging && std::abs(m_dragCurrentX - m_dragStartX) > DRAG_THRESHOLD_PX) {
+        selA = std::min(m_dragStartX, m_dragCurrentX);
+        selB = std::max(m_dragStartX, m_dragCurrentX);
+        selection = true;
+    }
+    else if (m_pData->hasLoop()) {
+        selA = XFromFrame(m_pData->loopStart);
+        selB = XFromFrame(m_pData->loopEnd);
+        selection = selB >= 0 && selA < width;
+    }
+
+    if (selection)
+    {
+        dc.SetPen(*wxTRANSPARENT_PEN);
+        dc.SetBrush(wxBrush(wxColour(180, 210, 255)));
+        dc.DrawRectangle(selA, 0, selB - selA + 1, 6);
 
-            // draw new position marker
-            marker_position = lastX + 1;
-            memdc.SetPen(*wxBLUE_PEN);
-            memdc.DrawLine(marker_position, 0, marker_position, height);
+        dc.SetPen(wxPen(wxColour(0, 128, 0)));
+        dc.DrawLine(selA, 0, selA, height);
+        dc.DrawLine(selB, 0, selB, height);
+    }
 
-            m_pData->lastSampleIndex = currentSampleIndex;
+    // Trimmed lead-in and skipped gaps: grey along the bottom edge
+    if (pStateCpy->state != Recording)
+    {
+        dc.SetPen(*wxTRANSPARENT_PEN);
+        dc.SetBrush(wxBrush(wxColour(200, 200, 200)));
+        if (m_pData->takeStart > 0)
+            dc.DrawRectangle(0, height - 4, XFromFrame(m_pData->takeStart) + 1, 4);
+        if (m_pData->skipSilentGaps.load()) {
+            for (const SilentRegion& gap : m_pData->silentGaps) {
+                int x = XFromFrame(gap.start);
+                dc.DrawRectangle(x, height - 4, XFromFrame(gap.end) - x + 1, 4);
+            }
         }
-        else if (pStateCpy->state == Playing) {
-            int currentSampleIndex = std::min(m_pData->currentSampleIndex, m_pData->maxSamplesBuffer);
+    }
 
-            SAMPLE* samples = m_pData->recorded;
-            const float midY = height / 2.0f;
+    if (pStateCpy->state == Idle && m_cursorFrame >= 0)
+    {
+        int x = XFromFrame(m_cursorFrame);
+        dc.SetPen(*wxBLUE_PEN);
+        dc.DrawLine(x, 0, x, height);
+    }
+}
 
-            float lastX = (float)m_pData->lastSampleIndex * (width / (float)m_pData->maxSamplesBuffer);
-            float lastY = midY;
+bool WavePanel::CanSeek() const
+{
+    return m_pData && m_pData->hasBuffer() &&
+        m_pData->totalSamplesRecorded > 0 &&
+        pStateCpy->state != Recording;
+}
+
+long WavePanel::FrameFromX(int x) const
+{
+    const int width = GetClientSize().x;
+    if (width <= 0)
+        return 0;
 
-            // Erase previous marker
-            if (marker_position >= 0) {
-                memdc.SetPen(*wxWHITE_PEN);
-                memdc.DrawLine(marker_position, 0, marker_position, height);
+    long frame = Zoomed() ? m_viewStart + ((long)x << m_zoomLevel)
+        : (long)((double)x * m_pData->maxSamplesBuffer / width);
+    return std::clamp<long>(frame, 0, m_pData->totalSamplesRecorded);
+}
+
+int WavePanel::XFromFrame(long frame) const
+{
+    const int width = GetClientSize().x;
+    if (!Zoomed())
+        return (int)((double)frame * width / m_pData->maxSamplesBuffer);
+
+    // Frames left or right of the view map just off screen
+    const long step = 1L << m_zoomLevel;
+    const long d = frame - m_viewStart;
+    const long x = d >= 0 ? d / step : -((step - 1 - d) / step);
+    return (int)std::clamp<long>(x, -1, width);
+}
+
+// The coarsest zoom level that still shows less than the whole buffer,
+// plus one: from there on the overview is what the view shows
+int WavePanel::OverviewLevel() const
+{
+    const long width = std::max(GetClientSize().x, 1);
+    int level = 0;
+    while ((width << level) < m_pData->maxSamplesBuffer)
+        level++;
+    return level;
+}
+
+// Zoom to `level`, keeping anchorFrame under x = anchorX. Levels at or
+// past OverviewLevel() go back to the overview.
+void WavePanel::SetZoom(int level, long anchorFrame, int anchorX)
+{
+    level = std::max(level, 0);
+    if (level >= OverviewLevel())
+    {
+        if (!Zoomed())
+            return;
+        m_zoomLevel = -1;
+        m_tiles->retain(-1, 0, -1);
+        m_tileBitmaps.clear();
+        RebuildWaveform();
+    }
+    else
+    {
+        if (level == m_zoomLevel)
+            return;
+        m_zoomLevel = level;
+        m_tileBitmaps.clear();
+        ScrollTo(anchorFrame - ((long)anchorX << level));
+    }
+
+    marker_position = -1;
+    Refresh(false);
+}
+
+// Put `frame` at the left edge, as far as the take allows, in whole columns
+// so that tiles land on whole pixels
+void WavePanel::ScrollTo(long frame)
+{
+    const long step = 1L << m_zoomLevel;
+    const long span = (long)GetClientSize().x * step;
+    const long recorded = std::min(m_pData->totalSamplesRecorded, m_pData->maxSamplesBuffer);
+
+    long start = std::clamp<long>(frame, 0, std::max(0L, recorded - span));
+    start -= start % step;
+    if (start == m_viewStart)
+        return;
+
+    m_viewStart = start;
+    marker_position = -1;
+    Refresh(false);
+}
+
+// Zoomed in: the tiles under the update region, straight from the cache.
+// Tiles not rendered yet are queued and show grey until they come in, and
+// the ones either side of the view are queued too, for the next scroll.
+void WavePanel::PaintTiles(wxDC& dc)
+{
+    int width, height;
+    GetClientSize(&width, &height);
+    m_tiles->setHeight(height);
+
+    const int columns = WaveformTiles::TILE_COLUMNS;
+    const long step = 1L << m_zoomLevel;
+    const long tileFrames = WaveformTiles::tileFrames(m_zoomLevel);
+    const long recorded = std::min(m_pData->totalSamplesRecorded, m_pData->maxSamplesBuffer);
+    const long first = m_viewStart / tileFrames;
+    const long last = (m_viewStart + (long)width * step - 1) / tileFrames;
+    m_tiles->retain(m_zoomLevel, first - 1, last + 1);
+
+    dc.SetPen(*wxTRANSPARENT_PEN);
+    std::map<uint64_t, wxBitmap> onScreen;
+    for (long i = first; i <= last; i++)
+    {
+        const int x = (int)((i * tileFrames - m_viewStart) / step);
+        if (i * tileFrames >= recorded)
+        {
+            // past the end of the take
+            dc.SetBrush(*wxWHITE_BRUSH);
+            dc.DrawRectangle(x, 0, width - x, height);
+            break;
+        }
+
+        auto tile = m_tiles->get(m_zoomLevel, i);
+        if (!tile)
+        {
+            if (IsExposed(x, 0, columns, height)) {
+                dc.SetBrush(wxBrush(wxColour(235, 235, 235)));
+                dc.DrawRectangle(x, 0, columns, height);
             }
+            continue;
+        }
 
-            // draw new position marker
-            marker_position = lastX + 1;
-            memdc.SetPen(*wxBLUE_PEN);
-            memdc.DrawLine(marker_position, 0, marker_position, height);
+        auto found = m_tileBitmaps.find(tile->serial);
+        wxBitmap bmp = found != m_tileBitmaps.end() ? found->second : TileBitmap(*tile);
+        onScreen[tile->serial] = bmp;
 
-            m_pData->lastSampleIndex = currentSampleIndex;
+        if (IsExposed(x, 0, columns, height)) {
+            wxMemoryDC memdc(bmp);
+            dc.Blit(x, 0, columns, height, &memdc, 0, 0);
         }
     }
+    m_tileBitmaps.swap(onScreen);
+
+    if (first > 0)
+        m_tiles->get(m_zoomLevel, first - 1);
+    if ((last + 1) * tileFrames < recorded)
+        m_tiles->get(m_zoomLevel, last + 1);
 
-    // Draw buffer on screen
-    dc.DrawBitmap(m_bmp, 0, 0, false);
+    // The redraw tick polls for the tiles still to come
+    if (m_tiles->usage().pending > 0 && !m_redrawTimer.IsRunning())
+        m_redrawTimer.Start(33);
 }
 
-void WavePanel::OnRedrawTimer(wxTimerEvent&)
+wxBitmap WavePanel::TileBitmap(const WaveformTiles::Tile& tile) const
+{
+    wxBitmap bmp;
+    bmp.CreateWithDIPSize(wxSize(tile.raster.width(), tile.raster.height()), GetDPIScaleFactor());
+    copyRaster(tile.raster, bmp, 0, tile.raster.width() - 1);
+    return bmp;
+}
+
+// Zoomed in, the play marker is a line drawn over the tiles: move it, and
+// turn the page when playback runs out of the view
+void WavePanel::UpdateZoomedMarker()
+{
+    if (pStateCpy->state != Playing && pStateCpy->state != Paused)
+        return;
+
+    long audible = m_pData->audiblePlayFrame();
+    if (audible < 0)
+        audible = m_pData->lastSampleIndex;
+    m_pData->lastSampleIndex = std::min(m_pData->currentSampleIndex, m_pData->maxSamplesBuffer);
+
+    int width, height;
+    GetClientSize(&width, &height);
+
+    int x = XFromFrame(audible);
+    if (pStateCpy->state == Playing && (x < 0 || x >= width))
+    {
+        ScrollTo(audible - ((long)(width / 8) << m_zoomLevel));
+        marker_position = XFromFrame(audible);
+        return;
+    }
+    if (x == marker_position)
+        return;
+
+    if (marker_position >= 0)
+        RefreshRect(wxRect(marker_position, 0, 1, height), false);
+    marker_position = x;
+    RefreshRect(wxRect(x, 0, 1, height), false);
+}
+
+// Ctrl+wheel zooms around the pointer, the wheel alone scrolls when zoomed in
+void WavePanel::OnMouseWheel(wxMouseEvent& event)
+{
+    const int width = GetClientSize().x;
+    if (!CanSeek() || width <= 0 || (!Zoomed() && !event.ControlDown())) {
+        event.Skip();
+        return;
+    }
+
+    // Touchpads send fractions of a step
+    m_wheelRotation += event.GetWheelRotation();
+    const int delta = std::max(event.GetWheelDelta(), 1);
+    const int steps = m_wheelRotation / delta;
+    m_wheelRotation -= steps * delta;
+    if (steps == 0)
+        return;
+
+    if (event.ControlDown())
+    {
+        const int x = std::clamp(event.GetX(), 0, width - 1);
+        const long anchor = FrameFromX(x);
+        SetZoom((Zoomed() ? m_zoomLevel : OverviewLevel()) - steps, anchor, x);
+    }
+    else
+    {
+        // an eighth of the view per step
+        ScrollTo(m_viewStart - (long)steps * ((long)std::max(width / 8, 1) << m_zoomLevel));
+    }
+}
+
+void WavePanel::OnLeftDown(wxMouseEvent& event)
 {
-    if (pStateCpy->state == Recording || pStateCpy->state == Playing)
-        Refresh(false);
+    if (!CanSeek()) {
+        event.Skip();
+        return;
+    }
+
+    m_dragging = true;
+    m_dragStartX = m_dragCurrentX = event.GetX();
+    CaptureMouse();
+}
+
+void WavePanel::OnMotion(wxMouseEvent& event)
+{
+    if (!m_dragging || !event.LeftIsDown()) {
+        event.Skip();
+        return;
+    }
+
+    m_dragCurrentX = std::clamp(event.GetX(), 0, GetClientSize().x - 1);
+    Refresh(false);
+}
+
+void WavePanel::OnLeftUp(wxMouseEvent& event)
+{
+    if (!m_dragging) {
+        event.Skip();
+        return;
+    }
+
+    m_dragging = false;
+    if (HasCapture())
+        ReleaseMouse();
+
+    if (std::abs(m_dragCurrentX - m_dragStartX) > DRAG_THRESHOLD_PX)
+    {
+        // Drag: select a loop region and jump to its start
+        long a = FrameFromX(std::min(m_dragStartX, m_dragCurrentX));
+        long b = FrameFromX(std::max(m_dragStartX, m_dragCurrentX));
+        m_pData->send({ EngineCommandType::SetLoop, a, b });
+        m_cursorFrame = a;
+    }
     else
+    {
+        // Click: clear the selection and seek
+        m_pData->send({ EngineCommandType::SetLoop, -1, -1 });
+        m_cursorFrame = FrameFromX(m_dragStartX);
+    }
+
+    // Applied by playCallback at the next block boundary, after the loop
+    // change, or by the first callback of the next play when idle.
+    m_pData->requestSeek(m_cursorFrame);
+    Refresh(false);
+}
+
+// Double-click while idle: seek there and start playing right away
+void WavePanel::OnLeftDClick(wxMouseEvent& event)
+{
+    if (!CanSeek() || pStateCpy->state != Idle) {
+        event.Skip();
+        return;
+    }
+
+    m_cursorFrame = FrameFromX(event.GetX());
+    m_pData->requestSeek(m_cursorFrame);
+
+    if (auto mw = dynamic_cast<MainWindow*>(wxGetTopLevelParent(this)))
+    {
+        wxCommandEvent ev(wxEVT_BUTTON, mw->playButton->button->GetId());
+        ev.SetEventObject(mw->playButton->button);
+        wxPostEvent(mw->playButton->button, ev);
+    }
+}
+
+void WavePanel::OnCaptureLost(wxMouseCaptureLostEvent& WXUNUSED(event))
+{
+    m_dragging = false;
+    Refresh(false);
+}
+
+void WavePanel::OnRedrawTimer(wxTimerEvent&)
+{
+    const bool moving = pStateCpy->state == Recording || pStateCpy->state == Playing || pStateCpy->state == Paused;
+    if (moving)
+    {
+        // Only what changed goes to the screen, and nothing at all on
+        // ticks where no position crossed a pixel
+        if (Zoomed())
+            UpdateZoomedMarker();
+        else {
+            UpdateBitmap();
+            RefreshDirty();
+        }
+    }
+
+    // Tiles that came in since the last tick
+    bool tilesPending = false;
+    if (Zoomed())
+    {
+        tilesPending = m_tiles->usage().pending > 0;
+        if (m_tiles->generation() != m_tileGeneration) {
+            m_tileGeneration = m_tiles->generation();
+            Refresh(false);
+        }
+    }
+
+    if (!moving && !tilesPending)
         m_redrawTimer.Stop();
 }
\ No newline at end of file
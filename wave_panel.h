@@ -1,8 +1,13 @@
 #pragma once
 
 #include <wx/wx.h>
+#include <map>
 #include <memory>
+#include <vector>
 #include "utils.h"   // for SAMPLE, NUM_CHANNELS, etc.
+#include "waveform_raster.h"
+#include "waveform_summary.h"
+#include "waveform_tiles.h"
 #include "state.h"   // not strictly required, but you have it
                      // in your project includes
 // forward-declare or include the definition of AudioData
@@ -17,6 +22,9 @@ public:
      */
     WavePanel(wxWindow* parent, std::shared_ptr<AudioData> pData, std::shared_ptr<State> pState);
 
+    // Waveform or spectrogram, at the same zoom and position
+    void SetViewMode(ViewMode mode);
+
     /**
      * If you want to reassign the AudioData after creation,
      * you can add a setter like this (optional):
@@ -28,7 +36,27 @@ private:
     std::shared_ptr<AudioData> m_pData;
     std::shared_ptr<State>     pStateCpy;
     wxBitmap m_bmp;
-    int marker_position;
+    WaveformSummary m_summary;   // min/max per pixel column of the bitmap
+    WaveformRaster m_raster;     // the view drawn in m_bmp, in logical pixels
+    int marker_position = -1;
+    ViewMode m_viewMode = ViewMode::Waveform;
+    long m_spectrumDrawn = 0;    // spectra drawn into m_raster so far
+
+    // Mouse seek / loop selection
+    bool m_dragging = false;
+    int m_dragStartX = 0;
+    int m_dragCurrentX = 0;
+    long m_cursorFrame = -1;   // seek cursor shown while idle
+
+    // Zoom: at -1 the whole buffer spans the width, as while recording.
+    // Otherwise a column covers 2^m_zoomLevel frames from m_viewStart on and
+    // the view is composited from the tiles in m_tiles.
+    int m_zoomLevel = -1;
+    long m_viewStart = 0;
+    int m_wheelRotation = 0;                     // towards the next wheel step
+    std::unique_ptr<WaveformTiles> m_tiles;
+    std::map<uint64_t, wxBitmap> m_tileBitmaps;  // tiles on screen, by serial
+    unsigned m_tileGeneration = 0;
 
     // The paint event is where we draw the waveform
     void OnPaint(wxPaintEvent& event);
@@ -38,6 +66,42 @@ private:
     void OnPlayStarted(wxCommandEvent& event);
     void OnPlayStopped(wxCommandEvent& event);
     void InitPanelBmp();
+    void RebuildWaveform();
+
+    // Bring the bitmap up to date with the write / play position on a
+    // redraw tick. Does nothing unless a position crossed a pixel column.
+    void UpdateBitmap();
+    void FoldFrames(long upTo);
+    void DrawColumns(int first, int last);
+    void DrawNewSpectra();
+    void EraseMarker();
+    void DrawMarker(int x);
+    void CopyToBitmap(int first, int last);
+
+    bool Zoomed() const { return m_zoomLevel >= 0; }
+    int OverviewLevel() const;
+    void SetZoom(int level, long anchorFrame, int anchorX);
+    void ScrollTo(long frame);
+    void PaintTiles(wxDC& dc);
+    wxBitmap TileBitmap(const WaveformTiles::Tile& tile) const;
+    void UpdateZoomedMarker();
+    void OnMouseWheel(wxMouseEvent& event);
+
+    // Raster columns changed since the last RefreshDirty(), which copies
+    // them into the bitmap and invalidates just those on screen
+    std::vector<std::pair<int, int>> m_dirty;
+    void MarkDirty(int first, int last);
+    void RefreshDirty();
+
+    void OnLeftDown(wxMouseEvent& event);
+    void OnLeftUp(wxMouseEvent& event);
+    void OnLeftDClick(wxMouseEvent& event);
+    void OnMotion(wxMouseEvent& event);
+    void OnCaptureLost(wxMouseCaptureLostEvent& event);
+    bool CanSeek() const;
+    long FrameFromX(int x) const;
+    int XFromFrame(long frame) const;
+    void DrawOverlay(wxDC& dc);
 
     wxTimer m_redrawTimer;
     void OnRedrawTimer(wxTimerEvent& evt);
@@ -0,0 +1,23 @@
+#include "waveform_draw.h"
+#include <algorithm>
+
+void drawWaveformColumns(wxDC& dc, const WaveformSummary& summary, int first, int last, int height)
+{
+    const float midY = height / 2.0f;
+
+    first = std::max(first, 0);
+    last = std::min(last, summary.columns() - 1);
+
+    dc.SetPen(*wxBLACK_PEN);
+    for (int x = first; x <= last; x++)
+    {
+        if (!summary.hasData(x))
+            continue;
+
+        int yTop = (int)(midY - summary.maxAt(x) * midY);
+        int yBottom = (int)(midY - summary.minAt(x) * midY);
+
+        // DrawLine leaves out the end point, so a flat column still gets a pixel
+        dc.DrawLine(x, yTop, x, yBottom + 1);
+    }
+}
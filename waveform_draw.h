@@ -0,0 +1,7 @@
+#pragma once
+#include <wx/wx.h>
+#include "waveform_summary.h"
+
+// Draw columns [first, last] of `summary` as vertical min..max lines, one
+// pixel column each, into a DC of the given height. Empty columns are skipped.
+void drawWaveformColumns(wxDC& dc, const WaveformSummary& summary, int first, int last, int height);
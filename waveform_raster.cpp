@@ -0,0 +1,174 @@
+#include "waveform_raster.h"
+#include "spectrogram.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SC_HAVE_SSE2 1
+#endif
+
+namespace {
+
+// Spectrum level to colour: black through purple and orange to pale yellow
+struct SpectrumPalette {
+    uint32_t rgb[256];
+
+    SpectrumPalette()
+    {
+        const struct { int level; uint32_t rgb; } stops[] = {
+            { 0, 0x000004 }, { 64, 0x3B0F70 }, { 128, 0x8C2981 },
+            { 176, 0xDE4968 }, { 224, 0xFE9F6D }, { 255, 0xFCFDBF },
+        };
+        for (size_t s = 0; s + 1 < sizeof(stops) / sizeof(stops[0]); s++) {
+            for (int v = stops[s].level; v <= stops[s + 1].level; v++) {
+                const float t = (float)(v - stops[s].level) / (stops[s + 1].level - stops[s].level);
+                uint32_t c = 0;
+                for (int shift = 0; shift <= 16; shift += 8) {
+                    const int a = (stops[s].rgb >> shift) & 0xFF, b = (stops[s + 1].rgb >> shift) & 0xFF;
+                    c |= (uint32_t)(a + (b - a) * t + 0.5f) << shift;
+                }
+                rgb[v] = c;
+            }
+        }
+    }
+};
+
+const uint32_t* spectrumPalette()
+{
+    static const SpectrumPalette palette;
+    return palette.rgb;
+}
+
+// Spectra looked at per column at most; wider columns take evenly spaced ones
+const long MAX_SPECTRA_PER_COLUMN = 32;
+
+} // namespace
+
+void WaveformRaster::resize(int width, int height)
+{
+    w = std::max(width, 0);
+    h = std::max(height, 0);
+    pixels.assign((size_t)w * h, PAPER);
+    spanTop.assign(w, 0);
+    spanBottom.assign(w, -1);
+
+    // Bin 1 (~43 Hz) at the bottom up to the last bin at the top, each row
+    // the same ratio of frequencies
+    rowBinLo.resize(h);
+    rowBinHi.resize(h);
+    const int bins = Spectrogram::BINS;
+    for (int r = 0; r < h; r++) {
+        int lo = (int)std::pow((double)bins, (double)r / h);
+        int hi = (int)std::ceil(std::pow((double)bins, (double)(r + 1) / h)) - 1;
+        lo = std::min(lo, bins - 1);
+        rowBinLo[h - 1 - r] = (int16_t)lo;
+        rowBinHi[h - 1 - r] = (int16_t)std::clamp(hi, lo, bins - 1);
+    }
+}
+
+void WaveformRaster::clear()
+{
+    std::fill(pixels.begin(), pixels.end(), PAPER);
+    std::fill(spanTop.begin(), spanTop.end(), 0);
+    std::fill(spanBottom.begin(), spanBottom.end(), -1);
+}
+
+void WaveformRaster::drawColumns(const WaveformSummary& summary, int first, int last)
+{
+    first = std::max(first, 0);
+    last = std::min({ last, summary.columns() - 1, w - 1 });
+    if (first > last || h == 0)
+        return;
+
+    // Span of each column, as drawWaveformColumns' DrawLine would cover it
+    const float midY = h / 2.0f;
+    for (int x = first; x <= last; x++)
+    {
+        if (!summary.hasData(x)) {
+            spanTop[x] = 0;
+            spanBottom[x] = -1;
+            continue;
+        }
+        spanTop[x] = (int)(midY - summary.maxAt(x) * midY);
+        spanBottom[x] = (int)(midY - summary.minAt(x) * midY);
+    }
+
+    // Row by row, so the writes are contiguous
+    const int32_t* top = spanTop.data();
+    const int32_t* bottom = spanBottom.data();
+    for (int y = 0; y < h; y++)
+    {
+        uint32_t* out = pixels.data() + (size_t)y * w;
+        int x = first;
+#ifdef SC_HAVE_SSE2
+        const __m128i yv = _mm_set1_epi32(y);
+        const __m128i ink = _mm_set1_epi32((int)INK);
+        const __m128i paper = _mm_set1_epi32((int)PAPER);
+        for (; x + 4 <= last + 1; x += 4)
+        {
+            __m128i t = _mm_loadu_si128((const __m128i*)(top + x));
+            __m128i b = _mm_loadu_si128((const __m128i*)(bottom + x));
+            __m128i outside = _mm_or_si128(_mm_cmplt_epi32(yv, t), _mm_cmpgt_epi32(yv, b));
+            __m128i px = _mm_or_si128(_mm_and_si128(outside, paper), _mm_andnot_si128(outside, ink));
+            _mm_storeu_si128((__m128i*)(out + x), px);
+        }
+#endif
+        for (; x <= last; x++)
+            out[x] = (y < top[x] || y > bottom[x]) ? PAPER : INK;
+    }
+}
+
+void WaveformRaster::drawSpectrum(const Spectrogram& spectrum, long origin, long capacity, int columns, int first, int last)
+{
+    first = std::max(first, 0);
+    last = std::min({ last, columns - 1, w - 1 });
+    if (first > last || h == 0)
+        return;
+
+    const uint32_t* palette = spectrumPalette();
+    const long hop = Spectrogram::HOP;
+    const long ready = spectrum.frames();
+    uint8_t levels[Spectrogram::BINS];
+
+    for (int x = first; x <= last; x++)
+    {
+        spanTop[x] = 0;
+        spanBottom[x] = -1;
+
+        // Take frames [a, b) of the column, and the spectra centred nearest
+        const long a = origin + (long)(((long long)x * capacity + columns - 1) / columns);
+        const long b = origin + (long)(((long long)(x + 1) * capacity + columns - 1) / columns);
+        const long s0 = (a + hop / 2) / hop;
+        const long s1 = std::min(std::max(s0, (b - 1 + hop / 2) / hop), ready - 1);
+        if (s0 > s1) {
+            for (int y = 0; y < h; y++)
+                pixels[(size_t)y * w + x] = PAPER;
+            continue;
+        }
+
+        const long stride = (s1 - s0) / MAX_SPECTRA_PER_COLUMN + 1;
+        std::memcpy(levels, spectrum.frame(s0), sizeof(levels));
+        for (long s = s0 + stride; s <= s1; s += stride) {
+            const uint8_t* f = spectrum.frame(s);
+            for (int k = 0; k < Spectrogram::BINS; k++)
+                levels[k] = std::max(levels[k], f[k]);
+        }
+
+        for (int y = 0; y < h; y++) {
+            uint8_t v = 0;
+            for (int k = rowBinLo[y]; k <= rowBinHi[y]; k++)
+                v = std::max(v, levels[k]);
+            pixels[(size_t)y * w + x] = palette[v];
+        }
+    }
+}
+
+void WaveformRaster::drawMarker(int x, uint32_t colour)
+{
+    if (x < 0 || x >= w)
+        return;
+    for (int y = 0; y < h; y++)
+        pixels[(size_t)y * w + x] = colour;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "waveform_summary.h"
+#include <cstdint>
+#include <vector>
+
+class Spectrogram;
+
+// What the waveform view shows
+enum class ViewMode { Waveform, Spectrogram };
+
+/**
+ * The waveform view as a plain buffer of 32-bit pixels (0x00RRGGBB), one
+ * per logical pixel, row after row. Columns are rasterized straight from a
+ * WaveformSummary without going through a DC: every row of the range is
+ * written as "ink inside the column's min..max span, paper outside", four
+ * pixels per SSE2 step, so a redraw is one pass over memory whatever the
+ * signal. The geometry is exactly that of drawWaveformColumns().
+ * Spectrogram columns are drawn here as well, from the stored spectra.
+ *
+ * WavePanel keeps the view here and copies changed columns into its
+ * bitmap once per redraw tick. No wx dependency, so the benchmark can time
+ * it in core builds.
+ */
+class WaveformRaster {
+public:
+    static constexpr uint32_t PAPER = 0xFFFFFF;
+    static constexpr uint32_t INK = 0x000000;
+    static constexpr uint32_t MARKER = 0x0000FF;
+
+    // Drop the image and make it width x height of paper
+    void resize(int width, int height);
+    void clear();
+
+    int width() const { return w; }
+    int height() const { return h; }
+    const uint32_t* row(int y) const { return pixels.data() + (size_t)y * w; }
+
+    // Columns [first, last] of `summary` (clipped to the image), ink on
+    // paper; columns without data become paper. Also erases a marker.
+    void drawColumns(const WaveformSummary& summary, int first, int last);
+
+    // Columns [first, last] as a spectrogram, frames mapped to columns as
+    // in WaveformSummary (capacity frames from origin over `columns`). Each
+    // column shows the loudest of the spectra nearest the frames it covers,
+    // frequency rising up the rows on a log scale; columns past the spectra
+    // made so far become paper. Also erases a marker.
+    void drawSpectrum(const Spectrogram& spectrum, long origin, long capacity, int columns, int first, int last);
+
+    // Full-height line in column x
+    void drawMarker(int x, uint32_t colour = MARKER);
+
+private:
+    int w = 0, h = 0;
+    std::vector<uint32_t> pixels;
+    std::vector<int32_t> spanTop;      // per column, inclusive; top > bottom when empty
+    std::vector<int32_t> spanBottom;
+    std::vector<int16_t> rowBinLo;     // per row, the spectrum bins it shows
+    std::vector<int16_t> rowBinHi;
+};
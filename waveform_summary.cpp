@@ -0,0 +1,128 @@
+#include "waveform_summary.h"
+#include "sample_kernels.h"
+#include "take_store.h"
+#include <algorithm>
+#include <cfloat>
+#include <limits>
+
+void WaveformSummary::reset(long capacity, int columns, long origin)
+{
+    cap = std::max(capacity, 1L);
+    first0 = std::max(origin, 0L);
+    columns = std::max(columns, 0);
+    mins.assign(columns, FLT_MAX);
+    maxs.assign(columns, -FLT_MAX);
+}
+
+int WaveformSummary::columnOf(long frame) const
+{
+    long long c = (long long)(frame - first0) * columns() / cap;
+    return (int)std::clamp<long long>(c, 0, columns() - 1);
+}
+
+// Smallest frame f with (f - origin) * columns / cap == column
+long WaveformSummary::firstFrameOf(int column) const
+{
+    return first0 + (long)(((long long)column * cap + columns() - 1) / columns());
+}
+
+// Column extremes are tracked as Keys, which order like the sample values
+// but are cheaper to compare; only the final extremes go back to float.
+// samples[0] is frame `first`.
+template <typename T, typename Key, typename ToKey, typename ToFloat>
+void WaveformSummary::fold(const T* samples, long first, long from, long to, ToKey toKey, ToFloat toFloat)
+{
+    if (columns() == 0) return;
+    from = std::max(from, first0);
+    to = std::min(to, first0 + cap);
+    if (from >= to) return;
+
+    // Independent running minima/maxima over 32 bytes of contiguous samples,
+    // folded at the end: lets the compiler use SIMD min/max
+    const int LANES = 32 / sizeof(Key);
+
+    const int lastColumn = columnOf(to - 1);
+    for (int c = columnOf(from); c <= lastColumn; c++)
+    {
+        long a = std::max(from, firstFrameOf(c));
+        long b = c + 1 < columns() ? std::min(to, firstFrameOf(c + 1)) : to;
+        if (a >= b) continue;
+
+        Key lo[LANES], hi[LANES];
+        for (int l = 0; l < LANES; l++) {
+            lo[l] = std::numeric_limits<Key>::max();
+            hi[l] = std::numeric_limits<Key>::lowest();
+        }
+        long f = a;
+        for (; f + LANES <= b; f += LANES)
+        {
+            for (int l = 0; l < LANES; l++) {
+                Key v = toKey(samples[f - first + l]);
+                lo[l] = v < lo[l] ? v : lo[l];
+                hi[l] = v > hi[l] ? v : hi[l];
+            }
+        }
+        for (; f < b; f++) {
+            Key v = toKey(samples[f - first]);
+            lo[0] = v < lo[0] ? v : lo[0];
+            hi[0] = v > hi[0] ? v : hi[0];
+        }
+        for (int l = 1; l < LANES; l++) {
+            lo[0] = lo[l] < lo[0] ? lo[l] : lo[0];
+            hi[0] = hi[l] > hi[0] ? hi[l] : hi[0];
+        }
+        mins[c] = std::min(mins[c], toFloat(lo[0]));
+        maxs[c] = std::max(maxs[c], toFloat(hi[0]));
+    }
+}
+
+void WaveformSummary::update(const SAMPLE* samples, long from, long to)
+{
+    fold<SAMPLE, float>(samples, 0, from, to,
+        [](SAMPLE v) { return (float)v; }, [](float k) { return k; });
+}
+
+void WaveformSummary::update(const AudioData& data, int channel, long from, long to)
+{
+    const SampleStorage format = data.sampleStorage;
+    from = std::max(from, first0);
+    to = std::min(to, first0 + cap);
+    if (from >= to) return;
+    data.take->forEachSegment(channel, from, to, [&](const void* samples, long first, long count) {
+        switch (format) {
+        case SampleStorage::Int16:
+            fold<int16_t, int16_t>((const int16_t*)samples, first, first, first + count,
+                [](int16_t v) { return v; },
+                [](int16_t k) { float f; int16ToFloat(&k, &f, 1); return f; });
+            break;
+        case SampleStorage::Float16:
+            // Halves are sign-magnitude: flipping the magnitude bits of the
+            // negative ones makes them order as two's complement int16
+            fold<uint16_t, int16_t>((const uint16_t*)samples, first, first, first + count,
+                [](uint16_t h) { int16_t s = (int16_t)h; return (int16_t)(s ^ ((s >> 15) & 0x7fff)); },
+                [](int16_t k) {
+                    uint16_t h = (uint16_t)(k ^ ((k >> 15) & 0x7fff));
+                    float f;
+                    halfToFloat(&h, &f, 1);
+                    return f;
+                });
+            break;
+        default:
+            fold<SAMPLE, float>((const SAMPLE*)samples, first, first, first + count,
+                [](SAMPLE v) { return (float)v; }, [](float k) { return k; });
+            break;
+        }
+    });
+}
+
+void WaveformSummary::build(const SAMPLE* samples, long frames, long capacity, int columns)
+{
+    reset(capacity, columns);
+    update(samples, 0, frames);
+}
+
+void WaveformSummary::build(const AudioData& data, int channel, long frames, long capacity, int columns)
+{
+    reset(capacity, columns);
+    update(data, channel, 0, frames);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "utils.h"
+#include <vector>
+
+/**
+ * Min/max of one channel for each pixel column of the waveform view,
+ * so painting never has to walk the samples again. Frames map to columns
+ * the same way WavePanel maps them to x:
+ * column = (frame - origin) * columns / capacity.
+ *
+ * Not thread-safe; owned and updated by the UI thread.
+ */
+class WaveformSummary {
+public:
+    // Forget everything; `capacity` frames from `origin` on are spread over
+    // `columns` columns
+    void reset(long capacity, int columns, long origin = 0);
+
+    // Fold frames [from, to) of one channel's samples in (samples[0] is
+    // frame 0, whatever the origin)
+    void update(const SAMPLE* samples, long from, long to);
+
+    // Same for a channel of an AudioData in any SampleStorage; compact
+    // formats are scanned as 16-bit values and only the extremes converted
+    void update(const AudioData& data, int channel, long from, long to);
+
+    // reset() and update() over [0, frames)
+    void build(const SAMPLE* samples, long frames, long capacity, int columns);
+    void build(const AudioData& data, int channel, long frames, long capacity, int columns);
+
+    int columns() const { return (int)mins.size(); }
+    long capacity() const { return cap; }
+    long origin() const { return first0; }
+    int columnOf(long frame) const;
+
+    // False for columns no frame has been folded into yet
+    bool hasData(int column) const { return mins[column] <= maxs[column]; }
+    float minAt(int column) const { return mins[column]; }
+    float maxAt(int column) const { return maxs[column]; }
+
+private:
+    long firstFrameOf(int column) const;
+
+    template <typename T, typename Key, typename ToKey, typename ToFloat>
+    void fold(const T* samples, long first, long from, long to, ToKey toKey, ToFloat toFloat);
+
+    long cap = 0;
+    long first0 = 0;   // frame at the left edge of column 0
+    std::vector<float> mins;
+    std::vector<float> maxs;
+};
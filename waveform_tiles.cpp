@@ -0,0 +1,150 @@
+#include "waveform_tiles.h"
+#include "spectrogram.h"
+#include "waveform_summary.h"
+#include <algorithm>
+
+WaveformTiles::WaveformTiles(const AudioData* data, size_t budgetBytes, unsigned threads)
+    : data(data),
+    budget(budgetBytes),
+    pool(std::make_unique<ThreadPool>(threads)) {
+}
+
+WaveformTiles::~WaveformTiles()
+{
+    // Queued renders find nothing pending and return at once
+    invalidate();
+    pool.reset();
+}
+
+void WaveformTiles::setHeight(int h)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (h == height)
+            return;
+        height = h;
+    }
+    invalidate();
+}
+
+void WaveformTiles::setMode(ViewMode m)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (m == mode)
+            return;
+        mode = m;
+    }
+    invalidate();
+}
+
+std::shared_ptr<const WaveformTiles::Tile> WaveformTiles::get(int level, long index)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (height <= 0 || level < 0 || index < 0)
+        return nullptr;
+
+    const Key key(level, index);
+    auto found = tiles.find(key);
+    if (found != tiles.end()) {
+        lru.splice(lru.begin(), lru, found->second);
+        return *found->second;
+    }
+
+    if (pending.insert(key).second) {
+        const unsigned e = epoch;
+        pool->submit([this, key, e]() { render(key, e); });
+    }
+    return nullptr;
+}
+
+void WaveformTiles::retain(int level, long first, long last)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = pending.begin(); it != pending.end(); ) {
+        if (it->first != level || it->second < first || it->second > last)
+            it = pending.erase(it);
+        else
+            ++it;
+    }
+}
+
+void WaveformTiles::invalidate()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    epoch++;
+    pending.clear();
+    tiles.clear();
+    lru.clear();
+    bytes = 0;
+}
+
+WaveformTiles::Usage WaveformTiles::usage() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return { bytes, (int)lru.size(), (int)pending.size() };
+}
+
+// On a pool worker. The summary reads the take directly, so a tile costs
+// one pass over its own frames and nothing else; a spectrogram tile reads
+// only stored spectra.
+void WaveformTiles::render(Key key, unsigned jobEpoch)
+{
+    int h;
+    ViewMode m;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (jobEpoch != epoch || pending.count(key) == 0)
+            return;
+        h = height;
+        m = mode;
+    }
+
+    const int level = key.first;
+    const long from = key.second * tileFrames(level);
+    const long to = std::min<long>(from + tileFrames(level),
+        std::min(data->totalSamplesRecorded, data->maxSamplesBuffer));
+
+    auto tile = std::make_shared<Tile>();
+    tile->level = level;
+    tile->index = key.second;
+
+    tile->raster.resize(TILE_COLUMNS, h);
+    if (m == ViewMode::Spectrogram)
+    {
+        tile->raster.drawSpectrum(*data->spectrogram, from, tileFrames(level), TILE_COLUMNS, 0, TILE_COLUMNS - 1);
+    }
+    else
+    {
+        WaveformSummary summary;
+        summary.reset(tileFrames(level), TILE_COLUMNS, from);
+        if (to > from)
+            summary.update(*data, 0, from, to);
+        tile->raster.drawColumns(summary, 0, TILE_COLUMNS - 1);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (jobEpoch != epoch || pending.erase(key) == 0)
+        return;
+
+    tile->serial = nextSerial++;
+    lru.push_front(tile);
+    tiles[key] = lru.begin();
+    bytes += (size_t)TILE_COLUMNS * h * sizeof(uint32_t);
+    trimToBudget();
+
+    // Under the lock, so a poller that sees nothing pending also sees this
+    ready++;
+}
+
+// Least recently used first, but never the tile that just came in
+void WaveformTiles::trimToBudget()
+{
+    const size_t tileBytes = (size_t)TILE_COLUMNS * height * sizeof(uint32_t);
+    while (bytes > budget && lru.size() > 1) {
+        const Tile& oldest = *lru.back();
+        tiles.erase(Key(oldest.level, oldest.index));
+        lru.pop_back();
+        bytes -= tileBytes;
+    }
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "thread_pool.h"
+#include "utils.h"
+#include "waveform_raster.h"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+
+/**
+ * The zoomed-in waveform view as tiles of TILE_COLUMNS pixel columns,
+ * rendered on a worker pool and kept in an LRU cache keyed by zoom level and
+ * tile index. At level L a column covers 2^L frames, so tile i of level L
+ * always shows the same frames: scrolling reuses the tiles already made and
+ * only renders the newly exposed ones, and going back to a zoom level finds
+ * its tiles still there as long as they fit in the byte budget.
+ *
+ * Tiles show the waveform or, in ViewMode::Spectrogram, the spectra the
+ * capture monitor stored, so zooming a spectrogram never runs an FFT.
+ *
+ * Everything but the rendering itself happens on the UI thread, which polls
+ * generation() to learn when tiles it asked for have come in.
+ */
+class WaveformTiles {
+public:
+    static const int TILE_COLUMNS = 256;
+
+    struct Tile {
+        int level;
+        long index;
+        uint64_t serial;   // different for every tile rendered
+        WaveformRaster raster;
+    };
+
+    explicit WaveformTiles(const AudioData* data, size_t budgetBytes = 64 * 1024 * 1024, unsigned threads = 2);
+    ~WaveformTiles();
+    WaveformTiles(const WaveformTiles&) = delete;
+    WaveformTiles& operator=(const WaveformTiles&) = delete;
+
+    // Frames covered by one tile at `level`
+    static long tileFrames(int level) { return (long)TILE_COLUMNS << level; }
+
+    // Tiles are `height` pixels tall and show `mode`; changing either
+    // forgets them all
+    void setHeight(int height);
+    void setMode(ViewMode mode);
+
+    // The tile, most recently used from now on, or nullptr while it is not
+    // rendered yet, in which case it is queued (once)
+    std::shared_ptr<const Tile> get(int level, long index);
+
+    // Drop queued tiles of `level` outside [first, last] and of other
+    // levels: the view has moved on and they would only delay the new ones
+    void retain(int level, long first, long last);
+
+    // The take changed: forget every tile; renders under way are discarded
+    void invalidate();
+
+    // Goes up each time a tile comes in
+    unsigned generation() const { return ready.load(); }
+
+    struct Usage {
+        size_t bytes;
+        int tiles;
+        int pending;
+    };
+    Usage usage() const;
+
+private:
+    using Key = std::pair<int, long>;
+
+    void render(Key key, unsigned epoch);
+    void trimToBudget();
+
+    const AudioData* data;  // not owning
+    const size_t budget;
+
+    mutable std::mutex mutex;
+    std::list<std::shared_ptr<Tile>> lru;                            // most recent first
+    std::map<Key, std::list<std::shared_ptr<Tile>>::iterator> tiles;
+    std::set<Key> pending;                                           // queued or rendering
+    size_t bytes = 0;
+    int height = 0;
+    ViewMode mode = ViewMode::Waveform;
+    unsigned epoch = 0;        // bumped by invalidate(), so stale renders are dropped
+    uint64_t nextSerial = 1;
+    std::atomic<unsigned> ready{ 0 };
+
+    // Last, so the workers stop before anything they use goes away
+    std::unique_ptr<ThreadPool> pool;
+};
@@ -3,7 +3,9 @@
 #include <wx/wx.h>
 
 // For debugging to console
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <cstdio>
 #include <iostream>
 
@@ -15,9 +17,11 @@ public:
 
 IMPLEMENT_APP(MyApp)
 
-// For debugging to console
+// For debugging to console. Elsewhere stdout/stderr already go to the
+// terminal the app was started from.
 void SetupConsole()
 {
+#ifdef _WIN32
     AllocConsole();  // create a new console window
 
     FILE* fp;
@@ -26,6 +30,7 @@ void SetupConsole()
 
     // Make iostreams aware of the change
     std::ios::sync_with_stdio();
+#endif
 }
 
 